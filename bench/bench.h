@@ -0,0 +1,39 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+static double bench_now() {
+  struct timespec ts = {0};
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sends stdout to /dev/null for code that prints its results, returns
+// the descriptor to hand to bench_restore_stdout.
+static inline int bench_silence_stdout() {
+  int out = 0, devnull = 0;
+
+  fflush(stdout);
+  out = dup(STDOUT_FILENO);
+  devnull = open("/dev/null", O_WRONLY);
+  dup2(devnull, STDOUT_FILENO);
+  close(devnull);
+  return out;
+}
+
+static inline void bench_restore_stdout(int out) {
+  fflush(stdout);
+  dup2(out, STDOUT_FILENO);
+  close(out);
+}
+
+#define BENCH_REPORT(name, n, iterations, elapsed)                             \
+  printf("%-32s n=%-8llu %12.1f ns/op\n", name, (unsigned long long)(n),      \
+         (elapsed) / (iterations)*1e9)
+
+#endif
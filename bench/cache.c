@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "slowjs/cache.h"
+#include "slowjs/fold.h"
+#include "slowjs/parse.h"
+#include "slowjs/vm.h"
+
+// Builds n functions that each call themselves, and a main.
+void build_source(vector_char *source, uint64_t n) {
+  char line[160] = {0};
+  uint64_t i = 0, j = 0;
+
+  for (i = 0; i <= n; i++) {
+    if (i < n) {
+      snprintf(line, sizeof(line),
+               "function f%llu(a, b) { return a < b ? f%llu(b, a) + %llu : "
+               "a * %llu - b / 3; }\n",
+               (unsigned long long)i, (unsigned long long)i,
+               (unsigned long long)i, (unsigned long long)i);
+    } else {
+      snprintf(line, sizeof(line), "function main() { return f0(1, 2); }");
+    }
+
+    for (j = 0; line[j]; j++) {
+      vector_char_push(source, line[j]);
+    }
+  }
+}
+
+// Everything before running main, from the source and from its image.
+void bench_cache(const char *dir, uint64_t n) {
+  vector_char source = {0};
+  ast program = {0};
+  flat_ast f = {0};
+  bytecode bc = {0};
+  cache_image image = {0};
+  run_options options = {0};
+  char path[256] = {0};
+  uint64_t i = 0, iterations = 20000 / (n + 1) + 10;
+  double start = 0;
+
+  build_source(&source, n);
+  options.inlining.max_size = INLINE_DEFAULT_MAX_SIZE;
+
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    if (parse(source, &program) != E_PARSE_OK) {
+      fprintf(stderr, "Failed to parse n=%llu\n", (unsigned long long)n);
+      exit(1);
+    }
+    fold(&program);
+    vm_compile(program, options, &f, &bc);
+    if (i + 1 < iterations) {
+      bytecode_free(&bc);
+      bc = (bytecode){0};
+    }
+    flat_ast_free(&f);
+    f = (flat_ast){0};
+    ast_free(&program);
+    program = (ast){0};
+  }
+  BENCH_REPORT("parse and compile", n, iterations, bench_now() - start);
+
+  if (cache_store(dir, &source, options, &bc) != E_CACHE_OK) {
+    fprintf(stderr, "Failed to store n=%llu\n", (unsigned long long)n);
+    exit(1);
+  }
+
+  iterations *= 10;
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    if (cache_load(dir, &source, options, &image) != E_CACHE_OK) {
+      fprintf(stderr, "Failed to load n=%llu\n", (unsigned long long)n);
+      exit(1);
+    }
+    cache_image_free(&image);
+  }
+  BENCH_REPORT("hash and map the image", n, iterations, bench_now() - start);
+
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    cache_hash(source.elements, source.index);
+  }
+  BENCH_REPORT("of which hashing", n, iterations, bench_now() - start);
+
+  snprintf(path, sizeof(path), "%s/%016llx-%u.image", dir,
+           (unsigned long long)cache_hash(source.elements, source.index),
+           options.inlining.max_size);
+  unlink(path);
+  bytecode_free(&bc);
+  vector_char_free(&source);
+}
+
+// n is the number of functions in the script.
+int main() {
+  char dir[] = "/tmp/slowjs-cache-bench-XXXXXX";
+  uint64_t n[] = {10, 1000, 10000};
+  uint64_t i = 0;
+
+  if (mkdtemp(dir) == 0) {
+    fprintf(stderr, "Failed to make a directory\n");
+    return 1;
+  }
+
+  for (i = 0; i < sizeof(n) / sizeof(n[0]); i++) {
+    bench_cache(dir, n[i]);
+  }
+
+  rmdir(dir);
+  return 0;
+}
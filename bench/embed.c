@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "slowjs/parse.h"
+#include "slowjs/slowjs.h"
+
+// Builds add and fib preceded by padding top-level functions that are
+// never called, and a main that calls add once.
+void build_source(vector_char *source, uint64_t padding) {
+  char line[160] = {0};
+  uint64_t i = 0, j = 0;
+
+  for (i = 0; i <= padding; i++) {
+    if (i < padding) {
+      snprintf(line, sizeof(line), "function pad%llu(a) { return a + %llu; }\n",
+               (unsigned long long)i, (unsigned long long)i);
+    } else {
+      snprintf(line, sizeof(line),
+               "function add(a, b) { return a + b; }\n"
+               "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); "
+               "}\nfunction main() { return add(1, 2); }");
+    }
+
+    for (j = 0; line[j]; j++) {
+      vector_char_push(source, line[j]);
+    }
+  }
+  vector_char_push(source, 0);
+}
+
+void bench_embed(uint64_t padding) {
+  vector_char source = {0};
+  ast program = {0};
+  run_options options = {0};
+  slowjs_script *s = 0;
+  value args[2] = {0}, result = 0;
+  uint64_t i = 0, iterations = 0;
+  double start = 0, elapsed = 0;
+  int out = 0;
+
+  build_source(&source, padding);
+
+  // What serving a call cost before: parse and run the whole program.
+  iterations = 200000 / (padding + 1) + 10;
+  out = bench_silence_stdout();
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    if (parse(source, &program) != E_PARSE_OK) {
+      fprintf(stderr, "Failed to parse padding=%llu\n",
+              (unsigned long long)padding);
+      exit(1);
+    }
+    vm_interpret(program, options);
+    ast_free(&program);
+    program = (ast){0};
+  }
+  elapsed = bench_now() - start;
+  bench_restore_stdout(out);
+  BENCH_REPORT("parse and run add(1, 2)", padding, iterations, elapsed);
+
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    if (slowjs_compile(source.elements, options, &s) != E_SLOWJS_OK) {
+      fprintf(stderr, "Failed to compile padding=%llu\n",
+              (unsigned long long)padding);
+      exit(1);
+    }
+    slowjs_free(s);
+  }
+  elapsed = bench_now() - start;
+  BENCH_REPORT("slowjs_compile", padding, iterations, elapsed);
+
+  slowjs_compile(source.elements, options, &s);
+  args[0] = number_value(1);
+  args[1] = number_value(2);
+  iterations = 2000000;
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    slowjs_call(s, "add", args, 2, &result);
+  }
+  elapsed = bench_now() - start;
+  BENCH_REPORT("slowjs_call add(1, 2)", padding, iterations, elapsed);
+
+  args[0] = number_value(15);
+  iterations = 2000;
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    slowjs_call(s, "fib", args, 1, &result);
+  }
+  elapsed = bench_now() - start;
+  BENCH_REPORT("slowjs_call fib(15)", padding, iterations, elapsed);
+  slowjs_free(s);
+
+  options.jit.enabled = 1;
+  options.jit.threshold = JIT_DEFAULT_THRESHOLD;
+  slowjs_compile(source.elements, options, &s);
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    slowjs_call(s, "fib", args, 1, &result);
+  }
+  elapsed = bench_now() - start;
+  BENCH_REPORT("slowjs_call jit fib(15)", padding, iterations, elapsed);
+  slowjs_free(s);
+
+  vector_char_free(&source);
+}
+
+// n is the number of other top-level functions in the script.
+int main() {
+  uint64_t padding[] = {0, 100, 1000};
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(padding) / sizeof(padding[0]); i++) {
+    bench_embed(padding[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "slowjs/interpret.h"
+#include "slowjs/parse.h"
+#include "slowjs/vm.h"
+
+#define FIB_N 25
+// Calls fib(FIB_N) makes
+#define FIB_CALLS 242785
+
+// Builds fib(FIB_N) preceded by padding top-level functions that are
+// in scope but never called.
+void build_source(vector_char *source, uint64_t padding) {
+  char line[128] = {0};
+  uint64_t i = 0, j = 0;
+
+  for (i = 0; i <= padding; i++) {
+    if (i < padding) {
+      snprintf(line, sizeof(line), "function pad%llu(a) { return a + %llu; }\n",
+               (unsigned long long)i, (unsigned long long)i);
+    } else {
+      snprintf(line, sizeof(line),
+               "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); "
+               "}\nfunction main() { return fib(%d); }",
+               FIB_N);
+    }
+
+    for (j = 0; line[j]; j++) {
+      vector_char_push(source, line[j]);
+    }
+  }
+  vector_char_push(source, 0);
+}
+
+void bench_fib(uint64_t padding) {
+  vector_char source = {0};
+  ast program = {0};
+  run_options options = {0};
+  uint64_t i = 0, iterations = 10;
+  double start = 0, elapsed = 0;
+  int out = 0;
+
+  build_source(&source, padding);
+  if (parse(source, &program) != E_PARSE_OK) {
+    fprintf(stderr, "Failed to parse padding=%llu\n",
+            (unsigned long long)padding);
+    exit(1);
+  }
+
+  out = bench_silence_stdout();
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    interpret(program, options);
+  }
+  elapsed = bench_now() - start;
+  bench_restore_stdout(out);
+  BENCH_REPORT("tree walker fib(25) per call", padding,
+               iterations * FIB_CALLS, elapsed);
+
+  out = bench_silence_stdout();
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    vm_interpret(program, options);
+  }
+  elapsed = bench_now() - start;
+  bench_restore_stdout(out);
+  BENCH_REPORT("vm fib(25) per call", padding, iterations * FIB_CALLS,
+               elapsed);
+
+  options.jit.enabled = 1;
+  options.jit.threshold = JIT_DEFAULT_THRESHOLD;
+  out = bench_silence_stdout();
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    vm_interpret(program, options);
+  }
+  elapsed = bench_now() - start;
+  bench_restore_stdout(out);
+  BENCH_REPORT("vm jit fib(25) per call", padding, iterations * FIB_CALLS,
+               elapsed);
+
+  ast_free(&program);
+  vector_char_free(&source);
+}
+
+// n is the number of other top-level functions in the program.
+int main() {
+  uint64_t padding[] = {0, 100, 1000, 10000};
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(padding) / sizeof(padding[0]); i++) {
+    bench_fib(padding[i]);
+  }
+
+  return 0;
+}
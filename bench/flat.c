@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "slowjs/flat.h"
+#include "slowjs/parse.h"
+
+#define NAMES 8
+
+// Builds `function main() { return x0 * 0 + x1 * 1 + ...; }` with n
+// terms, cycling through NAMES variables.
+void build_source(vector_char *source, uint64_t n) {
+  const char *header = "function main() { return ";
+  const char *footer = "; }";
+  char term[32] = {0};
+  uint64_t i = 0, j = 0;
+
+  vector_char_copy(source, (char *)header, strlen(header));
+  for (i = 0; i < n; i++) {
+    snprintf(term, sizeof(term), "%sx%llu * %llu", i ? " + " : "",
+             (unsigned long long)i % NAMES, (unsigned long long)i);
+    for (j = 0; term[j]; j++) {
+      vector_char_push(source, term[j]);
+    }
+  }
+
+  for (i = 0; i < strlen(footer); i++) {
+    vector_char_push(source, footer[i]);
+  }
+}
+
+// Variables resolve to their position in these tables, the same way
+// the interpreter scans its context.
+const char *tree_names[NAMES] = {"x0", "x1", "x2", "x3",
+                                 "x4", "x5", "x6", "x7"};
+uint32_t flat_names[NAMES] = {0};
+
+double walk_tree(expression *e) {
+  uint64_t i = 0;
+
+  switch (e->type) {
+  case EXPRESSION_NUMBER:
+    return e->expression.number;
+  case EXPRESSION_IDENTIFIER:
+    for (i = 0; i < NAMES; i++) {
+      if (strcmp(tree_names[i], e->expression.identifier.elements) == 0) {
+        return i;
+      }
+    }
+    return 0;
+  case EXPRESSION_OP:
+    if (e->expression.op.type == OP_TIMES) {
+      return walk_tree(e->expression.op.left_operand) *
+             walk_tree(e->expression.op.right_operand);
+    }
+    return walk_tree(e->expression.op.left_operand) +
+           walk_tree(e->expression.op.right_operand);
+  default:
+    return 0;
+  }
+}
+
+double walk_flat(const flat_node *nodes, uint32_t index) {
+  flat_node n = nodes[index];
+  uint64_t i = 0;
+
+  switch (n.type) {
+  case FLAT_NUMBER:
+    return flat_number(n);
+  case FLAT_IDENTIFIER:
+    for (i = 0; i < NAMES; i++) {
+      if (flat_names[i] == n.a) {
+        return i;
+      }
+    }
+    return 0;
+  case FLAT_OP:
+    if (n.op == OP_TIMES) {
+      return walk_flat(nodes, n.a) * walk_flat(nodes, n.b);
+    }
+    return walk_flat(nodes, n.a) + walk_flat(nodes, n.b);
+  default:
+    return 0;
+  }
+}
+
+void bench_walk(uint64_t n) {
+  vector_char source = {0};
+  ast program = {0};
+  flat_ast f = {0};
+  expression *e = 0;
+  uint32_t root = 0;
+  uint64_t i = 0, iterations = 0, flat_bytes = 0;
+  double start = 0, elapsed = 0, result = 0;
+
+  build_source(&source, n);
+  if (parse(source, &program) != E_PARSE_OK ||
+      flatten(&program, &f) != E_FLAT_OK) {
+    fprintf(stderr, "Failed to build n=%llu\n", (unsigned long long)n);
+    exit(1);
+  }
+
+  for (i = 0; i < NAMES && i < n; i++) {
+    intern_lookup(&f.names, tree_names[i], strlen(tree_names[i]),
+                  &flat_names[i]);
+  }
+
+  e = &program.declarations.elements[0]
+           .declaration.function.body.elements[0]
+           .statement.ret;
+  root = f.nodes.elements[f.extras.elements[f.functions.elements[0].body]].a;
+  iterations = 10000000 / n + 1;
+
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    result += walk_tree(e);
+  }
+  elapsed = bench_now() - start;
+  BENCH_REPORT("walk pointer ast", n, iterations, elapsed);
+
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    result -= walk_flat(f.nodes.elements, root);
+  }
+  elapsed = bench_now() - start;
+  BENCH_REPORT("walk flat ast", n, iterations, elapsed);
+
+  flat_bytes = f.nodes.index * sizeof(flat_node) +
+               f.extras.index * sizeof(uint32_t);
+  printf("  pointer ast %llu bytes, flat ast %llu bytes for %llu nodes%s\n",
+         (unsigned long long)program.arena.bytes,
+         (unsigned long long)flat_bytes, (unsigned long long)f.nodes.index,
+         result == 0 ? "" : " (mismatch!)");
+
+  flat_ast_free(&f);
+  ast_free(&program);
+  vector_char_free(&source);
+}
+
+int main() {
+  uint64_t sizes[] = {10, 100, 1000, 10000};
+  uint64_t i = 0;
+
+  printf("sizeof(expression) = %zu, sizeof(flat_node) = %zu\n",
+         sizeof(expression), sizeof(flat_node));
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    bench_walk(sizes[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "slowjs/compile.h"
+#include "slowjs/flat.h"
+#include "slowjs/parse.h"
+#include "slowjs/resolve.h"
+#include "slowjs/vm.h"
+
+// hold keeps an env and a closure per level alive for the whole run
+// while tree allocates an env and a closure per leaf that die at once.
+const char *gc_source =
+    "function leaf(g) { function h() { return g(1); } return h(); }\n"
+    "function tree(d, g) {\n"
+    "  return d < 1 ? leaf(g) : tree(d - 1, g) + tree(d - 1, g);\n"
+    "}\n"
+    "function adder(a) { function f(b) { return a + b; } return f; }\n"
+    "function hold(n) {\n"
+    "  function f(b) { return n + b; }\n"
+    "  return n < 1 ? tree(20, adder(1)) : hold(n - 1) + f(0) * 0;\n"
+    "}\n"
+    "function main() { return hold(50000); }";
+
+void record_pause(void *data, uint64_t ns) {
+  vector_double_push((vector_double *)data, (double)ns);
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+double percentile(vector_double *sorted, double p) {
+  uint64_t i = 0;
+
+  if (sorted->index == 0) {
+    return 0;
+  }
+
+  i = (uint64_t)(p * (sorted->index - 1) + 0.5);
+  return sorted->elements[i];
+}
+
+void bench_gc(bytecode *bc, uint64_t max_pause_us) {
+  run_options options = {0};
+  vector_double pauses = {0};
+  vm m = {0};
+  value result = 0;
+  double start = 0, elapsed = 0;
+
+  options.gc.max_pause_us = max_pause_us;
+  if (vm_init(&m, options) != E_VM_OK) {
+    fprintf(stderr, "Failed to start vm\n");
+    exit(1);
+  }
+  m.heap.on_pause = record_pause;
+  m.heap.on_pause_data = &pauses;
+
+  start = bench_now();
+  if (vm_run(&m, bc, bc->main, &result) != E_VM_OK) {
+    fprintf(stderr, "Failed to run max_pause_us=%llu\n",
+            (unsigned long long)max_pause_us);
+    exit(1);
+  }
+  elapsed = bench_now() - start;
+
+  qsort(pauses.elements, pauses.index, sizeof(double), compare_doubles);
+  printf("max_pause_us=%-6llu %6llu pauses  p50 %8.1f us  p99 %8.1f us  "
+         "max %8.1f us  total %6.1f ms  run %6.1f ms\n",
+         (unsigned long long)max_pause_us, (unsigned long long)pauses.index,
+         percentile(&pauses, 0.5) / 1e3, percentile(&pauses, 0.99) / 1e3,
+         percentile(&pauses, 1) / 1e3, m.heap.stats.total_pause_ns / 1e6,
+         elapsed * 1e3);
+
+  vm_free(&m);
+  vector_double_free(&pauses);
+}
+
+// Pause times for an allocation heavy program with a few MB live, with
+// stop-the-world collections and then with incremental ones.
+int main() {
+  uint64_t budgets[] = {0, 1000, 500, 100};
+  vector_char source = {0};
+  ast program = {0};
+  flat_ast flat = {0};
+  bytecode bc = {0};
+  uint64_t i = 0;
+
+  vector_char_copy(&source, (char *)gc_source, strlen(gc_source) + 1);
+  if (parse(source, &program) != E_PARSE_OK ||
+      flatten(&program, &flat) != E_FLAT_OK || resolve(&flat) != E_RESOLVE_OK ||
+      compile(&flat, &bc) != E_COMPILE_OK) {
+    fprintf(stderr, "Failed to compile\n");
+    exit(1);
+  }
+
+  for (i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+    bench_gc(&bc, budgets[i]);
+  }
+
+  bytecode_free(&bc);
+  flat_ast_free(&flat);
+  ast_free(&program);
+  vector_char_free(&source);
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "slowjs/parse.h"
+
+// Builds `function main() { return <expression>; }` where the
+// expression is either an n-term sum or n nested parenthesized sums.
+void build_source(vector_char *source, uint64_t n, bool nested) {
+  const char *header = "function main() { return ";
+  const char *footer = "; }";
+  uint64_t i = 0;
+
+  vector_char_copy(source, (char *)header, strlen(header));
+  for (i = 0; i < n; i++) {
+    if (nested) {
+      vector_char_push(source, '(');
+    } else if (i) {
+      vector_char_push(source, '+');
+    }
+
+    vector_char_push(source, 'a');
+  }
+
+  for (i = 0; nested && i < n; i++) {
+    vector_char_push(source, '+');
+    vector_char_push(source, '1');
+    vector_char_push(source, ')');
+  }
+
+  for (i = 0; i < strlen(footer); i++) {
+    vector_char_push(source, footer[i]);
+  }
+}
+
+void bench_parse(const char *name, uint64_t n, bool nested) {
+  vector_char source = {0};
+  ast program = {0};
+  uint64_t i = 0, iterations = 0, allocations = 0, chunks = 0;
+  double start = 0, elapsed = 0;
+
+  build_source(&source, n, nested);
+  iterations = 1000000 / n + 1;
+
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    program = (ast){0};
+    if (parse(source, &program) != E_PARSE_OK) {
+      fprintf(stderr, "Failed to parse %s n=%llu\n", name,
+              (unsigned long long)n);
+      exit(1);
+    }
+
+    allocations = program.arena.allocations;
+    chunks = program.arena.chunks;
+    ast_free(&program);
+  }
+  elapsed = bench_now() - start;
+
+  BENCH_REPORT(name, n, iterations, elapsed);
+  printf("  %llu AST allocations served from %llu chunks\n",
+         (unsigned long long)allocations, (unsigned long long)chunks);
+  vector_char_free(&source);
+}
+
+int main() {
+  uint64_t sizes[] = {10, 100, 1000, 10000};
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    bench_parse("parse sum", sizes[i], false);
+  }
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    bench_parse("parse nested groups", sizes[i], true);
+  }
+
+  return 0;
+}
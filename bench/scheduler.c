@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "slowjs/scheduler.h"
+
+#define SHORT_TASKS 64
+
+static const char *source =
+    "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }";
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, uint64_t slice, double *latencies) {
+  qsort(latencies, SHORT_TASKS, sizeof(double), compare_doubles);
+  printf("%-24s slice=%-8llu p50 %10.1f us  p99 %10.1f us\n", name,
+         (unsigned long long)slice, latencies[SHORT_TASKS / 2] * 1e6,
+         latencies[SHORT_TASKS * 99 / 100] * 1e6);
+}
+
+// One fib(30) and then SHORT_TASKS fib(10) all arrive at once. Run one
+// after another the short ones wait for the long one, taking turns they
+// finish in a few slices each.
+static void bench_scheduler(uint64_t slice) {
+  slowjs_script *scripts[SHORT_TASKS + 1] = {0};
+  scheduler_task tasks[SHORT_TASKS + 1] = {{0}}, *t = 0;
+  double latencies[SHORT_TASKS] = {0};
+  scheduler s = {0};
+  value args[1] = {0};
+  uint64_t i = 0;
+  double start = 0;
+
+  for (i = 0; i <= SHORT_TASKS; i++) {
+    if (slowjs_compile(source, (run_options){0}, &scripts[i]) !=
+        E_SLOWJS_OK) {
+      fprintf(stderr, "Failed to compile\n");
+      exit(1);
+    }
+    tasks[i].script = scripts[i];
+  }
+
+  start = bench_now();
+  if (slice == 0) {
+    args[0] = number_value(30);
+    slowjs_call(scripts[0], "fib", args, 1, &tasks[0].result);
+    args[0] = number_value(10);
+    for (i = 1; i <= SHORT_TASKS; i++) {
+      slowjs_call(scripts[i], "fib", args, 1, &tasks[i].result);
+      latencies[i - 1] = bench_now() - start;
+    }
+    report("run to completion", slice, latencies);
+    goto cleanup;
+  }
+
+  scheduler_init(&s, slice, 0);
+  args[0] = number_value(30);
+  scheduler_start(&s, &tasks[0], "fib", args, 1);
+  args[0] = number_value(10);
+  for (i = 1; i <= SHORT_TASKS; i++) {
+    scheduler_start(&s, &tasks[i], "fib", args, 1);
+    if (tasks[i].done) {
+      latencies[i - 1] = bench_now() - start;
+    }
+  }
+
+  while ((t = s.head) != 0) {
+    scheduler_step(&s);
+    if (t->done && t != &tasks[0]) {
+      latencies[t - tasks - 1] = bench_now() - start;
+    }
+  }
+  report("scheduler", slice, latencies);
+  printf("%-24s slice=%-8llu %10.1f ms for fib(30)\n", "",
+         (unsigned long long)slice, (bench_now() - start) * 1e3);
+
+cleanup:
+  for (i = 0; i <= SHORT_TASKS; i++) {
+    slowjs_free(scripts[i]);
+  }
+}
+
+// slice is the calls a task makes per turn, 0 runs each to the end.
+int main() {
+  uint64_t slices[] = {0, 100, 1000, 10000};
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(slices) / sizeof(slices[0]); i++) {
+    bench_scheduler(slices[i]);
+  }
+
+  return 0;
+}
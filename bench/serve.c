@@ -0,0 +1,222 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "slowjs/server.h"
+
+extern char **environ;
+
+// Requests in flight at once, each from a connection or process of its
+// own.
+#define CLIENTS 4
+
+struct client {
+  const char *socket;
+  // The request line, or the script the command line runs.
+  const char *request;
+  const char *script;
+  uint64_t requests;
+  // Seconds each request took.
+  double *latencies;
+  uint64_t failed;
+};
+typedef struct client client;
+
+// Sends requests one after another, waiting for each answer.
+static void *client_serve(void *data) {
+  client *c = (client *)data;
+  struct sockaddr_un address = {0};
+  char answer[512] = {0};
+  uint64_t i = 0, length = strlen(c->request);
+  ssize_t got = 0;
+  double start = 0;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, c->socket, sizeof(address.sun_path) - 1);
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    c->failed = c->requests;
+    close(fd);
+    return 0;
+  }
+
+  for (i = 0; i < c->requests; i++) {
+    start = bench_now();
+    if (write(fd, c->request, length) != (ssize_t)length) {
+      c->failed++;
+      break;
+    }
+
+    // Answers are short, one read is enough unless it is split.
+    do {
+      got = read(fd, answer, sizeof(answer));
+    } while (got > 0 && answer[got - 1] != '\n');
+    if (got <= 0 || strncmp(answer, "error", 5) == 0) {
+      c->failed++;
+    }
+    c->latencies[i] = bench_now() - start;
+  }
+
+  close(fd);
+  return 0;
+}
+
+// Runs the command line on the script once per request, with the VM
+// like the daemon.
+static void *client_spawn(void *data) {
+  client *c = (client *)data;
+  posix_spawn_file_actions_t actions;
+  char *argv[] = {SLOWJS_BINARY, "--vm", (char *)c->script, 0};
+  pid_t pid = 0;
+  int status = 0;
+  uint64_t i = 0;
+  double start = 0;
+
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  for (i = 0; i < c->requests; i++) {
+    start = bench_now();
+    if (posix_spawn(&pid, argv[0], &actions, 0, argv, environ) != 0 ||
+        waitpid(pid, &status, 0) != pid || status != 0) {
+      c->failed++;
+    }
+    c->latencies[i] = bench_now() - start;
+  }
+
+  posix_spawn_file_actions_destroy(&actions);
+  return 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Runs CLIENTS clients of requests requests each and reports requests
+// per second and latency.
+static void bench_clients(const char *name, void *(*run)(void *),
+                          client template, uint64_t requests) {
+  client clients[CLIENTS] = {{0}};
+  pthread_t threads[CLIENTS] = {0};
+  double *latencies = (double *)calloc(CLIENTS * requests, sizeof(double));
+  double start = 0, elapsed = 0;
+  uint64_t i = 0, failed = 0, total = CLIENTS * requests;
+
+  start = bench_now();
+  for (i = 0; i < CLIENTS; i++) {
+    clients[i] = template;
+    clients[i].requests = requests;
+    clients[i].latencies = latencies + i * requests;
+    pthread_create(&threads[i], 0, run, &clients[i]);
+  }
+  for (i = 0; i < CLIENTS; i++) {
+    pthread_join(threads[i], 0);
+    failed += clients[i].failed;
+  }
+  elapsed = bench_now() - start;
+
+  qsort(latencies, total, sizeof(double), compare_doubles);
+  printf("%-32s %10.0f req/s  p50 %9.1f us  p99 %9.1f us", name,
+         total / elapsed, latencies[total / 2] * 1e6,
+         latencies[total * 99 / 100] * 1e6);
+  if (failed) {
+    printf("  (%llu failed)", (unsigned long long)failed);
+  }
+  printf("\n");
+  free(latencies);
+}
+
+static void *bench_server(void *data) {
+  server_run((server *)data);
+  return 0;
+}
+
+// The daemon on a thread of its own against the command line started
+// for every request, for a script whose main takes next to no time and
+// one where it does some work.
+static void bench_compare() {
+  char dir[] = "/tmp/slowjs-serve-bench-XXXXXX";
+  char socket_path[64] = {0}, script[64] = {0}, request[128] = {0};
+  char line[64] = {0};
+  const char *bodies[] = {"fib(1)", "fib(20)"};
+  server s = {0};
+  pthread_t thread = {0};
+  client template = {0};
+  FILE *f = 0;
+  uint64_t i = 0;
+
+  if (mkdtemp(dir) == 0) {
+    fprintf(stderr, "Failed to make a directory\n");
+    exit(1);
+  }
+  snprintf(socket_path, sizeof(socket_path), "%s/slowjs.sock", dir);
+  snprintf(script, sizeof(script), "%s/fib.js", dir);
+  snprintf(request, sizeof(request), "%s main\n", script);
+
+  if (server_init(&s, socket_path, (server_options){0}) != E_SERVER_OK) {
+    fprintf(stderr, "Failed to listen on %s\n", socket_path);
+    exit(1);
+  }
+  pthread_create(&thread, 0, bench_server, &s);
+
+  template.socket = socket_path;
+  template.request = request;
+  template.script = script;
+  for (i = 0; i < sizeof(bodies) / sizeof(bodies[0]); i++) {
+    f = fopen(script, "w");
+    fprintf(f,
+            "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+            "function main() { return %s; }\n",
+            bodies[i]);
+    fclose(f);
+
+    snprintf(line, sizeof(line), "fork-exec main() { %s }", bodies[i]);
+    bench_clients(line, client_spawn, template, 200);
+    snprintf(line, sizeof(line), "--serve main() { %s }", bodies[i]);
+    bench_clients(line, client_serve, template, 5000);
+  }
+
+  server_stop(&s);
+  pthread_join(thread, 0);
+  server_free(&s);
+  unlink(script);
+  rmdir(dir);
+}
+
+// With no arguments compares the daemon to starting the command line
+// for every request. Given a socket, script, function and arguments it
+// only drives an already running slowjs --serve.
+int main(int argc, char **argv) {
+  char request[4096] = {0};
+  client template = {0};
+  int i = 0, length = 0;
+
+  if (argc == 1) {
+    bench_compare();
+    return 0;
+  }
+
+  if (argc < 4) {
+    fprintf(stderr, "Usage: %s [socket script function [args...]]\n",
+            argv[0]);
+    return 1;
+  }
+
+  for (i = 2; i < argc && length < (int)sizeof(request) - 1; i++) {
+    length += snprintf(request + length, sizeof(request) - length, "%s%s",
+                       argv[i], i == argc - 1 ? "\n" : " ");
+  }
+  template.socket = argv[1];
+  template.request = request;
+  bench_clients("--serve", client_serve, template, 10000);
+  return 0;
+}
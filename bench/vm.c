@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "slowjs/interpret.h"
+#include "slowjs/parse.h"
+#include "slowjs/vm.h"
+
+// Builds functions f0..fn where each fk calls f(k-1) twice, so calling
+// fn makes 2^(n+1) - 1 calls, each doing a little arithmetic.
+void build_source(vector_char *source, uint64_t n) {
+  char line[128] = {0};
+  uint64_t i = 0, j = 0;
+
+  for (i = 0; i <= n; i++) {
+    if (i == 0) {
+      snprintf(line, sizeof(line), "function f0(a) { return a * 2 + 1; }\n");
+    } else {
+      snprintf(line, sizeof(line),
+               "function f%llu(a) { return f%llu(a) - f%llu(a / 2) * 3; }\n",
+               (unsigned long long)i, (unsigned long long)i - 1,
+               (unsigned long long)i - 1);
+    }
+
+    for (j = 0; line[j]; j++) {
+      vector_char_push(source, line[j]);
+    }
+  }
+
+  snprintf(line, sizeof(line), "function main() { return f%llu(7); }",
+           (unsigned long long)n);
+  for (j = 0; j <= strlen(line); j++) {
+    vector_char_push(source, line[j]);
+  }
+}
+
+void bench_calls(uint64_t n) {
+  vector_char source = {0};
+  ast program = {0};
+  run_options options = {0};
+  uint64_t i = 0, iterations = 0, calls = 0;
+  double start = 0, elapsed = 0;
+  int out = 0;
+
+  build_source(&source, n);
+  if (parse(source, &program) != E_PARSE_OK) {
+    fprintf(stderr, "Failed to parse n=%llu\n", (unsigned long long)n);
+    exit(1);
+  }
+
+  calls = (2ULL << n) - 1;
+  iterations = 2000000 / calls + 1;
+
+  // Both print the result, keep that out of the report.
+  out = bench_silence_stdout();
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    interpret(program, options);
+  }
+  elapsed = bench_now() - start;
+  bench_restore_stdout(out);
+  BENCH_REPORT("tree walker calls", calls, iterations * calls, elapsed);
+
+  out = bench_silence_stdout();
+  start = bench_now();
+  for (i = 0; i < iterations; i++) {
+    vm_interpret(program, options);
+  }
+  elapsed = bench_now() - start;
+  bench_restore_stdout(out);
+  BENCH_REPORT("vm calls", calls, iterations * calls, elapsed);
+
+  ast_free(&program);
+  vector_char_free(&source);
+}
+
+int main() {
+  uint64_t sizes[] = {4, 8, 12, 16};
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    bench_calls(sizes[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,19 @@
+function square(x) {
+  return x * x;
+}
+
+function norm(x, y) {
+  return square(x) + square(y);
+}
+
+function sign(x) {
+  return x < 0 ? 0 - 1 : x > 0 ? 1 : 0;
+}
+
+function sum(n, acc) {
+  return n < 1 ? acc : sum(n - 1, acc + norm(n, 1 / n) * sign(n - 50));
+}
+
+function main() {
+  return sum(100, 0) / 3;
+}
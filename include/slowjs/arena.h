@@ -0,0 +1,29 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdint.h>
+
+// Bump allocator: memory is carved out of large chunks and only ever
+// released all at once by arena_free.
+struct arena_chunk {
+  struct arena_chunk *next;
+  uint64_t size;
+  uint64_t used;
+};
+typedef struct arena_chunk arena_chunk;
+
+struct arena {
+  arena_chunk *head;
+  // Number of arena_alloc calls served and the number of chunks (and
+  // so mallocs) they were served from.
+  uint64_t allocations;
+  uint64_t chunks;
+  uint64_t bytes;
+};
+typedef struct arena arena;
+
+void *arena_alloc(arena *, uint64_t);
+void *arena_copy(arena *, const void *, uint64_t);
+void arena_free(arena *);
+
+#endif
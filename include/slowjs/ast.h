@@ -1,8 +1,10 @@
 #ifndef _AST_H_
 #define _AST_H_
 
+#include <stdio.h>
 #include <string.h>
 
+#include "slowjs/arena.h"
 #include "slowjs/vector.h"
 
 struct declaration;
@@ -15,9 +17,7 @@ struct function_call {
 };
 typedef struct function_call function_call;
 
-void function_call_free(function_call *);
-
-enum op_type { OP_PLUS, OP_MINUS, OP_TIMES, OP_DIV };
+enum op_type { OP_PLUS, OP_MINUS, OP_TIMES, OP_DIV, OP_LESS, OP_GREATER };
 typedef enum op_type op_type;
 
 struct op {
@@ -27,7 +27,13 @@ struct op {
 };
 typedef struct op op;
 
-void op_free(op *);
+// test ? consequent : alternate
+struct conditional {
+  struct expression *test;
+  struct expression *consequent;
+  struct expression *alternate;
+};
+typedef struct conditional conditional;
 
 enum expression_type {
   EXPRESSION_CALL,
@@ -36,6 +42,7 @@ enum expression_type {
   EXPRESSION_NUMBER,
   EXPRESSION_NULL,
   EXPRESSION_BOOL,
+  EXPRESSION_CONDITIONAL,
 };
 typedef enum expression_type expression_type;
 
@@ -44,6 +51,7 @@ struct expression {
   union {
     function_call function_call;
     op op;
+    conditional conditional;
     double number;
     vector_char identifier;
   } expression;
@@ -52,8 +60,6 @@ typedef struct expression expression;
 
 DECLARE_VECTOR(expression)
 
-void expression_free(expression *);
-
 struct variable_declaration {
   vector_char name;
   expression initializer;
@@ -62,8 +68,6 @@ typedef struct variable_declaration variable_declaration;
 
 DECLARE_VECTOR(variable_declaration)
 
-void variable_declaration_free(variable_declaration *);
-
 enum statement_type {
   STATEMENT_EXPRESSION,
   STATEMENT_RETURN,
@@ -83,8 +87,6 @@ typedef struct statement statement;
 
 DECLARE_VECTOR(statement)
 
-void statement_free(statement *);
-
 struct function_declaration {
   vector_char name;
   vector_string parameters;
@@ -92,8 +94,6 @@ struct function_declaration {
 };
 typedef struct function_declaration function_declaration;
 
-void function_declaration_free(function_declaration *);
-
 enum declaration_type {
   DECLARATION_FUNCTION,
   DECLARATION_VAR,
@@ -113,13 +113,15 @@ typedef struct declaration declaration;
 
 DECLARE_VECTOR(declaration)
 
-void declaration_free(declaration *);
-
+// Every node, string and list reachable from declarations lives in the
+// arena, so the whole tree is released with one arena_free.
 struct ast {
+  arena arena;
   vector_declaration declarations;
 };
 typedef struct ast ast;
 
 void ast_free(ast *);
+void ast_print(ast *, FILE *);
 
 #endif
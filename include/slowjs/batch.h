@@ -0,0 +1,40 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stdio.h>
+
+#include "slowjs/options.h"
+
+typedef enum { E_BATCH_OK, E_BATCH_MALLOC } batch_error;
+
+struct batch_options {
+  run_options run;
+  // Run with the VM rather than the tree walker.
+  uint32_t vm;
+  uint32_t threads;
+};
+typedef struct batch_options batch_options;
+
+// Seconds are summed over every file, so with more than one thread they
+// add up to more than wall.
+struct batch_stats {
+  uint64_t files;
+  uint64_t failed;
+  uint32_t threads;
+  double wall;
+  double read;
+  double parse;
+  double fold;
+  double run;
+};
+typedef struct batch_stats batch_stats;
+
+// Reads, parses and runs every file in paths on a pool of threads, see
+// pool.h. What each prints, or the error it fails with, is collected
+// and written to out in the order of paths, each line after its path.
+// A file that fails does not stop the others.
+batch_error batch_run(char **, uint64_t, batch_options, FILE *,
+                      batch_stats *);
+void batch_print_stats(batch_stats *, FILE *);
+
+#endif
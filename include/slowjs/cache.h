@@ -0,0 +1,50 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include "slowjs/compile.h"
+#include "slowjs/options.h"
+#include "slowjs/vector.h"
+
+// Compiled programs kept in a directory, so running a source that has
+// been run before skips lexing, parsing and compiling. Bytecode never
+// refers to memory addresses, see compile.h, so an image on disk is
+// the bytecode itself behind a header and runs straight from where it
+// is mapped.
+//
+// Images are named after a hash of the source and the options that
+// change what is compiled. The header repeats them, and anything that
+// does not match is a miss. Images are written whole and renamed into
+// place, so a run never sees half of one, but the directory is trusted
+// not to hold anything else under those names.
+
+typedef enum {
+  E_CACHE_OK,
+  E_CACHE_MISS,
+  E_CACHE_MALLOC,
+  E_CACHE_WRITE
+} cache_error;
+
+// Changes whenever the layout of images or the bytecode does.
+#define CACHE_VERSION 1
+
+struct cache_image {
+  // Points into map, so it must not be given to bytecode_free.
+  bytecode bc;
+  void *map;
+  uint64_t size;
+};
+typedef struct cache_image cache_image;
+
+// Not cryptographic, only quick enough to run over every source.
+uint64_t cache_hash(const char *, uint64_t);
+// Maps the image of source compiled with options from the directory if
+// there is one that matches.
+cache_error cache_load(const char *, vector_char *, run_options,
+                       cache_image *);
+// Writes bc, compiled from source with options, to the directory, which
+// is made if it is missing.
+cache_error cache_store(const char *, vector_char *, run_options,
+                        bytecode *);
+void cache_image_free(cache_image *);
+
+#endif
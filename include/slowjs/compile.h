@@ -0,0 +1,82 @@
+#ifndef _COMPILE_H_
+#define _COMPILE_H_
+
+#include "slowjs/flat.h"
+#include "slowjs/vector.h"
+
+typedef enum {
+  E_COMPILE_OK,
+  E_COMPILE_MALLOC,
+  E_COMPILE_TOO_BIG,
+  E_COMPILE_UNSUPPORTED
+} compile_error;
+
+// Opcodes are one byte, any operand follows as a native-endian 32-bit
+// word. Code never refers to memory addresses so it can be copied.
+// Changing any of this has to change CACHE_VERSION, see cache.h.
+enum opcode {
+  BC_CONSTANT,      // operand: index into constants
+  BC_NULL,          //
+  BC_TRUE,          //
+  BC_FALSE,         //
+  BC_FUNCTION,      // operand: index into functions, closes over nothing
+  BC_CLOSURE,       // operand: index into functions, closes over the env
+  BC_GET_LOCAL,     // operand: slot on the stack
+  BC_ENV,           // operand: slots, moves the arguments into a new env
+  BC_GET_ENV,       // operand: slot in the env
+  BC_SET_ENV,       // operand: slot in the env, pops the value
+  BC_GET_OUTER,     // operands: envs to skip past the callee's, slot
+  BC_ADD,           //
+  BC_SUB,           //
+  BC_MUL,           //
+  BC_DIV,           //
+  BC_LESS,          //
+  BC_GREATER,       //
+  BC_JUMP,          // operand: offset into code
+  BC_JUMP_IF_FALSE, // operand: offset into code, pops the test
+  BC_CALL,          // operand: argument count, callee is below the arguments
+  BC_RETURN,        //
+  BC_POP,           //
+  BC_TAIL_CALL,     // operand: argument count, replaces the current call
+
+  // The VM quickens arithmetic into these, see quicken.h
+  BC_ADD_NUMBER,     //
+  BC_SUB_NUMBER,     //
+  BC_MUL_NUMBER,     //
+  BC_DIV_NUMBER,     //
+  BC_LESS_NUMBER,    //
+  BC_GREATER_NUMBER, //
+};
+typedef enum opcode opcode;
+
+#define BC_OPERAND_SIZE sizeof(uint32_t)
+
+struct bc_function {
+  uint32_t nparameters;
+  // Slots on the stack, functions with an env only keep their
+  // arguments there.
+  uint32_t nlocals;
+  // Deepest the operand stack gets above the locals.
+  uint32_t max_stack;
+  // Offset into code.
+  uint32_t code;
+};
+typedef struct bc_function bc_function;
+
+DECLARE_VECTOR(bc_function)
+
+// Functions keep the indices they have in the flat_ast.
+struct bytecode {
+  vector_uint8_t code;
+  vector_double constants;
+  vector_bc_function functions;
+  // Index of the top-level main function, or UINT32_MAX.
+  uint32_t main;
+};
+typedef struct bytecode bytecode;
+
+// Expects a resolved flat_ast.
+compile_error compile(flat_ast *, bytecode *);
+void bytecode_free(bytecode *);
+
+#endif
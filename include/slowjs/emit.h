@@ -0,0 +1,30 @@
+#ifndef _EMIT_H_
+#define _EMIT_H_
+
+#include <stdio.h>
+
+#include "slowjs/ast.h"
+#include "slowjs/options.h"
+
+typedef enum {
+  E_EMIT_OK,
+  E_EMIT_MALLOC,
+  E_EMIT_FLATTEN,
+  E_EMIT_RESOLVE,
+  E_EMIT_NO_MAIN,
+  E_EMIT_WRITE
+} emit_error;
+
+// Translates program into one standalone C file that runs main and
+// prints what it returns the way the interpreters do. Only the inlining
+// options are used.
+//
+// Values are NaN-boxed as in value.h and every function becomes a C
+// function taking its parameters as arguments, so calls to top-level
+// functions are direct C calls and returned calls to them are sibling
+// calls a C compiler can turn into jumps. Other calls go through the
+// closure. Envs and closures are allocated and never freed, and how
+// deep the program can recurse is up to the C stack.
+emit_error emit_c(ast program, run_options, FILE *);
+
+#endif
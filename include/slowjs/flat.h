@@ -0,0 +1,98 @@
+#ifndef _FLAT_H_
+#define _FLAT_H_
+
+#include "slowjs/ast.h"
+#include "slowjs/intern.h"
+#include "slowjs/vector.h"
+
+// A compact encoding of the ast: nodes sit in one array and refer to
+// each other by 32-bit index, lists are runs of indices in extras and
+// identifiers are interned ids.
+
+typedef enum {
+  E_FLAT_OK,
+  E_FLAT_MALLOC,
+  E_FLAT_TOO_BIG,
+  E_FLAT_UNSUPPORTED
+} flat_error;
+
+enum flat_node_type {
+  FLAT_NUMBER,      // a, b: the double, see flat_number
+  FLAT_NULL,        //
+  FLAT_BOOL,        // a: 0 or 1
+  FLAT_IDENTIFIER,  // a: name id
+  FLAT_OP,          // op: op_type, a: left, b: right
+  FLAT_CALL,        // count: arguments, a: callee, b: extras start
+  FLAT_CONDITIONAL, // a: test, b: extras start of consequent, alternate
+  FLAT_RETURN,      // a: expression
+  FLAT_EXPRESSION,  // a: expression
+  FLAT_FUNCTION,    // a: index into functions, b: slot after resolve
+
+  // Identifiers become one of these after resolve
+  FLAT_LOCAL,       // a: functions out from the current one, b: slot
+  FLAT_GLOBAL,      // a: global slot
+
+  // The tree walker quickens ops into this, see quicken.h
+  FLAT_NUMBER_OP,   // op: op_type, a: left, b: right
+
+  // A FLAT_CALL whose result is returned as is, see resolve_tail_calls
+  FLAT_TAIL_CALL,   // count: arguments, a: callee, b: extras start
+};
+typedef enum flat_node_type flat_node_type;
+
+struct flat_node {
+  uint8_t type;
+  uint8_t op;
+  uint16_t count;
+  uint32_t a;
+  uint32_t b;
+};
+typedef struct flat_node flat_node;
+
+DECLARE_VECTOR(flat_node)
+
+// Numbers are stored inline across a and b so reading one does not
+// leave the node array.
+static inline double flat_number(flat_node n) {
+  double d = 0;
+
+  memcpy(&d, &n.a, sizeof(d));
+  return d;
+}
+
+struct flat_function {
+  uint32_t name;
+  uint32_t nparameters;
+  // Parameter name ids and then statement nodes, both in extras.
+  uint32_t parameters;
+  uint32_t nstatements;
+  uint32_t body;
+
+  // Filled in by resolve.
+  uint32_t parent;
+  // Parameters take the first slots, then nested function declarations.
+  uint32_t nslots;
+  // Nonzero when nested functions may capture the slots, so they have
+  // to outlive the call.
+  uint32_t heap_slots;
+};
+typedef struct flat_function flat_function;
+
+DECLARE_VECTOR(flat_function)
+
+struct flat_ast {
+  vector_flat_node nodes;
+  vector_uint32_t extras;
+  vector_flat_function functions;
+  // Top-level function declarations, as indices into functions.
+  vector_uint32_t declarations;
+  // Function index bound to each global slot, filled in by resolve.
+  vector_uint32_t globals;
+  interner names;
+};
+typedef struct flat_ast flat_ast;
+
+flat_error flatten(ast *, flat_ast *);
+void flat_ast_free(flat_ast *);
+
+#endif
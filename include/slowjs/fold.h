@@ -0,0 +1,12 @@
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+#include "slowjs/ast.h"
+
+// Rewrites the ast in place, between parse and running it: operations
+// on literals become literals, conditionals on literals become the
+// branch taken, and x * 1, 1 * x, x / 1 and x - 0 become x when x is
+// known to be a number. Returns the number of expressions rewritten.
+uint64_t fold(ast *);
+
+#endif
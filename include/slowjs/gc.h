@@ -0,0 +1,93 @@
+#ifndef _GC_H_
+#define _GC_H_
+
+#include <stdio.h>
+
+#include "slowjs/value.h"
+#include "slowjs/vector.h"
+
+typedef object *object_ptr;
+DECLARE_VECTOR(object_ptr)
+
+// Start a cycle once this many bytes are live, and never earlier.
+#define GC_MIN_THRESHOLD (1 << 20)
+// An incremental cycle takes a step each time this much is allocated.
+#define GC_STEP_BYTES (64 << 10)
+
+struct gc_options {
+  // Print a report of every collection when the program finishes.
+  uint32_t stats;
+  // Split each collection into steps of about this long, interleaved
+  // with the program. 0 collects all at once.
+  uint64_t max_pause_us;
+};
+typedef struct gc_options gc_options;
+
+struct gc_stats {
+  uint64_t collections;
+  // Every time the program was paused, a collection is one or more.
+  uint64_t steps;
+  uint64_t bytes_allocated;
+  uint64_t bytes_freed;
+  uint64_t total_pause_ns;
+  uint64_t max_pause_ns;
+};
+typedef struct gc_stats gc_stats;
+
+enum gc_phase { GC_IDLE, GC_MARK, GC_SWEEP };
+typedef enum gc_phase gc_phase;
+
+// Colors of object.color. Gray objects are marked but their children
+// may not be yet. Objects off the heap, like the closures of top-level
+// functions, are created black and never change.
+enum gc_color { GC_WHITE, GC_GRAY, GC_BLACK };
+typedef enum gc_color gc_color;
+
+struct gc;
+
+// Calls gc_mark_value or gc_mark_object on everything the program can
+// still reach without going through the heap.
+typedef void (*gc_roots)(struct gc *, void *);
+
+struct gc {
+  gc_phase phase;
+  uint64_t max_pause_ns;
+  object *objects;
+  // Objects the sweep has not reached yet.
+  object *sweeping;
+  uint64_t bytes;
+  uint64_t threshold;
+  uint64_t allocated_since_step;
+  vector_object_ptr gray;
+  // Some gray objects did not fit in gray and have to be found by
+  // walking the heap.
+  uint32_t gray_overflowed;
+  gc_roots roots;
+  void *roots_data;
+  // Called with the length of every pause, if set.
+  void (*on_pause)(void *, uint64_t);
+  void *on_pause_data;
+  gc_stats stats;
+};
+typedef struct gc gc;
+
+// Every store of a value into a heap object has to go through this while
+// a cycle is marking, so that no black object points at a white one.
+#define GC_WRITE_BARRIER(g, v)                                                 \
+  do {                                                                         \
+    if ((g)->phase == GC_MARK) {                                               \
+      gc_mark_value((g), (v));                                                 \
+    }                                                                          \
+  } while (0)
+
+void gc_init(gc *, gc_options, gc_roots, void *);
+env *gc_env_new(gc *, env *, uint32_t);
+closure *gc_closure_new(gc *, uint32_t, env *);
+void gc_mark_value(gc *, value);
+void gc_mark_object(gc *, object *);
+void gc_step(gc *, uint64_t);
+void gc_collect(gc *);
+void gc_print_stats(gc *, FILE *);
+void gc_free(gc *);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _INLINER_H_
+#define _INLINER_H_
+
+#include <stdio.h>
+
+#include "slowjs/flat.h"
+
+typedef enum { E_INLINE_OK, E_INLINE_MALLOC } inline_error;
+
+// Bodies of up to this many nodes are inlined unless told otherwise.
+#define INLINE_DEFAULT_MAX_SIZE 16
+// Inlining stops once the program has grown to this many times the
+// nodes it started with.
+#define INLINE_MAX_GROWTH 4
+
+struct inline_options {
+  // Calls to functions whose returned expression has more nodes than
+  // this are left alone. 0 turns inlining off.
+  uint32_t max_size;
+  // Print every call site to a top-level function and whether it was
+  // inlined.
+  uint32_t report;
+};
+typedef struct inline_options inline_options;
+
+// Replaces calls to top-level functions whose body is a single small
+// return, and that do not call themselves, with that expression. The
+// arguments take the place of the parameters. Since nothing can be
+// assigned, that only changes what the program does if an argument
+// would be evaluated a different number of times, so an argument that
+// is not a literal or a variable has to be used once, or not at all if
+// it makes no calls.
+//
+// Runs after resolve, so names in the body already refer to globals and
+// cannot be captured at the call site. Sites are reported to report if
+// it is not null.
+inline_error inline_calls(flat_ast *, inline_options, FILE *);
+
+#endif
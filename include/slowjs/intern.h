@@ -0,0 +1,23 @@
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include "slowjs/vector.h"
+
+typedef enum { E_INTERN_OK, E_INTERN_MALLOC, E_INTERN_NOT_FOUND } intern_error;
+
+// Maps names to dense 32-bit ids. Names are copied, so the interner
+// does not depend on whatever they were interned from.
+struct interner {
+  vector_string names;
+  // Open addressing table of id + 1, zero marks an empty slot.
+  uint32_t *slots;
+  uint64_t capacity;
+};
+typedef struct interner interner;
+
+intern_error intern(interner *, const char *, uint64_t, uint32_t *);
+intern_error intern_lookup(interner *, const char *, uint64_t, uint32_t *);
+const char *interned_name(interner *, uint32_t);
+void interner_free(interner *);
+
+#endif
@@ -2,14 +2,22 @@
 #define _INTERPRET_H_
 
 #include "slowjs/ast.h"
+#include "slowjs/options.h"
 
 typedef enum {
   E_INTERPRET_OK,
   E_INTERPRET_NO_MAIN,
   E_INTERPRET_CRASH,
-  E_INTERPRET_CALL_NONFUNCTION
+  E_INTERPRET_CALL_NONFUNCTION,
+  E_INTERPRET_RESOLVE,
+  E_INTERPRET_STACK_OVERFLOW
 } interpret_error;
 
-interpret_error interpret(ast program);
+// The value, work and frame stacks start with this many elements each.
+#define INTERPRET_INITIAL_STACK 256
+// How large they may grow together if run_options does not say.
+#define INTERPRET_DEFAULT_STACK_LIMIT ((uint64_t)256 << 20)
+
+interpret_error interpret(ast program, run_options);
 
 #endif
@@ -0,0 +1,93 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <stdio.h>
+
+#include "slowjs/common.h"
+#include "slowjs/compile.h"
+#include "slowjs/value.h"
+
+typedef enum { E_JIT_OK, E_JIT_MALLOC, E_JIT_UNSUPPORTED } jit_error;
+
+// Functions run in the VM this many times before they are compiled
+// unless told otherwise.
+#define JIT_DEFAULT_THRESHOLD 100
+// Bytes of machine code one VM may generate.
+#define JIT_CODE_SIZE (1 << 20)
+// Bytes of C stack compiled code may use before the call it started
+// from gives up and runs in the VM instead.
+#define JIT_STACK_SIZE (1 << 20)
+// Arguments are passed in xmm0 to xmm7.
+#define JIT_MAX_PARAMETERS 8
+
+struct jit_options {
+  // Compile hot functions to x86-64 machine code.
+  uint32_t enabled;
+  // Calls a function runs in the VM before it is compiled, 0 compiles
+  // it before its first call.
+  uint32_t threshold;
+  // Print how many functions were compiled and ran when the program
+  // finishes.
+  uint32_t stats;
+};
+typedef struct jit_options jit_options;
+
+enum jit_state { JIT_COLD, JIT_NATIVE, JIT_NEVER };
+typedef enum jit_state jit_state;
+
+struct jit_function {
+  // A jit_state.
+  uint32_t state;
+  uint32_t calls;
+  // Offset of the machine code in jit.code.
+  uint32_t entry;
+};
+typedef struct jit_function jit_function;
+
+struct jit_stats {
+  uint64_t compiled;
+  // Functions that use something compiled code cannot do.
+  uint64_t rejected;
+  // Calls from the VM that ran as machine code.
+  uint64_t native_calls;
+  // Of those, ones that ran out of stack and ran in the VM after all.
+  uint64_t bails;
+};
+typedef struct jit_stats jit_stats;
+
+struct jit {
+  jit_options options;
+  // Executable unless code is being generated.
+  uint8_t *code;
+  uint64_t used;
+  // Where the stub that calls into compiled code and the exit it takes
+  // when it runs out of stack start.
+  uint64_t enter;
+  uint64_t bail;
+  jit_function *functions;
+  uint64_t nfunctions;
+  jit_stats stats;
+  // Read and written by the generated code.
+  uintptr_t saved_sp;
+  uintptr_t stack_limit;
+};
+typedef struct jit jit;
+
+// Compiles functions whose bodies only do arithmetic and comparisons on
+// their parameters and number constants, and call other such functions
+// directly. Values are kept in xmm registers as doubles and never boxed,
+// so compiled code is only entered with number arguments and always
+// returns a number. Everything else keeps running in the VM.
+//
+// Resets the per-function counters for a program of nfunctions, the
+// jit has to stay at the same address from then on.
+jit_error jit_prepare(jit *, jit_options, uint64_t);
+// Counts a call of function from the VM with argc arguments, compiling
+// it if it is hot. Runs it and returns true if it is compiled and the
+// arguments are numbers, code is the VM's copy of the bytecode.
+bool jit_call(jit *, bytecode *, uint8_t *, uint32_t, value *, uint32_t,
+              value *);
+void jit_print_stats(jit *, FILE *);
+void jit_free(jit *);
+
+#endif
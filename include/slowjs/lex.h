@@ -6,17 +6,62 @@
 enum lex_error { E_LEX_OK, E_LEX_MALLOC };
 typedef enum lex_error lex_error;
 
+enum token_type {
+  TOKEN_IDENTIFIER,
+  TOKEN_NUMBER,
+
+  // Keywords
+  TOKEN_FUNCTION,
+  TOKEN_RETURN,
+  TOKEN_NULL,
+  TOKEN_TRUE,
+  TOKEN_FALSE,
+  TOKEN_VAR,
+  TOKEN_LET,
+  TOKEN_CONST,
+
+  // Punctuators
+  TOKEN_LBRACE,
+  TOKEN_RBRACE,
+  TOKEN_LPAREN,
+  TOKEN_RPAREN,
+  TOKEN_LBRACKET,
+  TOKEN_RBRACKET,
+  TOKEN_SEMICOLON,
+  TOKEN_PLUS,
+  TOKEN_MINUS,
+  TOKEN_SLASH,
+  TOKEN_STAR,
+  TOKEN_AMPERSAND,
+  TOKEN_COMMA,
+  TOKEN_DOT,
+  TOKEN_COLON,
+  TOKEN_LESS,
+  TOKEN_GREATER,
+  TOKEN_QUESTION,
+
+  // Anything that is not a valid identifier or number
+  TOKEN_INVALID,
+};
+typedef enum token_type token_type;
+
+#define TOKEN_IS_KEYWORD(t) ((t) >= TOKEN_FUNCTION && (t) <= TOKEN_CONST)
+#define TOKEN_IS_PUNCTUATOR(t) ((t) >= TOKEN_LBRACE && (t) <= TOKEN_QUESTION)
+
+// Tokens do not own their text, they are spans into the source they
+// were lexed from.
 struct token {
+  token_type type;
   uint64_t line;
   uint64_t col;
-  vector_char string;
+  uint64_t offset;
+  uint64_t length;
 };
 typedef struct token token;
 
 DECLARE_VECTOR(token)
 
-static void token_element_free(token *t) { vector_char_free(&t->string); }
-
+token_type lex_keyword(const char *, uint64_t);
 lex_error lex(vector_char, vector_token *);
 
 #endif
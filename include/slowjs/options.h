@@ -0,0 +1,24 @@
+#ifndef _OPTIONS_H_
+#define _OPTIONS_H_
+
+#include "slowjs/gc.h"
+#include "slowjs/inliner.h"
+#include "slowjs/jit.h"
+
+// Settings for a run of either interpreter.
+struct run_options {
+  gc_options gc;
+  // Print how often quickened arithmetic sites hit when the program
+  // finishes.
+  uint32_t quicken_stats;
+  inline_options inlining;
+  // Bytes the tree walker may use for calls that have not returned, 0
+  // for INTERPRET_DEFAULT_STACK_LIMIT. Recursing deeper is a RangeError.
+  uint64_t stack_limit;
+  jit_options jit;
+  // Where interpret and vm_interpret print the result, stdout if null.
+  FILE *out;
+};
+typedef struct run_options run_options;
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include "slowjs/slowjs.h"
+
+typedef enum {
+  E_PARALLEL_OK,
+  E_PARALLEL_MALLOC,
+  E_PARALLEL_THREAD,
+  E_PARALLEL_CALL
+} parallel_error;
+
+// Calls a worker claims from the shared count at a time, so threads do
+// not all contend on it for every call.
+#define PARALLEL_BATCH 64
+
+struct parallel_stats {
+  uint64_t calls;
+  // From when every thread was ready to when the last one finished.
+  double seconds;
+  // What the first failed call returned, or E_SLOWJS_OK.
+  slowjs_error error;
+};
+typedef struct parallel_stats parallel_stats;
+
+// Makes calls calls to the top-level function name with no arguments,
+// spread over threads threads. Each thread calls its own clone of s, so
+// they share the compiled program but nothing they write.
+parallel_error parallel_calls(slowjs_script *, const char *, uint32_t,
+                              uint64_t, parallel_stats *);
+
+#endif
@@ -12,22 +12,43 @@ typedef enum {
   E_PARSE_TOPLEVEL_DECLARATION,
 } parse_error;
 
-bool parse_declaration(vector_token *, declaration *);
-bool parse_number(vector_token *, double *);
-bool parse_literal(vector_token *, const char *);
-bool parse_identifier(vector_token *, vector_char *);
-bool parse_parameters(vector_token *, vector_string *);
-bool parse_function_call(vector_token *, function_call *);
-bool parse_binary_op(vector_token *, op *);
-bool parse_expression(vector_token *, expression *);
-bool parse_expressions(vector_token *, vector_expression *);
-bool parse_statement(vector_token *, statement *);
-bool parse_block(vector_token *, vector_statement *);
-bool parse_function_declaration(vector_token *, function_declaration *);
-bool parse_const_declaration(vector_token *, vector_variable_declaration *);
-bool parse_let_declaration(vector_token *, vector_variable_declaration *);
-bool parse_var_declaration(vector_token *, vector_variable_declaration *);
-bool parse_declaration(vector_token *, declaration *);
+struct parser {
+  vector_char source;
+  vector_token tokens;
+  // Cursor into tokens, the token array itself is never modified.
+  uint64_t index;
+
+  // Where the AST being built is allocated.
+  arena *arena;
+
+  // Scratch stacks for lists under construction.
+  vector_expression expressions;
+  vector_statement statements;
+  vector_string strings;
+};
+typedef struct parser parser;
+
+const char *token_text(parser *, token);
+bool peek_token(parser *, uint64_t, token *);
+bool token_copy_string(parser *, token, vector_char *);
+
+bool parse_number(parser *, double *);
+bool parse_literal(parser *, token_type);
+bool parse_identifier(parser *, vector_char *);
+bool parse_parameters(parser *, vector_string *);
+bool parse_function_call(parser *, function_call *);
+bool parse_primary(parser *, expression *);
+bool parse_postfix(parser *, expression *);
+bool parse_binary_op(parser *, int, expression *);
+bool parse_expression(parser *, expression *);
+bool parse_expressions(parser *, vector_expression *);
+bool parse_statement(parser *, statement *);
+bool parse_block(parser *, vector_statement *);
+bool parse_function_declaration(parser *, function_declaration *);
+bool parse_const_declaration(parser *, vector_variable_declaration *);
+bool parse_let_declaration(parser *, vector_variable_declaration *);
+bool parse_var_declaration(parser *, vector_variable_declaration *);
+bool parse_declaration(parser *, declaration *);
 parse_error parse(vector_char, ast *);
 
 #endif
@@ -0,0 +1,19 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stdint.h>
+
+typedef enum { E_POOL_OK, E_POOL_MALLOC } pool_error;
+
+typedef void (*pool_task)(void *, uint64_t);
+
+// Calls task(data, i) for every i below ntasks on up to threads
+// threads, the calling one included, and returns once all are done.
+//
+// Each thread starts with its own run of tasks and works through them
+// in order. One that runs out takes the last remaining task of another,
+// so a few slow tasks do not hold the rest up. If a thread cannot be
+// started the others take over its tasks.
+pool_error pool_run(uint32_t, uint64_t, pool_task, void *);
+
+#endif
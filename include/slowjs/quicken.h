@@ -0,0 +1,24 @@
+#ifndef _QUICKEN_H_
+#define _QUICKEN_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Arithmetic sites start out generic. The first time one sees two
+// numbers it rewrites itself into a number-only variant that checks its
+// operands and rewrites itself back when they are not both numbers.
+struct quicken_stats {
+  // Sites rewritten into their number-only variant.
+  uint64_t quickened;
+  // Number-only sites run with numbers.
+  uint64_t hits;
+  // Number-only sites that got something else and went back.
+  uint64_t misses;
+  // Generic sites run.
+  uint64_t generic;
+};
+typedef struct quicken_stats quicken_stats;
+
+void quicken_print_stats(quicken_stats *, FILE *);
+
+#endif
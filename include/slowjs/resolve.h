@@ -0,0 +1,27 @@
+#ifndef _RESOLVE_H_
+#define _RESOLVE_H_
+
+#include "slowjs/flat.h"
+
+typedef enum {
+  E_RESOLVE_OK,
+  E_RESOLVE_MALLOC,
+  E_RESOLVE_UNDEFINED
+} resolve_error;
+
+// Assigns every parameter and function declaration a slot and rewrites
+// identifiers into FLAT_LOCAL or FLAT_GLOBAL references to them.
+// Function declarations are hoisted to the top of their scope. Every
+// name that cannot be resolved is reported before failing.
+resolve_error resolve(flat_ast *);
+
+// Turns calls whose value is returned directly, including through
+// either branch of a conditional that is returned, into FLAT_TAIL_CALL
+// so they can reuse the frame of the call they return from. resolve
+// does this, passes that move expressions around have to again.
+void resolve_tail_calls(flat_ast *);
+
+// The function main resolves to, or UINT32_MAX.
+uint32_t resolve_main(flat_ast *);
+
+#endif
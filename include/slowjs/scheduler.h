@@ -0,0 +1,55 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include "slowjs/common.h"
+#include "slowjs/slowjs.h"
+
+// Runs calls to many scripts on one thread by taking turns. Each turn,
+// or slice, lets a call make a fixed number of calls of its own before
+// the next one gets to go, so one that runs long or forever only slows
+// the rest down and never holds them up.
+
+struct scheduler_task {
+  slowjs_script *script;
+  // Set once the call has returned or failed. A task stopped for going
+  // over the limit fails with E_SLOWJS_YIELD.
+  bool done;
+  slowjs_error error;
+  value result;
+  // Slices and calls this task has used so far.
+  uint64_t slices;
+  uint64_t fuel;
+  struct scheduler_task *next;
+};
+typedef struct scheduler_task scheduler_task;
+
+// Tasks waiting for a slice, in turn order. The tasks themselves belong
+// to the caller.
+struct scheduler {
+  uint64_t slice;
+  // Calls a task may make in all before it is stopped, 0 for no end.
+  uint64_t limit;
+  scheduler_task *head;
+  scheduler_task *tail;
+  uint64_t waiting;
+};
+typedef struct scheduler scheduler;
+
+// The calls a task makes per slice if none is given.
+#define SCHEDULER_DEFAULT_SLICE 1000
+
+// Takes the slice and the limit, see scheduler.
+void scheduler_init(scheduler *, uint64_t, uint64_t);
+// Starts t calling the top-level function name of t->script, which must
+// not be in the middle of another call. The first slice runs right away
+// and t waits for more only if it has not finished by then. Sets the
+// fuel of the script.
+void scheduler_start(scheduler *, scheduler_task *, const char *, value *,
+                     uint32_t);
+// Gives the task whose turn it is one slice. Returns false if there was
+// none waiting.
+bool scheduler_step(scheduler *);
+// Steps until every task has finished.
+void scheduler_run(scheduler *);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include "slowjs/common.h"
+#include "slowjs/intern.h"
+#include "slowjs/options.h"
+#include "slowjs/scheduler.h"
+
+// A daemon answering calls over a Unix domain socket, so scripts are
+// read, parsed and compiled once rather than on every run.
+//
+// Each request is one line: the path of a script, the name of one of
+// its top-level functions and any number of numeric arguments, all
+// separated by spaces. The answer is one line too, what the command
+// line would print for the value returned, or "error " and a reason.
+// A connection may send more requests before the answers come back,
+// they are answered in order.
+//
+//   /tmp/fib.js fib 20
+//   6765.000000
+//
+// Scripts are compiled the first time they are asked for and again
+// whenever their modification time, size or inode changes. Calls take
+// turns on one thread, see scheduler.h, so a slow one does not hold up
+// the others.
+
+typedef enum {
+  E_SERVER_OK,
+  E_SERVER_MALLOC,
+  E_SERVER_SOCKET,
+  E_SERVER_EPOLL
+} server_error;
+
+// Calls a request may make before it fails, so one that never returns
+// does not run for good.
+#define SERVER_DEFAULT_LIMIT (1ULL << 30)
+// Longest request line, longer ones close the connection.
+#define SERVER_MAX_REQUEST (1 << 16)
+#define SERVER_MAX_ARGS 16
+
+struct server_options {
+  run_options run;
+  // Calls per turn, 0 for SCHEDULER_DEFAULT_SLICE.
+  uint64_t slice;
+  // 0 for SERVER_DEFAULT_LIMIT.
+  uint64_t limit;
+};
+typedef struct server_options server_options;
+
+struct server_stats {
+  uint64_t connections;
+  uint64_t requests;
+  uint64_t failed;
+  // Times a script was compiled, the first time included.
+  uint64_t compiles;
+};
+typedef struct server_stats server_stats;
+
+struct server_script;
+struct server_connection;
+
+struct server {
+  server_options options;
+  char *path;
+  int listener;
+  int epoll;
+  // Written to by server_stop.
+  int wake;
+  bool stopping;
+  scheduler tasks;
+  // Scripts by the id of their path.
+  interner paths;
+  struct server_script **scripts;
+  uint64_t nscripts;
+  struct server_connection *connections;
+  server_stats stats;
+};
+typedef struct server server;
+
+// Listens on the socket at path, replacing whatever file is there.
+server_error server_init(server *, const char *, server_options);
+// Answers requests until server_stop is called.
+server_error server_run(server *);
+// Makes server_run return. It only writes to a descriptor, so it can be
+// called from another thread or a signal handler.
+void server_stop(server *);
+// Closes every connection and removes the socket.
+void server_free(server *);
+void server_print_stats(server_stats *, FILE *);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _SLOWJS_H_
+#define _SLOWJS_H_
+
+#include "slowjs/compile.h"
+#include "slowjs/flat.h"
+#include "slowjs/options.h"
+#include "slowjs/value.h"
+#include "slowjs/vm.h"
+
+// The library interface for embedding: a script is lexed, parsed and
+// compiled once and then its top-level functions can be called any
+// number of times.
+
+typedef enum {
+  E_SLOWJS_OK,
+  E_SLOWJS_MALLOC,
+  E_SLOWJS_PARSE,
+  E_SLOWJS_COMPILE,
+  E_SLOWJS_NOT_FOUND,
+  E_SLOWJS_CALL_NONFUNCTION,
+  E_SLOWJS_STACK_OVERFLOW,
+  E_SLOWJS_YIELD
+} slowjs_error;
+
+// What compiling a script produces. Nothing changes it afterwards, the
+// VM quickens and compiles its own copy of the code, so it can be read
+// from any number of threads at once.
+struct slowjs_program {
+  flat_ast flat;
+  // The top-level function each name id refers to, or UINT32_MAX, so
+  // calls by name cost a hash lookup however big the script is.
+  uint32_t *functions;
+  bytecode bc;
+  // Scripts sharing the program, changed atomically.
+  uint32_t references;
+};
+typedef struct slowjs_program slowjs_program;
+
+struct slowjs_script {
+  slowjs_program *program;
+  // Stays loaded with the program's bytecode, so quickened code and
+  // anything the JIT compiled are kept from call to call.
+  vm m;
+};
+typedef struct slowjs_script slowjs_script;
+
+// Compiles the NUL-terminated source with options into a new script. It
+// does not need main and nothing is run.
+slowjs_error slowjs_compile(const char *, run_options, slowjs_script **);
+// Calls the top-level function named name with nargs arguments and
+// stores what it returns in result. Arguments are made with
+// number_value, BOOL_VALUE and NULL_VALUE from value.h. A function
+// returned is only valid until the next call.
+//
+// A script runs one call at a time, see slowjs_clone.
+slowjs_error slowjs_call(slowjs_script *, const char *, value *, uint32_t,
+                         value *);
+// Has calls of s return E_SLOWJS_YIELD each time they have made fuel
+// more calls, or run to the end if it is 0. See scheduler.h.
+void slowjs_set_fuel(slowjs_script *, uint64_t);
+// Carries on with the call that last returned E_SLOWJS_YIELD.
+slowjs_error slowjs_resume(slowjs_script *, value *);
+// The number of calls s has made so far, in all its calls.
+uint64_t slowjs_fuel_used(slowjs_script *);
+// Makes a script that shares the compiled program of s but has a VM of
+// its own, so each can be called from a different thread at the same
+// time. They can be freed in any order.
+slowjs_error slowjs_clone(slowjs_script *, slowjs_script **);
+void slowjs_free(slowjs_script *);
+
+#endif
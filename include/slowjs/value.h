@@ -0,0 +1,111 @@
+#ifndef _VALUE_H_
+#define _VALUE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Values are NaN-boxed into 64 bits. Any bit pattern without all of
+// VALUE_QNAN set is a double; NaNs produced by arithmetic never set
+// them all so they stay numbers. The rest tag null and the booleans in
+// the low bits or, with the sign bit set too, hold a closure pointer in
+// the low 48 bits.
+typedef uint64_t value;
+
+#define VALUE_SIGN ((uint64_t)0x8000000000000000)
+#define VALUE_QNAN ((uint64_t)0x7ffc000000000000)
+#define VALUE_NAN ((uint64_t)0x7ff8000000000000)
+
+#define NULL_VALUE ((value)(VALUE_QNAN | 1))
+#define FALSE_VALUE ((value)(VALUE_QNAN | 2))
+#define TRUE_VALUE ((value)(VALUE_QNAN | 3))
+
+#define IS_NUMBER(v) (((v)&VALUE_QNAN) != VALUE_QNAN)
+#define IS_BOOL(v) (((v) | 1) == TRUE_VALUE)
+#define IS_FUNCTION(v)                                                         \
+  (((v) & (VALUE_SIGN | VALUE_QNAN)) == (VALUE_SIGN | VALUE_QNAN))
+
+#define BOOL_VALUE(b) ((b) ? TRUE_VALUE : FALSE_VALUE)
+#define FUNCTION_VALUE(c) ((value)(VALUE_SIGN | VALUE_QNAN | (uintptr_t)(c)))
+#define AS_CLOSURE(v)                                                          \
+  ((closure *)(uintptr_t)((v) & ~(VALUE_SIGN | VALUE_QNAN)))
+
+enum value_type { VALUE_NUMBER, VALUE_FUNCTION, VALUE_NULL, VALUE_BOOL };
+typedef enum value_type value_type;
+
+enum object_type { OBJECT_ENV, OBJECT_CLOSURE };
+typedef enum object_type object_type;
+
+// Header of everything the collector manages.
+struct object {
+  // The next object on the same heap.
+  struct object *next;
+  object_type type;
+  // A gc_color.
+  uint32_t color;
+};
+typedef struct object object;
+
+// Slots of a call that nested functions may capture.
+struct env {
+  object header;
+  struct env *parent;
+  uint32_t size;
+  value values[];
+};
+typedef struct env env;
+
+struct closure {
+  object header;
+  uint32_t function;
+  // Slots of the call the function was declared in, null at the top
+  // level.
+  env *env;
+};
+typedef struct closure closure;
+
+static inline value number_value(double d) {
+  value v = 0;
+
+  memcpy(&v, &d, sizeof(v));
+  return v;
+}
+
+static inline double value_number(value v) {
+  double d = 0;
+
+  memcpy(&d, &v, sizeof(d));
+  return d;
+}
+
+// Operand of arithmetic: booleans are 0 or 1, null is 0 and functions
+// are NaN.
+static inline double value_to_number(value v) {
+  if (IS_NUMBER(v)) {
+    return value_number(v);
+  }
+
+  if (IS_FUNCTION(v)) {
+    return value_number(VALUE_NAN);
+  }
+
+  return v == TRUE_VALUE;
+}
+
+// null, false, 0 and NaN are falsy.
+static inline int value_truthy(value v) {
+  double d = 0;
+
+  if (IS_NUMBER(v)) {
+    d = value_number(v);
+    return d == d && d != 0;
+  }
+
+  return v != NULL_VALUE && v != FALSE_VALUE;
+}
+
+value_type value_typeof(value);
+void value_fprint(value, FILE *);
+void value_print(value);
+
+#endif
@@ -159,5 +159,8 @@ typedef enum {
 DECLARE_VECTOR(char)
 typedef vector_char string;
 DECLARE_VECTOR(string)
+DECLARE_VECTOR(uint8_t)
+DECLARE_VECTOR(uint32_t)
+DECLARE_VECTOR(double)
 
 #endif
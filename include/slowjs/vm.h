@@ -0,0 +1,88 @@
+#ifndef _VM_H_
+#define _VM_H_
+
+#include "slowjs/ast.h"
+#include "slowjs/compile.h"
+#include "slowjs/options.h"
+#include "slowjs/quicken.h"
+#include "slowjs/value.h"
+
+typedef enum {
+  E_VM_OK,
+  E_VM_MALLOC,
+  E_VM_NO_MAIN,
+  E_VM_RESOLVE,
+  E_VM_COMPILE,
+  E_VM_CALL_NONFUNCTION,
+  E_VM_STACK_OVERFLOW,
+  E_VM_YIELD
+} vm_error;
+
+struct vm_frame {
+  uint8_t *ip;
+  value *base;
+  env *env;
+};
+typedef struct vm_frame vm_frame;
+
+// Both stacks are allocated once up front and never grow.
+struct vm {
+  run_options options;
+  // Private copy of the code being run, which quickening rewrites.
+  uint8_t *code;
+  uint64_t code_size;
+  quicken_stats quicken;
+  value *stack;
+  uint64_t stack_size;
+  vm_frame *frames;
+  uint64_t frames_size;
+  // Closure of every function with no env, for the program last run.
+  closure *functions;
+  uint64_t nfunctions;
+  // Machine code for the program last run, if options.jit is enabled.
+  jit jit;
+  gc heap;
+  // Where vm_run was when it last allocated or yielded, for the
+  // collector and vm_resume.
+  value *sp;
+  vm_frame *frame;
+  env *env;
+  // Set while a call that yielded waits to be resumed.
+  uint8_t *ip;
+  value *base;
+  // Calls a call may make before it yields, or 0 to run to the end.
+  uint64_t fuel;
+  // Calls made so far, whether or not fuel is set.
+  uint64_t fuel_used;
+};
+typedef struct vm vm;
+
+#define VM_STACK_SIZE (1 << 20)
+#define VM_FRAMES_SIZE (1 << 16)
+
+vm_error vm_init(vm *, run_options);
+// Gets the vm ready to call functions of bc, which has to outlive those
+// calls. Quickening and the JIT carry over from one call to the next.
+vm_error vm_load(vm *, bytecode *);
+// Calls function of the bytecode last loaded with nargs arguments from
+// args. Closures in result stay valid until the next call.
+//
+// With fuel set it returns E_VM_YIELD once it has made that many calls,
+// and vm_resume carries on from there. Code the JIT compiled cannot be
+// stopped, so it is not used while fuel is set.
+vm_error vm_call(vm *, bytecode *, uint32_t, value *, uint32_t, value *);
+// Continues the call that last returned E_VM_YIELD with fuel calls more.
+// Calling vm_call instead drops it.
+vm_error vm_resume(vm *, bytecode *, value *);
+// Loads bc and calls function with no arguments.
+vm_error vm_run(vm *, bytecode *, uint32_t, value *);
+void vm_free(vm *);
+// Flattens, resolves, inlines and compiles program into bc. The flat
+// ast is only needed until then.
+vm_error vm_compile(ast, run_options, flat_ast *, bytecode *);
+// Runs main of bc in a new vm and prints what it returns.
+vm_error vm_run_main(bytecode *, run_options);
+// vm_compile and then vm_run_main.
+vm_error vm_interpret(ast, run_options);
+
+#endif
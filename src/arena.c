@@ -0,0 +1,71 @@
+#include "slowjs/arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN(n) (((n) + 15) & ~(uint64_t)15)
+#define ARENA_CHUNK_HEADER ARENA_ALIGN(sizeof(arena_chunk))
+
+void *arena_alloc(arena *a, uint64_t size) {
+  arena_chunk *chunk = a->head;
+  uint64_t chunk_size = ARENA_CHUNK_SIZE;
+  void *out = 0;
+
+  size = ARENA_ALIGN(size);
+  if (chunk == 0 || chunk->size - chunk->used < size) {
+    if (size > chunk_size - ARENA_CHUNK_HEADER) {
+      chunk_size = size + ARENA_CHUNK_HEADER;
+    }
+
+    chunk = (arena_chunk *)malloc(chunk_size);
+    if (chunk == 0) {
+      return 0;
+    }
+
+    chunk->size = chunk_size;
+    chunk->used = ARENA_CHUNK_HEADER;
+
+    // Oversized allocations get a chunk of their own behind the head so
+    // the rest of the current chunk is not wasted.
+    if (a->head && chunk_size > ARENA_CHUNK_SIZE) {
+      chunk->next = a->head->next;
+      a->head->next = chunk;
+    } else {
+      chunk->next = a->head;
+      a->head = chunk;
+    }
+
+    a->chunks++;
+  }
+
+  out = (char *)chunk + chunk->used;
+  chunk->used += size;
+  a->allocations++;
+  a->bytes += size;
+  return out;
+}
+
+void *arena_copy(arena *a, const void *src, uint64_t size) {
+  void *out = arena_alloc(a, size);
+
+  // Empty runs may come from a null src, which memcpy does not allow
+  // even for no bytes.
+  if (out != 0 && size > 0) {
+    memcpy(out, src, size);
+  }
+
+  return out;
+}
+
+void arena_free(arena *a) {
+  arena_chunk *chunk = a->head, *next = 0;
+
+  while (chunk) {
+    next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  *a = (arena){0};
+}
@@ -1,93 +1,153 @@
 #include "slowjs/ast.h"
 
-#include "slowjs/lex.h"
+#include <stdlib.h>
 
-void function_call_free(function_call *fc) {
-  int i = 0;
+void ast_print_number(double, FILE *);
+void ast_print_operand(expression *, FILE *);
+void ast_print_expression(expression *, FILE *);
+void ast_print_statements(vector_statement *, uint64_t, FILE *);
+void ast_print_declaration(declaration *, uint64_t, FILE *);
 
-  expression_free(fc->function);
-  free(fc->function);
+void ast_free(ast *a) {
+  arena_free(&a->arena);
+  vector_declaration_free(&a->declarations);
+}
+
+// Shortest form that reads back as the same double. Folding can produce
+// NaN and infinities, which are written the way JavaScript prints them.
+void ast_print_number(double d, FILE *out) {
+  char buf[32] = {0};
+
+  if (d != d) {
+    fputs("NaN", out);
+    return;
+  }
+
+  if (d - d != 0) {
+    fputs(d < 0 ? "-Infinity" : "Infinity", out);
+    return;
+  }
 
-  for (i = 0; i < fc->arguments->index; i++) {
-    expression_free(&fc->arguments->elements[i]);
-    free(fc->arguments);
+  snprintf(buf, sizeof(buf), "%.15g", d);
+  if (strtod(buf, 0) != d) {
+    snprintf(buf, sizeof(buf), "%.17g", d);
   }
+  fputs(buf, out);
 }
 
-void op_free(op *o) {
-  expression_free(o->left_operand);
-  free(o->left_operand);
-  expression_free(o->right_operand);
-  free(o->right_operand);
+// Nested operations are parenthesized so precedence never matters.
+void ast_print_operand(expression *e, FILE *out) {
+  if (e->type == EXPRESSION_OP || e->type == EXPRESSION_CONDITIONAL) {
+    fputc('(', out);
+    ast_print_expression(e, out);
+    fputc(')', out);
+    return;
+  }
+
+  ast_print_expression(e, out);
 }
 
-void expression_free(expression *e) {
+void ast_print_expression(expression *e, FILE *out) {
+  const char *ops[] = {" + ", " - ", " * ", " / ", " < ", " > "};
+  function_call *fc = 0;
+  uint64_t i = 0;
+
   switch (e->type) {
   case EXPRESSION_CALL:
-    function_call_free(&e->expression.function_call);
+    fc = &e->expression.function_call;
+    ast_print_operand(fc->function, out);
+    fputc('(', out);
+    for (i = 0; i < fc->arguments->index; i++) {
+      if (i > 0) {
+        fputs(", ", out);
+      }
+      ast_print_expression(&fc->arguments->elements[i], out);
+    }
+    fputc(')', out);
     break;
   case EXPRESSION_OP:
-    op_free(&e->expression.op);
+    ast_print_operand(e->expression.op.left_operand, out);
+    fputs(ops[e->expression.op.type], out);
+    ast_print_operand(e->expression.op.right_operand, out);
+    break;
+  case EXPRESSION_CONDITIONAL:
+    ast_print_operand(e->expression.conditional.test, out);
+    fputs(" ? ", out);
+    ast_print_operand(e->expression.conditional.consequent, out);
+    fputs(" : ", out);
+    ast_print_operand(e->expression.conditional.alternate, out);
     break;
   case EXPRESSION_IDENTIFIER:
-    vector_char_free(&e->expression.identifier);
+    fputs(e->expression.identifier.elements, out);
     break;
-  case EXPRESSION_BOOL:
-  case EXPRESSION_NULL:
   case EXPRESSION_NUMBER:
+    ast_print_number(e->expression.number, out);
     break;
-  }
-}
-
-void variable_declaration_free(variable_declaration *vd) {
-  vector_char_free(&vd->name);
-  expression_free(&vd->initializer);
-}
-
-void statement_free(statement *s) {
-  switch (s->type) {
-  case STATEMENT_EXPRESSION:
-    expression_free(&s->statement.expression);
-    break;
-  case STATEMENT_RETURN:
-    expression_free(&s->statement.ret);
+  case EXPRESSION_NULL:
+    fputs("null", out);
     break;
-  case STATEMENT_DECLARATION:
-    declaration_free(s->statement.declaration);
-    free(s->statement.declaration);
+  case EXPRESSION_BOOL:
+    fputs(e->expression.number ? "true" : "false", out);
     break;
   }
 }
 
-void function_declaration_free(function_declaration *fd) {
-  int i = 0;
+void ast_print_statements(vector_statement *body, uint64_t depth,
+                          FILE *out) {
+  statement *s = 0;
+  uint64_t i = 0;
 
-  vector_char_free(&fd->name);
-  vector_string_free(&fd->parameters);
+  for (i = 0; i < body->index; i++) {
+    s = &body->elements[i];
+    if (s->type == STATEMENT_DECLARATION) {
+      ast_print_declaration(s->statement.declaration, depth, out);
+      continue;
+    }
 
-  for (i = 0; i < fd->body.index; i++) {
-    statement_free(&fd->body.elements[i]);
+    fprintf(out, "%*s", (int)(depth * 2), "");
+    if (s->type == STATEMENT_RETURN) {
+      fputs("return ", out);
+      ast_print_expression(&s->statement.ret, out);
+    } else {
+      ast_print_expression(&s->statement.expression, out);
+    }
+    fputs(";\n", out);
   }
 }
 
-void declaration_free(declaration *d) {
-  int i = 0;
+void ast_print_declaration(declaration *d, uint64_t depth, FILE *out) {
+  const char *kinds[] = {"function", "var", "const", "let"};
+  function_declaration *fd = 0;
+  variable_declaration *vd = 0;
+  uint64_t i = 0;
 
-  switch (d->type) {
-  case DECLARATION_FUNCTION:
-    function_declaration_free(&d->declaration.function);
-    break;
-  default:
+  fprintf(out, "%*s%s ", (int)(depth * 2), "", kinds[d->type]);
+  if (d->type != DECLARATION_FUNCTION) {
     for (i = 0; i < d->declaration.variable_list.index; i++) {
-      variable_declaration_free(&d->declaration.variable_list.elements[i]);
+      vd = &d->declaration.variable_list.elements[i];
+      fprintf(out, "%s%s = ", i > 0 ? ", " : "", vd->name.elements);
+      ast_print_expression(&vd->initializer, out);
     }
+    fputs(";\n", out);
+    return;
   }
+
+  fd = &d->declaration.function;
+  fprintf(out, "%s(", fd->name.elements);
+  for (i = 0; i < fd->parameters.index; i++) {
+    fprintf(out, "%s%s", i > 0 ? ", " : "",
+            fd->parameters.elements[i].elements);
+  }
+  fputs(") {\n", out);
+  ast_print_statements(&fd->body, depth + 1, out);
+  fprintf(out, "%*s}\n", (int)(depth * 2), "");
 }
 
-void ast_free(ast *a) {
-  int i = 0;
+// Prints the program back as source.
+void ast_print(ast *a, FILE *out) {
+  uint64_t i = 0;
 
   for (i = 0; i < a->declarations.index; i++) {
-    declaration_free(&a->declarations.elements[i]);
+    ast_print_declaration(&a->declarations.elements[i], 0, out);
   }
 }
@@ -0,0 +1,158 @@
+#include "slowjs/batch.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "slowjs/common.h"
+#include "slowjs/file.h"
+#include "slowjs/fold.h"
+#include "slowjs/interpret.h"
+#include "slowjs/parse.h"
+#include "slowjs/pool.h"
+#include "slowjs/vm.h"
+
+struct batch_file {
+  char *path;
+  // What running the file printed.
+  char *output;
+  size_t size;
+  bool failed;
+  double read;
+  double parse;
+  double fold;
+  double run;
+};
+typedef struct batch_file batch_file;
+
+struct batch {
+  batch_options options;
+  batch_file *files;
+};
+typedef struct batch batch;
+
+double batch_now();
+void batch_file_run(void *, uint64_t);
+
+double batch_now() {
+  struct timespec ts = {0};
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void batch_file_run(void *data, uint64_t index) {
+  batch *b = (batch *)data;
+  batch_file *f = &b->files[index];
+  run_options options = b->options.run;
+  vector_char source = {0};
+  ast program = {0};
+  FILE *out = 0;
+  double start = 0;
+  int err = 0;
+
+  out = open_memstream(&f->output, &f->size);
+  if (out == 0) {
+    f->failed = true;
+    return;
+  }
+
+  start = batch_now();
+  err = read_file(f->path, &source);
+  f->read = batch_now() - start;
+  if (err != E_FILE_OK) {
+    fprintf(out, "Error reading file.\n");
+    goto cleanup_file;
+  }
+
+  start = batch_now();
+  err = parse(source, &program);
+  f->parse = batch_now() - start;
+  if (err != E_PARSE_OK) {
+    fprintf(out, "Error parsing program.\n");
+    goto cleanup_parse;
+  }
+
+  start = batch_now();
+  fold(&program);
+  f->fold = batch_now() - start;
+
+  start = batch_now();
+  options.out = out;
+  if (b->options.vm) {
+    err = vm_interpret(program, options);
+  } else {
+    err = interpret(program, options);
+  }
+  f->run = batch_now() - start;
+  if (err != E_INTERPRET_OK) {
+    fprintf(out, "Error interpreting program.\n");
+  }
+
+  ast_free(&program);
+cleanup_parse:
+  vector_char_free(&source);
+cleanup_file:
+  f->failed = err != 0;
+  fclose(out);
+}
+
+batch_error batch_run(char **paths, uint64_t npaths, batch_options options,
+                      FILE *out, batch_stats *stats) {
+  batch b = {0};
+  batch_file *f = 0;
+  double start = batch_now();
+  uint64_t i = 0;
+  batch_error err = E_BATCH_OK;
+
+  *stats = (batch_stats){0};
+  b.options = options;
+  b.files = (batch_file *)calloc(npaths, sizeof(batch_file));
+  if (b.files == 0 && npaths > 0) {
+    return E_BATCH_MALLOC;
+  }
+
+  for (i = 0; i < npaths; i++) {
+    b.files[i].path = paths[i];
+  }
+
+  if (pool_run(options.threads, npaths, batch_file_run, &b) != E_POOL_OK) {
+    err = E_BATCH_MALLOC;
+    goto cleanup;
+  }
+
+  for (i = 0; i < npaths; i++) {
+    f = &b.files[i];
+    fprintf(out, "%s: ", f->path);
+    if (f->output == 0) {
+      fprintf(out, "Error running program.\n");
+    } else {
+      fwrite(f->output, 1, f->size, out);
+    }
+
+    stats->files++;
+    stats->failed += f->failed;
+    stats->read += f->read;
+    stats->parse += f->parse;
+    stats->fold += f->fold;
+    stats->run += f->run;
+  }
+  stats->threads = options.threads < npaths ? options.threads : npaths;
+  stats->wall = batch_now() - start;
+
+cleanup:
+  for (i = 0; i < npaths; i++) {
+    free(b.files[i].output);
+  }
+  free(b.files);
+  return err;
+}
+
+void batch_print_stats(batch_stats *stats, FILE *out) {
+  fprintf(out, "batch: %llu files, %llu failed, %.3fs on %u threads\n",
+          (unsigned long long)stats->files,
+          (unsigned long long)stats->failed, stats->wall, stats->threads);
+  fprintf(out,
+          "batch: read %.3fs, parse %.3fs, fold %.3fs, run %.3fs summed "
+          "over files\n",
+          stats->read, stats->parse, stats->fold, stats->run);
+}
@@ -0,0 +1,207 @@
+#include "slowjs/cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slowjs/common.h"
+
+// The header, then the constants, the functions and the code, each
+// right after the other. The header and functions are multiples of 8
+// bytes so every section is aligned for what it holds.
+struct cache_header {
+  char magic[8];
+  uint32_t version;
+  // CACHE_ORDER as the writer saw it, images from a machine of the
+  // other byte order do not match.
+  uint32_t order;
+  uint64_t hash;
+  uint64_t source_size;
+  uint32_t inline_max_size;
+  uint32_t main;
+  uint64_t nconstants;
+  uint64_t nfunctions;
+  uint64_t ncode;
+};
+typedef struct cache_header cache_header;
+
+#define CACHE_MAGIC "slowjsbc"
+#define CACHE_ORDER 0x01020304
+
+void cache_path(char *, uint64_t, const char *, vector_char *, run_options);
+void cache_header_init(cache_header *, vector_char *, run_options,
+                       bytecode *);
+bool cache_header_valid(cache_header *, uint64_t, vector_char *,
+                        run_options);
+
+uint64_t cache_hash(const char *data, uint64_t length) {
+  uint64_t h = 0xcbf29ce484222325ULL ^ length, word = 0, i = 0;
+
+  for (i = 0; i + sizeof(word) <= length; i += sizeof(word)) {
+    memcpy(&word, data + i, sizeof(word));
+    h = (h ^ word) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+  }
+
+  word = 0;
+  if (length > i) {
+    memcpy(&word, data + i, length - i);
+  }
+  h = (h ^ word) * 0x9e3779b97f4a7c15ULL;
+
+  // Spreads the last word over every bit.
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+void cache_path(char *path, uint64_t size, const char *dir,
+                vector_char *source, run_options options) {
+  snprintf(path, size, "%s/%016llx-%u.image", dir,
+           (unsigned long long)cache_hash(source->elements, source->index),
+           options.inlining.max_size);
+}
+
+void cache_header_init(cache_header *h, vector_char *source,
+                       run_options options, bytecode *bc) {
+  memcpy(h->magic, CACHE_MAGIC, sizeof(h->magic));
+  h->version = CACHE_VERSION;
+  h->order = CACHE_ORDER;
+  h->hash = cache_hash(source->elements, source->index);
+  h->source_size = source->index;
+  h->inline_max_size = options.inlining.max_size;
+  h->main = bc ? bc->main : 0;
+  h->nconstants = bc ? bc->constants.index : 0;
+  h->nfunctions = bc ? bc->functions.index : 0;
+  h->ncode = bc ? bc->code.index : 0;
+}
+
+// Checks h against what it should be for source and that the sections
+// it describes fill the rest of the size bytes exactly.
+bool cache_header_valid(cache_header *h, uint64_t size, vector_char *source,
+                        run_options options) {
+  cache_header expected = {0};
+
+  cache_header_init(&expected, source, options, 0);
+  if (memcmp(h->magic, expected.magic, sizeof(h->magic)) != 0 ||
+      h->version != expected.version || h->order != expected.order ||
+      h->hash != expected.hash || h->source_size != expected.source_size ||
+      h->inline_max_size != expected.inline_max_size) {
+    return false;
+  }
+
+  // Counts this large could only come from a corrupt image and would
+  // overflow the sum below.
+  if (h->nconstants > size || h->nfunctions > size || h->ncode > size) {
+    return false;
+  }
+
+  return size == sizeof(cache_header) + sizeof(double) * h->nconstants +
+                     sizeof(bc_function) * h->nfunctions + h->ncode &&
+         (h->main == UINT32_MAX || h->main < h->nfunctions);
+}
+
+cache_error cache_load(const char *dir, vector_char *source,
+                       run_options options, cache_image *image) {
+  char path[4096] = {0};
+  struct stat st = {0};
+  cache_header *h = 0;
+  uint8_t *sections = 0;
+  uint64_t i = 0;
+  int fd = 0;
+
+  *image = (cache_image){0};
+  cache_path(path, sizeof(path), dir, source, options);
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return E_CACHE_MISS;
+  }
+
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(cache_header)) {
+    close(fd);
+    return E_CACHE_MISS;
+  }
+
+  image->size = st.st_size;
+  image->map = mmap(0, image->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image->map == MAP_FAILED) {
+    *image = (cache_image){0};
+    return E_CACHE_MISS;
+  }
+
+  h = (cache_header *)image->map;
+  if (!cache_header_valid(h, image->size, source, options)) {
+    cache_image_free(image);
+    return E_CACHE_MISS;
+  }
+
+  sections = (uint8_t *)image->map + sizeof(cache_header);
+  image->bc.constants.elements = (double *)sections;
+  image->bc.constants.index = h->nconstants;
+  image->bc.constants.size = h->nconstants;
+  sections += sizeof(double) * h->nconstants;
+  image->bc.functions.elements = (bc_function *)sections;
+  image->bc.functions.index = h->nfunctions;
+  image->bc.functions.size = h->nfunctions;
+  sections += sizeof(bc_function) * h->nfunctions;
+  image->bc.code.elements = sections;
+  image->bc.code.index = h->ncode;
+  image->bc.code.size = h->ncode;
+  image->bc.main = h->main;
+
+  for (i = 0; i < h->nfunctions; i++) {
+    if (image->bc.functions.elements[i].code >= h->ncode) {
+      cache_image_free(image);
+      return E_CACHE_MISS;
+    }
+  }
+
+  return E_CACHE_OK;
+}
+
+cache_error cache_store(const char *dir, vector_char *source,
+                        run_options options, bytecode *bc) {
+  char path[4096] = {0}, temporary[4096 + 32] = {0};
+  cache_header h = {0};
+  FILE *out = 0;
+  bool written = false;
+
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    return E_CACHE_WRITE;
+  }
+
+  cache_path(path, sizeof(path), dir, source, options);
+  snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid());
+  out = fopen(temporary, "wb");
+  if (out == 0) {
+    return E_CACHE_WRITE;
+  }
+
+  cache_header_init(&h, source, options, bc);
+  written =
+      fwrite(&h, sizeof(h), 1, out) == 1 &&
+      fwrite(bc->constants.elements, sizeof(double), bc->constants.index,
+             out) == bc->constants.index &&
+      fwrite(bc->functions.elements, sizeof(bc_function), bc->functions.index,
+             out) == bc->functions.index &&
+      fwrite(bc->code.elements, 1, bc->code.index, out) == bc->code.index;
+  if (fclose(out) != 0 || !written || rename(temporary, path) != 0) {
+    unlink(temporary);
+    return E_CACHE_WRITE;
+  }
+
+  return E_CACHE_OK;
+}
+
+void cache_image_free(cache_image *image) {
+  if (image->map) {
+    munmap(image->map, image->size);
+  }
+  *image = (cache_image){0};
+}
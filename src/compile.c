@@ -0,0 +1,282 @@
+#include "slowjs/compile.h"
+
+#include "slowjs/common.h"
+#include "slowjs/resolve.h"
+
+struct compiler {
+  flat_ast *flat;
+  bytecode *out;
+  // Whether the function being compiled keeps its slots in an env.
+  uint32_t heap_slots;
+  uint32_t depth;
+  uint32_t max_stack;
+};
+typedef struct compiler compiler;
+
+compile_error compile_emit(compiler *, opcode, int32_t);
+compile_error compile_emit_word(compiler *, uint32_t);
+compile_error compile_emit_operand(compiler *, opcode, uint32_t, int32_t);
+void compile_patch(compiler *, uint32_t, uint32_t);
+compile_error compile_expression(compiler *, uint32_t);
+compile_error compile_function(compiler *, uint32_t);
+
+// Emits op and tracks how it moves the operand stack.
+compile_error compile_emit(compiler *c, opcode op, int32_t effect) {
+  if (vector_uint8_t_push(&c->out->code, op) != E_VECTOR_OK) {
+    return E_COMPILE_MALLOC;
+  }
+
+  c->depth += effect;
+  if (c->depth > c->max_stack) {
+    c->max_stack = c->depth;
+  }
+
+  return E_COMPILE_OK;
+}
+
+compile_error compile_emit_word(compiler *c, uint32_t word) {
+  uint8_t bytes[BC_OPERAND_SIZE] = {0};
+  uint64_t i = 0;
+
+  memcpy(bytes, &word, BC_OPERAND_SIZE);
+  for (i = 0; i < BC_OPERAND_SIZE; i++) {
+    if (vector_uint8_t_push(&c->out->code, bytes[i]) != E_VECTOR_OK) {
+      return E_COMPILE_MALLOC;
+    }
+  }
+
+  if (c->out->code.index >= UINT32_MAX) {
+    return E_COMPILE_TOO_BIG;
+  }
+
+  return E_COMPILE_OK;
+}
+
+compile_error compile_emit_operand(compiler *c, opcode op, uint32_t operand,
+                                   int32_t effect) {
+  compile_error err = E_COMPILE_OK;
+
+  err = compile_emit(c, op, effect);
+  if (err != E_COMPILE_OK) {
+    return err;
+  }
+
+  return compile_emit_word(c, operand);
+}
+
+// Overwrites the operand at offset, for jumps emitted before their
+// target was known.
+void compile_patch(compiler *c, uint32_t offset, uint32_t operand) {
+  memcpy(c->out->code.elements + offset, &operand, BC_OPERAND_SIZE);
+}
+
+compile_error compile_expression(compiler *c, uint32_t node) {
+  flat_ast *f = c->flat;
+  flat_node n = f->nodes.elements[node];
+  uint32_t jump_if_false = 0, jump = 0;
+  uint64_t i = 0;
+  compile_error err = E_COMPILE_OK;
+
+  switch (n.type) {
+  case FLAT_NUMBER:
+    if (vector_double_push(&c->out->constants, flat_number(n)) !=
+        E_VECTOR_OK) {
+      return E_COMPILE_MALLOC;
+    }
+    return compile_emit_operand(c, BC_CONSTANT, c->out->constants.index - 1,
+                                1);
+  case FLAT_NULL:
+    return compile_emit(c, BC_NULL, 1);
+  case FLAT_BOOL:
+    return compile_emit(c, n.a ? BC_TRUE : BC_FALSE, 1);
+  case FLAT_LOCAL:
+    if (n.a == 0) {
+      return compile_emit_operand(c, c->heap_slots ? BC_GET_ENV : BC_GET_LOCAL,
+                                  n.b, 1);
+    }
+
+    err = compile_emit_operand(c, BC_GET_OUTER, n.a - 1, 1);
+    if (err != E_COMPILE_OK) {
+      return err;
+    }
+    return compile_emit_word(c, n.b);
+  case FLAT_GLOBAL:
+    // Top-level functions never change, so refer to them directly.
+    return compile_emit_operand(c, BC_FUNCTION, f->globals.elements[n.a], 1);
+  case FLAT_OP:
+    err = compile_expression(c, n.a);
+    if (err != E_COMPILE_OK) {
+      return err;
+    }
+
+    err = compile_expression(c, n.b);
+    if (err != E_COMPILE_OK) {
+      return err;
+    }
+
+    switch (n.op) {
+    case OP_PLUS:
+      return compile_emit(c, BC_ADD, -1);
+    case OP_MINUS:
+      return compile_emit(c, BC_SUB, -1);
+    case OP_TIMES:
+      return compile_emit(c, BC_MUL, -1);
+    case OP_DIV:
+      return compile_emit(c, BC_DIV, -1);
+    case OP_LESS:
+      return compile_emit(c, BC_LESS, -1);
+    case OP_GREATER:
+      return compile_emit(c, BC_GREATER, -1);
+    }
+    return E_COMPILE_UNSUPPORTED;
+  case FLAT_CONDITIONAL:
+    err = compile_expression(c, n.a);
+    if (err == E_COMPILE_OK) {
+      err = compile_emit_operand(c, BC_JUMP_IF_FALSE, 0, -1);
+      jump_if_false = c->out->code.index - BC_OPERAND_SIZE;
+    }
+    if (err == E_COMPILE_OK) {
+      err = compile_expression(c, f->extras.elements[n.b]);
+    }
+    if (err == E_COMPILE_OK) {
+      err = compile_emit_operand(c, BC_JUMP, 0, 0);
+      jump = c->out->code.index - BC_OPERAND_SIZE;
+    }
+    if (err != E_COMPILE_OK) {
+      return err;
+    }
+
+    // Only one branch runs, so the alternate starts from the same depth
+    // as the consequent.
+    c->depth--;
+    compile_patch(c, jump_if_false, c->out->code.index);
+    err = compile_expression(c, f->extras.elements[n.b + 1]);
+    compile_patch(c, jump, c->out->code.index);
+    return err;
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+    err = compile_expression(c, n.a);
+    if (err != E_COMPILE_OK) {
+      return err;
+    }
+
+    for (i = 0; i < n.count; i++) {
+      err = compile_expression(c, f->extras.elements[n.b + i]);
+      if (err != E_COMPILE_OK) {
+        return err;
+      }
+    }
+
+    // A tail call never comes back here, but the return after it is
+    // still counted as if it did.
+    return compile_emit_operand(c, n.type == FLAT_CALL ? BC_CALL : BC_TAIL_CALL,
+                                n.count, -(int32_t)n.count);
+  default:
+    return E_COMPILE_UNSUPPORTED;
+  }
+}
+
+compile_error compile_function(compiler *c, uint32_t function) {
+  flat_ast *f = c->flat;
+  flat_function *fn = &f->functions.elements[function];
+  bc_function out = {0};
+  flat_node s = {0};
+  uint64_t i = 0;
+  compile_error err = E_COMPILE_OK;
+
+  c->heap_slots = fn->heap_slots;
+  c->depth = 0;
+  c->max_stack = 0;
+  out.nparameters = fn->nparameters;
+  out.nlocals = fn->nslots;
+  out.code = c->out->code.index;
+
+  // Move the arguments into an env and bind the hoisted functions.
+  if (fn->heap_slots) {
+    out.nlocals = fn->nparameters;
+    err = compile_emit_operand(c, BC_ENV, fn->nslots, 0);
+    if (err != E_COMPILE_OK) {
+      return err;
+    }
+
+    for (i = 0; i < fn->nstatements && err == E_COMPILE_OK; i++) {
+      s = f->nodes.elements[f->extras.elements[fn->body + i]];
+      if (s.type == FLAT_FUNCTION) {
+        err = compile_emit_operand(c, BC_CLOSURE, s.a, 1);
+        if (err == E_COMPILE_OK) {
+          err = compile_emit_operand(c, BC_SET_ENV, s.b, -1);
+        }
+      }
+    }
+  }
+
+  for (i = 0; i < fn->nstatements && err == E_COMPILE_OK; i++) {
+    s = f->nodes.elements[f->extras.elements[fn->body + i]];
+
+    switch (s.type) {
+    case FLAT_RETURN:
+      err = compile_expression(c, s.a);
+      if (err == E_COMPILE_OK) {
+        err = compile_emit(c, BC_RETURN, -1);
+      }
+      break;
+    case FLAT_EXPRESSION:
+      err = compile_expression(c, s.a);
+      if (err == E_COMPILE_OK) {
+        err = compile_emit(c, BC_POP, -1);
+      }
+      break;
+    case FLAT_FUNCTION:
+      break;
+    default:
+      err = E_COMPILE_UNSUPPORTED;
+    }
+  }
+
+  // Falling off the end returns null.
+  if (err == E_COMPILE_OK) {
+    err = compile_emit(c, BC_NULL, 1);
+  }
+  if (err == E_COMPILE_OK) {
+    err = compile_emit(c, BC_RETURN, -1);
+  }
+  if (err != E_COMPILE_OK) {
+    return err;
+  }
+
+  out.max_stack = c->max_stack;
+  c->out->functions.elements[function] = out;
+  return E_COMPILE_OK;
+}
+
+compile_error compile(flat_ast *f, bytecode *out) {
+  compiler c = {0};
+  bc_function empty = {0};
+  uint64_t i = 0;
+  compile_error err = E_COMPILE_OK;
+
+  c.flat = f;
+  c.out = out;
+  out->main = resolve_main(f);
+
+  for (i = 0; i < f->functions.index; i++) {
+    if (vector_bc_function_push(&out->functions, empty) != E_VECTOR_OK) {
+      return E_COMPILE_MALLOC;
+    }
+  }
+
+  for (i = 0; i < f->functions.index; i++) {
+    err = compile_function(&c, i);
+    if (err != E_COMPILE_OK) {
+      return err;
+    }
+  }
+
+  return E_COMPILE_OK;
+}
+
+void bytecode_free(bytecode *bc) {
+  vector_uint8_t_free(&bc->code);
+  vector_double_free(&bc->constants);
+  vector_bc_function_free(&bc->functions);
+}
@@ -0,0 +1,704 @@
+#include "slowjs/emit.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "slowjs/common.h"
+#include "slowjs/flat.h"
+#include "slowjs/inliner.h"
+#include "slowjs/resolve.h"
+
+// Function i of the program becomes f<i>, which takes the env it was
+// declared in if it is nested and then its parameters as p<n>, and
+// e<i>, which takes a closure and an argument array so it can be called
+// through a value. Top-level functions have no env, so each has one
+// static closure c<i>.
+
+struct emitter {
+  flat_ast *flat;
+  // The body of the function being emitted, which is buffered so the
+  // temporaries it turns out to need can be declared first.
+  FILE *out;
+  flat_function *fn;
+  uint32_t ntemps;
+  // Per node, 0 until known, then 1 if the subtree makes no calls and 2
+  // if it does.
+  uint8_t *calls;
+  // Per function, emit_use flags.
+  uint8_t *uses;
+};
+typedef struct emitter emitter;
+
+// How a function is used by the code reachable from main. Only those
+// that are used at all are emitted and only those used as values need
+// their entry and, at the top level, their closure.
+enum emit_use { EMIT_CALLED = 1, EMIT_VALUE = 2 };
+typedef enum emit_use emit_use;
+
+// Copied from value.h, with the collector's headers left out.
+static const char emit_runtime[] =
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "typedef uint64_t value;\n"
+    "\n"
+    "#define VALUE_SIGN ((uint64_t)0x8000000000000000)\n"
+    "#define VALUE_QNAN ((uint64_t)0x7ffc000000000000)\n"
+    "#define VALUE_NAN ((uint64_t)0x7ff8000000000000)\n"
+    "\n"
+    "#define NULL_VALUE ((value)(VALUE_QNAN | 1))\n"
+    "#define FALSE_VALUE ((value)(VALUE_QNAN | 2))\n"
+    "#define TRUE_VALUE ((value)(VALUE_QNAN | 3))\n"
+    "\n"
+    "#define IS_NUMBER(v) (((v)&VALUE_QNAN) != VALUE_QNAN)\n"
+    "#define IS_FUNCTION(v) \\\n"
+    "  (((v) & (VALUE_SIGN | VALUE_QNAN)) == (VALUE_SIGN | VALUE_QNAN))\n"
+    "\n"
+    "#define BOOL_VALUE(b) ((b) ? TRUE_VALUE : FALSE_VALUE)\n"
+    "#define FUNCTION_VALUE(c) "
+    "((value)(VALUE_SIGN | VALUE_QNAN | (uintptr_t)(c)))\n"
+    "#define AS_CLOSURE(v) \\\n"
+    "  ((closure *)(uintptr_t)((v) & ~(VALUE_SIGN | VALUE_QNAN)))\n"
+    "\n"
+    "typedef struct env {\n"
+    "  struct env *parent;\n"
+    "  value values[];\n"
+    "} env;\n"
+    "\n"
+    "typedef struct closure {\n"
+    "  value (*entry)(struct closure *, uint32_t, value *);\n"
+    "  env *env;\n"
+    "} closure;\n"
+    "\n"
+    "static inline value number_value(double d) {\n"
+    "  value v = 0;\n"
+    "\n"
+    "  memcpy(&v, &d, sizeof(v));\n"
+    "  return v;\n"
+    "}\n"
+    "\n"
+    "static inline double value_number(value v) {\n"
+    "  double d = 0;\n"
+    "\n"
+    "  memcpy(&d, &v, sizeof(d));\n"
+    "  return d;\n"
+    "}\n"
+    "\n"
+    "static inline double value_to_number(value v) {\n"
+    "  if (IS_NUMBER(v)) {\n"
+    "    return value_number(v);\n"
+    "  }\n"
+    "\n"
+    "  if (IS_FUNCTION(v)) {\n"
+    "    return value_number(VALUE_NAN);\n"
+    "  }\n"
+    "\n"
+    "  return v == TRUE_VALUE;\n"
+    "}\n"
+    "\n"
+    "static inline int value_truthy(value v) {\n"
+    "  double d = 0;\n"
+    "\n"
+    "  if (IS_NUMBER(v)) {\n"
+    "    d = value_number(v);\n"
+    "    return d == d && d != 0;\n"
+    "  }\n"
+    "\n"
+    "  return v != NULL_VALUE && v != FALSE_VALUE;\n"
+    "}\n"
+    "\n"
+    "static inline value op_plus(value l, value r) {\n"
+    "  return number_value(value_to_number(l) + value_to_number(r));\n"
+    "}\n"
+    "\n"
+    "static inline value op_minus(value l, value r) {\n"
+    "  return number_value(value_to_number(l) - value_to_number(r));\n"
+    "}\n"
+    "\n"
+    "static inline value op_times(value l, value r) {\n"
+    "  return number_value(value_to_number(l) * value_to_number(r));\n"
+    "}\n"
+    "\n"
+    "static inline value op_div(value l, value r) {\n"
+    "  return number_value(value_to_number(l) / value_to_number(r));\n"
+    "}\n"
+    "\n"
+    "static inline value op_less(value l, value r) {\n"
+    "  return BOOL_VALUE(value_to_number(l) < value_to_number(r));\n"
+    "}\n"
+    "\n"
+    "static inline value op_greater(value l, value r) {\n"
+    "  return BOOL_VALUE(value_to_number(l) > value_to_number(r));\n"
+    "}\n"
+    "\n"
+    "static inline void *allocate(size_t size) {\n"
+    "  void *p = calloc(1, size);\n"
+    "\n"
+    "  if (p == 0) {\n"
+    "    fprintf(stderr, \"Out of memory\\n\");\n"
+    "    exit(1);\n"
+    "  }\n"
+    "\n"
+    "  return p;\n"
+    "}\n"
+    "\n"
+    "static inline env *env_new(env *parent, uint32_t size) {\n"
+    "  env *e = (env *)allocate(sizeof(env) + size * sizeof(value));\n"
+    "\n"
+    "  e->parent = parent;\n"
+    "  return e;\n"
+    "}\n"
+    "\n"
+    "static inline value closure_new(value (*entry)(closure *, uint32_t,\n"
+    "                                               value *),\n"
+    "                                env *e) {\n"
+    "  closure *c = (closure *)allocate(sizeof(closure));\n"
+    "\n"
+    "  c->entry = entry;\n"
+    "  c->env = e;\n"
+    "  return FUNCTION_VALUE(c);\n"
+    "}\n"
+    "\n"
+    "static inline value arg(uint32_t argc, value *argv, uint32_t i) {\n"
+    "  return i < argc ? argv[i] : NULL_VALUE;\n"
+    "}\n"
+    "\n"
+    "static inline value call(value callee, uint32_t argc, value *argv) {\n"
+    "  if (!IS_FUNCTION(callee)) {\n"
+    "    fprintf(stderr, \"TypeError: Called a value that is not a "
+    "function\\n\");\n"
+    "    exit(1);\n"
+    "  }\n"
+    "\n"
+    "  return AS_CLOSURE(callee)->entry(AS_CLOSURE(callee), argc, argv);\n"
+    "}\n"
+    "\n"
+    "static inline void print(value v) {\n"
+    "  if (IS_NUMBER(v)) {\n"
+    "    printf(\"%lf\\n\", value_number(v));\n"
+    "  } else if (IS_FUNCTION(v)) {\n"
+    "    printf(\"[Function]\\n\");\n"
+    "  } else if (v == NULL_VALUE) {\n"
+    "    printf(\"null\\n\");\n"
+    "  } else {\n"
+    "    printf(\"%s\\n\", v == TRUE_VALUE ? \"true\" : \"false\");\n"
+    "  }\n"
+    "}\n";
+
+void emit_use_node(emitter *, uint32_t, uint32_t);
+void emit_use_function(emitter *, uint32_t, uint32_t);
+bool emit_calls(emitter *, uint32_t);
+void emit_number(FILE *, double);
+void emit_local(emitter *, flat_node);
+uint32_t emit_operand(emitter *, flat_node, bool, uint32_t);
+bool emit_needs_temp(emitter *, flat_node, bool, uint32_t, uint32_t,
+                     uint32_t);
+void emit_call(emitter *, flat_node);
+void emit_expression(emitter *, uint32_t);
+void emit_signature(flat_ast *, FILE *, uint32_t);
+void emit_entry(flat_ast *, FILE *, uint32_t);
+emit_error emit_function(emitter *, FILE *, uint32_t);
+
+void emit_use_node(emitter *e, uint32_t node, uint32_t use) {
+  flat_ast *f = e->flat;
+  flat_node n = f->nodes.elements[node];
+  uint32_t i = 0;
+
+  switch (n.type) {
+  case FLAT_GLOBAL:
+    emit_use_function(e, f->globals.elements[n.a], use);
+    break;
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    emit_use_node(e, n.a, EMIT_VALUE);
+    emit_use_node(e, n.b, EMIT_VALUE);
+    break;
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+    emit_use_node(e, n.a, EMIT_CALLED);
+    for (i = 0; i < n.count; i++) {
+      emit_use_node(e, f->extras.elements[n.b + i], EMIT_VALUE);
+    }
+    break;
+  case FLAT_CONDITIONAL:
+    emit_use_node(e, n.a, EMIT_VALUE);
+    emit_use_node(e, f->extras.elements[n.b], EMIT_VALUE);
+    emit_use_node(e, f->extras.elements[n.b + 1], EMIT_VALUE);
+    break;
+  case FLAT_RETURN:
+  case FLAT_EXPRESSION:
+    emit_use_node(e, n.a, EMIT_VALUE);
+    break;
+  case FLAT_FUNCTION:
+    emit_use_function(e, n.a, EMIT_VALUE);
+    break;
+  default:
+    break;
+  }
+}
+
+void emit_use_function(emitter *e, uint32_t function, uint32_t use) {
+  flat_function *fn = &e->flat->functions.elements[function];
+  bool seen = e->uses[function] != 0;
+  uint32_t i = 0;
+
+  e->uses[function] |= use;
+  if (seen) {
+    return;
+  }
+
+  for (i = 0; i < fn->nstatements; i++) {
+    emit_use_node(e, e->flat->extras.elements[fn->body + i], EMIT_VALUE);
+  }
+}
+
+bool emit_calls(emitter *e, uint32_t node) {
+  flat_node n = e->flat->nodes.elements[node];
+  bool calls = false;
+  uint32_t i = 0;
+
+  if (e->calls[node]) {
+    return e->calls[node] == 2;
+  }
+
+  switch (n.type) {
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+    calls = true;
+    break;
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    calls = emit_calls(e, n.a) | emit_calls(e, n.b);
+    break;
+  case FLAT_CONDITIONAL:
+    calls = emit_calls(e, n.a);
+    for (i = 0; i < 2; i++) {
+      calls |= emit_calls(e, e->flat->extras.elements[n.b + i]);
+    }
+    break;
+  default:
+    break;
+  }
+
+  e->calls[node] = calls ? 2 : 1;
+  return calls;
+}
+
+// Numbers are written with as few digits as still read back as the
+// same double, and always as a double, whole ones without an exponent.
+// Infinities and NaNs have no literal, so those are written as their
+// bits.
+void emit_number(FILE *out, double d) {
+  char digits[32] = {0};
+  value bits = number_value(d);
+  int precision = 0;
+
+  if (!isfinite(d)) {
+    fprintf(out, "((value)0x%016llxULL)", (unsigned long long)bits);
+    return;
+  }
+
+  if ((d < 0 ? -d : d) < 1e15 && d == (double)(int64_t)d) {
+    fprintf(out, "number_value(%.1f)", d);
+    return;
+  }
+
+  for (precision = 1; precision < 17; precision++) {
+    snprintf(digits, sizeof(digits), "%.*g", precision, d);
+    if (strtod(digits, 0) == d) {
+      break;
+    }
+  }
+  snprintf(digits, sizeof(digits), "%.*g", precision, d);
+
+  fprintf(out, "number_value(%s%s)", digits,
+          strpbrk(digits, ".e") ? "" : ".0");
+}
+
+// Nothing can be assigned, so parameters are read from the C arguments
+// even when they were also copied into the env for nested functions.
+void emit_local(emitter *e, flat_node n) {
+  uint32_t depth = 0;
+
+  if (n.a == 0) {
+    if (n.b < e->fn->nparameters) {
+      fprintf(e->out, "p%u", n.b);
+    } else {
+      fprintf(e->out, "e->values[%u]", n.b);
+    }
+    return;
+  }
+
+  fprintf(e->out, "outer");
+  for (depth = 1; depth < n.a; depth++) {
+    fprintf(e->out, "->parent");
+  }
+  fprintf(e->out, "->values[%u]", n.b);
+}
+
+// Operand i of call, counting the callee first if callee is set.
+uint32_t emit_operand(emitter *e, flat_node call, bool callee, uint32_t i) {
+  if (callee) {
+    if (i == 0) {
+      return call.a;
+    }
+    i--;
+  }
+
+  return e->flat->extras.elements[call.b + i];
+}
+
+// C leaves the order arguments are evaluated in open but calls have to
+// happen left to right, and the ones that are not passed on still have
+// to happen. Every operand that makes calls is stored in a temporary
+// first, except the last one if it is passed since nothing comes after
+// it. Operands that make no calls cannot tell when they run.
+bool emit_needs_temp(emitter *e, flat_node call, bool callee, uint32_t i,
+                     uint32_t passed, uint32_t last) {
+  if (!emit_calls(e, emit_operand(e, call, callee, i))) {
+    return false;
+  }
+
+  return i != last || last >= passed;
+}
+
+// The temporaries of the operands are numbered from the first one the
+// call takes, in order.
+void emit_call(emitter *e, flat_node n) {
+  flat_ast *f = e->flat;
+  flat_node callee = f->nodes.elements[n.a];
+  flat_function *target = 0;
+  uint32_t function = 0, noperands = 0, passed = 0, last = UINT32_MAX;
+  uint32_t base = e->ntemps, ntemps = 0, temp = 0, i = 0;
+  bool indirect = true, sequenced = false;
+
+  // Top-level functions are called directly and take exactly their
+  // parameters.
+  if (callee.type == FLAT_GLOBAL) {
+    function = f->globals.elements[callee.a];
+    target = &f->functions.elements[function];
+    indirect = false;
+  }
+
+  noperands = n.count + indirect;
+  passed = noperands;
+  if (!indirect && target->nparameters < n.count) {
+    passed = target->nparameters;
+  }
+  for (i = 0; i < noperands; i++) {
+    if (emit_calls(e, emit_operand(e, n, indirect, i))) {
+      last = i;
+    }
+  }
+
+  for (i = 0; i < passed; i++) {
+    ntemps += emit_needs_temp(e, n, indirect, i, passed, last);
+  }
+  e->ntemps += ntemps;
+
+  // Arguments that are not passed are only run for their calls.
+  for (i = 0, temp = base; i < noperands; i++) {
+    if (!emit_needs_temp(e, n, indirect, i, passed, last)) {
+      continue;
+    }
+
+    fprintf(e->out, "%s", sequenced ? "" : "(");
+    sequenced = true;
+    if (i < passed) {
+      fprintf(e->out, "t%u = ", temp++);
+    } else {
+      fprintf(e->out, "(void)");
+    }
+    emit_expression(e, emit_operand(e, n, indirect, i));
+    fprintf(e->out, ", ");
+  }
+
+  if (indirect) {
+    fprintf(e->out, "call(");
+  } else {
+    fprintf(e->out, "f%u(", function);
+  }
+
+  for (i = 0, temp = base; i < (indirect ? noperands : target->nparameters);
+       i++) {
+    if (i > 0) {
+      fprintf(e->out, ", ");
+    }
+    if (indirect && i == 1) {
+      fprintf(e->out, "%u, (value[]){", n.count);
+    }
+
+    if (i >= passed) {
+      fprintf(e->out, "NULL_VALUE");
+    } else if (emit_needs_temp(e, n, indirect, i, passed, last)) {
+      fprintf(e->out, "t%u", temp++);
+    } else {
+      emit_expression(e, emit_operand(e, n, indirect, i));
+    }
+  }
+
+  if (indirect) {
+    fprintf(e->out, n.count ? "})" : ", 0, 0)");
+  } else {
+    fprintf(e->out, ")");
+  }
+  if (sequenced) {
+    fprintf(e->out, ")");
+  }
+}
+
+void emit_expression(emitter *e, uint32_t node) {
+  static const char *ops[] = {"op_plus", "op_minus", "op_times",
+                              "op_div",  "op_less",  "op_greater"};
+  flat_ast *f = e->flat;
+  flat_node n = f->nodes.elements[node];
+  uint32_t temp = 0;
+
+  switch (n.type) {
+  case FLAT_NUMBER:
+    emit_number(e->out, flat_number(n));
+    break;
+  case FLAT_BOOL:
+    fprintf(e->out, n.a ? "TRUE_VALUE" : "FALSE_VALUE");
+    break;
+  case FLAT_LOCAL:
+    emit_local(e, n);
+    break;
+  case FLAT_GLOBAL:
+    fprintf(e->out, "FUNCTION_VALUE(&c%u)", f->globals.elements[n.a]);
+    break;
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    // The right side only has to wait when both make calls.
+    if (emit_calls(e, n.a) && emit_calls(e, n.b)) {
+      temp = e->ntemps++;
+      fprintf(e->out, "(t%u = ", temp);
+      emit_expression(e, n.a);
+      fprintf(e->out, ", %s(t%u, ", ops[n.op], temp);
+    } else {
+      fprintf(e->out, "%s(", ops[n.op]);
+      emit_expression(e, n.a);
+      fprintf(e->out, ", ");
+    }
+    emit_expression(e, n.b);
+    fprintf(e->out, emit_calls(e, n.a) && emit_calls(e, n.b) ? "))" : ")");
+    break;
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+    emit_call(e, n);
+    break;
+  case FLAT_CONDITIONAL:
+    fprintf(e->out, "(value_truthy(");
+    emit_expression(e, n.a);
+    fprintf(e->out, ") ? ");
+    emit_expression(e, f->extras.elements[n.b]);
+    fprintf(e->out, " : ");
+    emit_expression(e, f->extras.elements[n.b + 1]);
+    fprintf(e->out, ")");
+    break;
+  default:
+    fprintf(e->out, "NULL_VALUE");
+    break;
+  }
+}
+
+void emit_signature(flat_ast *f, FILE *out, uint32_t function) {
+  flat_function *fn = &f->functions.elements[function];
+  uint32_t i = 0;
+
+  fprintf(out, "static value f%u(", function);
+  if (fn->parent != UINT32_MAX) {
+    fprintf(out, "env *outer");
+  } else if (fn->nparameters == 0) {
+    fprintf(out, "void");
+  }
+
+  for (i = 0; i < fn->nparameters; i++) {
+    fprintf(out, "%svalue p%u",
+            i > 0 || fn->parent != UINT32_MAX ? ", " : "", i);
+  }
+  fprintf(out, ")");
+}
+
+void emit_entry(flat_ast *f, FILE *out, uint32_t function) {
+  flat_function *fn = &f->functions.elements[function];
+  uint32_t i = 0;
+
+  fprintf(out,
+          "static value e%u(closure *self, uint32_t argc, value *argv) {\n"
+          "  return f%u(",
+          function, function);
+  if (fn->parent != UINT32_MAX) {
+    fprintf(out, "self->env");
+  }
+
+  for (i = 0; i < fn->nparameters; i++) {
+    fprintf(out, "%sarg(argc, argv, %u)",
+            i > 0 || fn->parent != UINT32_MAX ? ", " : "", i);
+  }
+  fprintf(out, ");\n}\n\n");
+}
+
+emit_error emit_function(emitter *e, FILE *out, uint32_t function) {
+  flat_ast *f = e->flat;
+  flat_function *fn = &f->functions.elements[function];
+  flat_node s = {0};
+  char *body = 0;
+  size_t size = 0;
+  uint32_t i = 0;
+  bool returned = false;
+
+  e->fn = fn;
+  e->ntemps = 0;
+  e->out = open_memstream(&body, &size);
+  if (e->out == 0) {
+    return E_EMIT_MALLOC;
+  }
+
+  // The env outlives the call, nested functions reach the parameters
+  // and each other through it.
+  if (fn->heap_slots) {
+    fprintf(e->out, "  env *e = env_new(%s, %u);\n",
+            fn->parent != UINT32_MAX ? "outer" : "0", fn->nslots);
+    for (i = 0; i < fn->nparameters; i++) {
+      fprintf(e->out, "  e->values[%u] = p%u;\n", i, i);
+    }
+  }
+
+  for (i = 0; i < fn->nstatements; i++) {
+    s = f->nodes.elements[f->extras.elements[fn->body + i]];
+    if (s.type == FLAT_FUNCTION) {
+      fprintf(e->out, "  e->values[%u] = closure_new(e%u, e);\n", s.b, s.a);
+    }
+  }
+
+  for (i = 0; i < fn->nstatements && !returned; i++) {
+    s = f->nodes.elements[f->extras.elements[fn->body + i]];
+    switch (s.type) {
+    case FLAT_RETURN:
+      fprintf(e->out, "  return ");
+      emit_expression(e, s.a);
+      fprintf(e->out, ";\n");
+      returned = true;
+      break;
+    case FLAT_EXPRESSION:
+      fprintf(e->out, "  (void)");
+      emit_expression(e, s.a);
+      fprintf(e->out, ";\n");
+      break;
+    default:
+      break;
+    }
+  }
+  if (!returned) {
+    fprintf(e->out, "  return NULL_VALUE;\n");
+  }
+  fclose(e->out);
+  e->out = 0;
+
+  fprintf(out, "// %s\n", interned_name(&f->names, fn->name));
+  emit_signature(f, out, function);
+  fprintf(out, " {\n");
+  for (i = 0; i < e->ntemps; i++) {
+    fprintf(out, "%s t%u", i == 0 ? "  value" : ",", i);
+  }
+  if (e->ntemps > 0) {
+    fprintf(out, ";\n");
+  }
+  fwrite(body, 1, size, out);
+  fprintf(out, "}\n\n");
+
+  free(body);
+  return E_EMIT_OK;
+}
+
+emit_error emit_c(ast program, run_options options, FILE *out) {
+  flat_ast f = {0};
+  emitter e = {0};
+  flat_function *fn = 0;
+  uint32_t main = 0, i = 0;
+  emit_error err = E_EMIT_OK;
+
+  if (flatten(&program, &f) != E_FLAT_OK) {
+    LOG_ERROR("emit", "Failed to flatten program", 0);
+    err = E_EMIT_FLATTEN;
+    goto cleanup;
+  }
+
+  if (resolve(&f) != E_RESOLVE_OK) {
+    err = E_EMIT_RESOLVE;
+    goto cleanup;
+  }
+
+  if (inline_calls(&f, options.inlining,
+                   options.inlining.report ? stderr : 0) != E_INLINE_OK) {
+    err = E_EMIT_MALLOC;
+    goto cleanup;
+  }
+
+  main = resolve_main(&f);
+  if (main == UINT32_MAX) {
+    LOG_ERROR("emit", "Expected main function", 0);
+    err = E_EMIT_NO_MAIN;
+    goto cleanup;
+  }
+
+  e.flat = &f;
+  e.calls = (uint8_t *)calloc(f.nodes.index, sizeof(uint8_t));
+  e.uses = (uint8_t *)calloc(f.functions.index, sizeof(uint8_t));
+  if (e.calls == 0 || e.uses == 0) {
+    err = E_EMIT_MALLOC;
+    goto cleanup;
+  }
+  emit_use_function(&e, main, EMIT_CALLED);
+
+  fprintf(out, "// Generated by slowjs --emit-c.\n\n%s\n", emit_runtime);
+
+  for (i = 0; i < f.functions.index; i++) {
+    if (e.uses[i]) {
+      emit_signature(&f, out, i);
+      fprintf(out, ";\n");
+    }
+  }
+  fprintf(out, "\n");
+  for (i = 0; i < f.functions.index; i++) {
+    if (e.uses[i] & EMIT_VALUE) {
+      emit_entry(&f, out, i);
+    }
+  }
+  for (i = 0; i < f.functions.index; i++) {
+    if ((e.uses[i] & EMIT_VALUE) &&
+        f.functions.elements[i].parent == UINT32_MAX) {
+      fprintf(out, "static closure c%u = {e%u, 0};\n", i, i);
+    }
+  }
+  fprintf(out, "\n");
+
+  for (i = 0; i < f.functions.index && err == E_EMIT_OK; i++) {
+    if (e.uses[i]) {
+      err = emit_function(&e, out, i);
+    }
+  }
+  if (err != E_EMIT_OK) {
+    goto cleanup;
+  }
+
+  fn = &f.functions.elements[main];
+  fprintf(out, "int main(void) {\n  print(f%u(", main);
+  for (i = 0; i < fn->nparameters; i++) {
+    fprintf(out, "%sNULL_VALUE", i > 0 ? ", " : "");
+  }
+  fprintf(out, "));\n  return 0;\n}\n");
+
+  if (ferror(out)) {
+    err = E_EMIT_WRITE;
+  }
+
+cleanup:
+  free(e.uses);
+  free(e.calls);
+  flat_ast_free(&f);
+  return err;
+}
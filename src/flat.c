@@ -0,0 +1,287 @@
+#include "slowjs/flat.h"
+
+#include "slowjs/common.h"
+
+flat_error flat_push_node(flat_ast *, flat_node, uint32_t *);
+flat_error flat_reserve_extras(flat_ast *, uint64_t, uint32_t *);
+flat_error flatten_name(flat_ast *, vector_char *, uint32_t *);
+flat_error flatten_expression(flat_ast *, expression *, uint32_t *);
+flat_error flatten_statement(flat_ast *, statement *, uint32_t *);
+flat_error flatten_function(flat_ast *, function_declaration *, uint32_t *);
+
+flat_error flat_push_node(flat_ast *f, flat_node n, uint32_t *index) {
+  if (f->nodes.index >= UINT32_MAX) {
+    return E_FLAT_TOO_BIG;
+  }
+
+  if (vector_flat_node_push(&f->nodes, n) != E_VECTOR_OK) {
+    return E_FLAT_MALLOC;
+  }
+
+  *index = f->nodes.index - 1;
+  return E_FLAT_OK;
+}
+
+// Lists are reserved up front so that flattening their elements, which
+// appends to extras too, leaves the list contiguous.
+flat_error flat_reserve_extras(flat_ast *f, uint64_t n, uint32_t *start) {
+  uint64_t i = 0;
+
+  if (f->extras.index + n >= UINT32_MAX) {
+    return E_FLAT_TOO_BIG;
+  }
+
+  *start = f->extras.index;
+  for (i = 0; i < n; i++) {
+    if (vector_uint32_t_push(&f->extras, 0) != E_VECTOR_OK) {
+      return E_FLAT_MALLOC;
+    }
+  }
+
+  return E_FLAT_OK;
+}
+
+flat_error flatten_name(flat_ast *f, vector_char *name, uint32_t *id) {
+  // Identifiers are stored null-terminated.
+  if (intern(&f->names, name->elements, name->index - 1, id) != E_INTERN_OK) {
+    return E_FLAT_MALLOC;
+  }
+
+  return E_FLAT_OK;
+}
+
+flat_error flatten_expression(flat_ast *f, expression *e, uint32_t *index) {
+  flat_node n = {0};
+  function_call *fc = 0;
+  conditional *c = 0;
+  uint32_t child = 0;
+  uint64_t i = 0;
+  flat_error err = E_FLAT_OK;
+
+  switch (e->type) {
+  case EXPRESSION_NUMBER:
+    n.type = FLAT_NUMBER;
+    memcpy(&n.a, &e->expression.number, sizeof(double));
+    return flat_push_node(f, n, index);
+  case EXPRESSION_NULL:
+    n.type = FLAT_NULL;
+    return flat_push_node(f, n, index);
+  case EXPRESSION_BOOL:
+    n.type = FLAT_BOOL;
+    n.a = e->expression.number != 0;
+    return flat_push_node(f, n, index);
+  case EXPRESSION_IDENTIFIER:
+    n.type = FLAT_IDENTIFIER;
+    err = flatten_name(f, &e->expression.identifier, &n.a);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    return flat_push_node(f, n, index);
+  case EXPRESSION_OP:
+    // Parents are laid out before their children.
+    n.type = FLAT_OP;
+    n.op = e->expression.op.type;
+    err = flat_push_node(f, n, index);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+
+    err = flatten_expression(f, e->expression.op.left_operand, &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->nodes.elements[*index].a = child;
+
+    err = flatten_expression(f, e->expression.op.right_operand, &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->nodes.elements[*index].b = child;
+    return E_FLAT_OK;
+  case EXPRESSION_CALL:
+    fc = &e->expression.function_call;
+    if (fc->arguments->index > UINT16_MAX) {
+      return E_FLAT_TOO_BIG;
+    }
+
+    n.type = FLAT_CALL;
+    n.count = fc->arguments->index;
+    err = flat_push_node(f, n, index);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+
+    err = flatten_expression(f, fc->function, &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->nodes.elements[*index].a = child;
+
+    err = flat_reserve_extras(f, n.count, &n.b);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->nodes.elements[*index].b = n.b;
+
+    for (i = 0; i < n.count; i++) {
+      err = flatten_expression(f, &fc->arguments->elements[i], &child);
+      if (err != E_FLAT_OK) {
+        return err;
+      }
+      f->extras.elements[n.b + i] = child;
+    }
+    return E_FLAT_OK;
+  case EXPRESSION_CONDITIONAL:
+    c = &e->expression.conditional;
+    n.type = FLAT_CONDITIONAL;
+    err = flat_push_node(f, n, index);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+
+    err = flatten_expression(f, c->test, &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->nodes.elements[*index].a = child;
+
+    err = flat_reserve_extras(f, 2, &n.b);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->nodes.elements[*index].b = n.b;
+
+    err = flatten_expression(f, c->consequent, &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->extras.elements[n.b] = child;
+
+    err = flatten_expression(f, c->alternate, &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->extras.elements[n.b + 1] = child;
+    return E_FLAT_OK;
+  }
+
+  return E_FLAT_OK;
+}
+
+flat_error flatten_statement(flat_ast *f, statement *s, uint32_t *index) {
+  flat_node n = {0};
+  uint32_t child = 0;
+  flat_error err = E_FLAT_OK;
+
+  switch (s->type) {
+  case STATEMENT_RETURN:
+    n.type = FLAT_RETURN;
+    err = flatten_expression(f, &s->statement.ret, &child);
+    break;
+  case STATEMENT_EXPRESSION:
+    n.type = FLAT_EXPRESSION;
+    err = flatten_expression(f, &s->statement.expression, &child);
+    break;
+  case STATEMENT_DECLARATION:
+    if (s->statement.declaration->type != DECLARATION_FUNCTION) {
+      LOG_ERROR("flat", "Unsupported declaration", 0);
+      return E_FLAT_UNSUPPORTED;
+    }
+
+    n.type = FLAT_FUNCTION;
+    err = flatten_function(
+        f, &s->statement.declaration->declaration.function, &child);
+    break;
+  }
+
+  if (err != E_FLAT_OK) {
+    return err;
+  }
+
+  n.a = child;
+  return flat_push_node(f, n, index);
+}
+
+flat_error flatten_function(flat_ast *f, function_declaration *fd,
+                            uint32_t *index) {
+  flat_function fn = {0};
+  uint32_t child = 0;
+  uint64_t i = 0;
+  flat_error err = E_FLAT_OK;
+
+  err = flatten_name(f, &fd->name, &fn.name);
+  if (err != E_FLAT_OK) {
+    return err;
+  }
+
+  fn.nparameters = fd->parameters.index;
+  err = flat_reserve_extras(f, fn.nparameters, &fn.parameters);
+  if (err != E_FLAT_OK) {
+    return err;
+  }
+
+  for (i = 0; i < fn.nparameters; i++) {
+    err = flatten_name(f, &fd->parameters.elements[i], &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->extras.elements[fn.parameters + i] = child;
+  }
+
+  fn.nstatements = fd->body.index;
+  err = flat_reserve_extras(f, fn.nstatements, &fn.body);
+  if (err != E_FLAT_OK) {
+    return err;
+  }
+
+  // Reserve this function's slot before any nested ones take theirs.
+  *index = f->functions.index;
+  if (vector_flat_function_push(&f->functions, fn) != E_VECTOR_OK) {
+    return E_FLAT_MALLOC;
+  }
+
+  for (i = 0; i < fn.nstatements; i++) {
+    err = flatten_statement(f, &fd->body.elements[i], &child);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+    f->extras.elements[fn.body + i] = child;
+  }
+
+  return E_FLAT_OK;
+}
+
+flat_error flatten(ast *program, flat_ast *out) {
+  declaration *d = 0;
+  uint32_t function = 0;
+  uint64_t i = 0;
+  flat_error err = E_FLAT_OK;
+
+  for (i = 0; i < program->declarations.index; i++) {
+    d = &program->declarations.elements[i];
+    if (d->type != DECLARATION_FUNCTION) {
+      LOG_ERROR("flat", "Unsupported top-level declaration", d->type);
+      return E_FLAT_UNSUPPORTED;
+    }
+
+    err = flatten_function(out, &d->declaration.function, &function);
+    if (err != E_FLAT_OK) {
+      return err;
+    }
+
+    if (vector_uint32_t_push(&out->declarations, function) != E_VECTOR_OK) {
+      return E_FLAT_MALLOC;
+    }
+  }
+
+  return E_FLAT_OK;
+}
+
+void flat_ast_free(flat_ast *f) {
+  vector_flat_node_free(&f->nodes);
+  vector_uint32_t_free(&f->extras);
+  vector_flat_function_free(&f->functions);
+  vector_uint32_t_free(&f->declarations);
+  vector_uint32_t_free(&f->globals);
+  interner_free(&f->names);
+}
@@ -0,0 +1,174 @@
+#include "slowjs/fold.h"
+
+#include "slowjs/common.h"
+
+bool fold_is_literal(expression *);
+double fold_literal_number(expression *);
+bool fold_is_number(expression *);
+bool fold_is_number_literal(expression *, double);
+uint64_t fold_op(expression *);
+uint64_t fold_expression(expression *);
+uint64_t fold_statements(vector_statement *);
+uint64_t fold_declaration(declaration *);
+
+bool fold_is_literal(expression *e) {
+  return e->type == EXPRESSION_NUMBER || e->type == EXPRESSION_BOOL ||
+         e->type == EXPRESSION_NULL;
+}
+
+// Same conversion the interpreters do: booleans are 0 or 1 and null is
+// 0. Booleans already store that in number.
+double fold_literal_number(expression *e) {
+  return e->type == EXPRESSION_NULL ? 0 : e->expression.number;
+}
+
+// Arithmetic always produces a number, whatever its operands are.
+bool fold_is_number(expression *e) {
+  if (e->type == EXPRESSION_NUMBER) {
+    return true;
+  }
+
+  return e->type == EXPRESSION_OP && e->expression.op.type != OP_LESS &&
+         e->expression.op.type != OP_GREATER;
+}
+
+bool fold_is_number_literal(expression *e, double d) {
+  return e->type == EXPRESSION_NUMBER && e->expression.number == d;
+}
+
+uint64_t fold_op(expression *e) {
+  op *o = &e->expression.op;
+  expression *left = o->left_operand, *right = o->right_operand;
+  double l = 0, r = 0;
+
+  if (fold_is_literal(left) && fold_is_literal(right)) {
+    l = fold_literal_number(left);
+    r = fold_literal_number(right);
+    e->type = EXPRESSION_NUMBER;
+    switch (o->type) {
+    case OP_PLUS:
+      e->expression.number = l + r;
+      break;
+    case OP_MINUS:
+      e->expression.number = l - r;
+      break;
+    case OP_TIMES:
+      e->expression.number = l * r;
+      break;
+    case OP_DIV:
+      e->expression.number = l / r;
+      break;
+    case OP_LESS:
+      e->type = EXPRESSION_BOOL;
+      e->expression.number = l < r;
+      break;
+    case OP_GREATER:
+      e->type = EXPRESSION_BOOL;
+      e->expression.number = l > r;
+      break;
+    }
+    return 1;
+  }
+
+  // x + 0 is left alone since -0 + 0 is 0. Everything else converts x to
+  // a number, so only holds when x is one already.
+  if (o->type == OP_TIMES && fold_is_number_literal(left, 1) &&
+      fold_is_number(right)) {
+    *e = *right;
+    return 1;
+  }
+
+  if (((o->type == OP_TIMES || o->type == OP_DIV) &&
+       fold_is_number_literal(right, 1) && fold_is_number(left)) ||
+      (o->type == OP_MINUS && fold_is_number_literal(right, 0) &&
+       fold_is_number(left))) {
+    *e = *left;
+    return 1;
+  }
+
+  return 0;
+}
+
+uint64_t fold_expression(expression *e) {
+  function_call *fc = 0;
+  conditional *c = 0;
+  uint64_t i = 0, folded = 0;
+
+  switch (e->type) {
+  case EXPRESSION_CALL:
+    fc = &e->expression.function_call;
+    folded = fold_expression(fc->function);
+    for (i = 0; i < fc->arguments->index; i++) {
+      folded += fold_expression(&fc->arguments->elements[i]);
+    }
+    return folded;
+  case EXPRESSION_OP:
+    folded = fold_expression(e->expression.op.left_operand);
+    folded += fold_expression(e->expression.op.right_operand);
+    return folded + fold_op(e);
+  case EXPRESSION_CONDITIONAL:
+    c = &e->expression.conditional;
+    folded = fold_expression(c->test);
+    if (!fold_is_literal(c->test)) {
+      folded += fold_expression(c->consequent);
+      return folded + fold_expression(c->alternate);
+    }
+
+    // Literals are falsy when they are null, false, 0 or NaN.
+    if (c->test->type != EXPRESSION_NULL && c->test->expression.number != 0 &&
+        c->test->expression.number == c->test->expression.number) {
+      *e = *c->consequent;
+    } else {
+      *e = *c->alternate;
+    }
+    return folded + 1 + fold_expression(e);
+  default:
+    return 0;
+  }
+}
+
+uint64_t fold_statements(vector_statement *body) {
+  statement *s = 0;
+  uint64_t i = 0, folded = 0;
+
+  for (i = 0; i < body->index; i++) {
+    s = &body->elements[i];
+    switch (s->type) {
+    case STATEMENT_EXPRESSION:
+      folded += fold_expression(&s->statement.expression);
+      break;
+    case STATEMENT_RETURN:
+      folded += fold_expression(&s->statement.ret);
+      break;
+    case STATEMENT_DECLARATION:
+      folded += fold_declaration(s->statement.declaration);
+      break;
+    }
+  }
+
+  return folded;
+}
+
+uint64_t fold_declaration(declaration *d) {
+  uint64_t i = 0, folded = 0;
+
+  if (d->type == DECLARATION_FUNCTION) {
+    return fold_statements(&d->declaration.function.body);
+  }
+
+  for (i = 0; i < d->declaration.variable_list.index; i++) {
+    folded += fold_expression(
+        &d->declaration.variable_list.elements[i].initializer);
+  }
+  return folded;
+}
+
+uint64_t fold(ast *a) {
+  uint64_t i = 0, folded = 0;
+
+  for (i = 0; i < a->declarations.index; i++) {
+    folded += fold_declaration(&a->declarations.elements[i]);
+  }
+
+  return folded;
+}
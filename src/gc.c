@@ -0,0 +1,317 @@
+#include "slowjs/gc.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "slowjs/common.h"
+
+// Check the clock every this many objects traced or swept.
+#define GC_CLOCK_INTERVAL 32
+
+uint64_t gc_now_ns();
+uint64_t gc_object_size(object *);
+void *gc_alloc(gc *, uint64_t, object_type);
+uint64_t gc_trace(gc *, object *);
+uint64_t gc_mark_some(gc *);
+uint64_t gc_sweep_one(gc *);
+void gc_finish_cycle(gc *);
+
+uint64_t gc_now_ns() {
+  struct timespec t = {0};
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+uint64_t gc_object_size(object *o) {
+  switch (o->type) {
+  case OBJECT_ENV:
+    return sizeof(env) + sizeof(value) * ((env *)o)->size;
+  case OBJECT_CLOSURE:
+    return sizeof(closure);
+  }
+
+  return 0;
+}
+
+void gc_init(gc *g, gc_options options, gc_roots roots, void *roots_data) {
+  *g = (gc){0};
+  g->max_pause_ns = options.max_pause_us * 1000;
+  g->threshold = GC_MIN_THRESHOLD;
+  g->roots = roots;
+  g->roots_data = roots_data;
+}
+
+// Starts or advances a collection once the heap has grown past the
+// threshold, and finishes one if malloc fails.
+void *gc_alloc(gc *g, uint64_t size, object_type type) {
+  object *o = 0;
+
+  g->allocated_since_step += size;
+  if (g->max_pause_ns == 0) {
+    if (g->bytes + size > g->threshold) {
+      gc_collect(g);
+    }
+  } else if (g->phase == GC_IDLE ? g->bytes + size > g->threshold
+                                 : g->allocated_since_step >= GC_STEP_BYTES) {
+    gc_step(g, g->max_pause_ns);
+  }
+
+  o = (object *)malloc(size);
+  if (o == 0) {
+    gc_collect(g);
+    o = (object *)malloc(size);
+    if (o == 0) {
+      return 0;
+    }
+  }
+
+  // Objects made while marking are already reachable, the roots are
+  // scanned again before marking ends.
+  o->type = type;
+  o->color = g->phase == GC_MARK ? GC_BLACK : GC_WHITE;
+  o->next = g->objects;
+  g->objects = o;
+  g->bytes += size;
+  g->stats.bytes_allocated += size;
+  return o;
+}
+
+// Allocates an env with every slot null. parent must be reachable from
+// the roots, the allocation may collect.
+env *gc_env_new(gc *g, env *parent, uint32_t size) {
+  env *e = 0;
+  uint32_t i = 0;
+
+  e = (env *)gc_alloc(g, sizeof(env) + sizeof(value) * size, OBJECT_ENV);
+  if (e == 0) {
+    return 0;
+  }
+
+  e->parent = parent;
+  e->size = size;
+  for (i = 0; i < size; i++) {
+    e->values[i] = NULL_VALUE;
+  }
+
+  if (g->phase == GC_MARK && parent) {
+    gc_mark_object(g, &parent->header);
+  }
+  return e;
+}
+
+// e must be reachable from the roots, the allocation may collect.
+closure *gc_closure_new(gc *g, uint32_t function, env *e) {
+  closure *c = 0;
+
+  c = (closure *)gc_alloc(g, sizeof(closure), OBJECT_CLOSURE);
+  if (c == 0) {
+    return 0;
+  }
+
+  c->function = function;
+  c->env = e;
+
+  if (g->phase == GC_MARK && e) {
+    gc_mark_object(g, &e->header);
+  }
+  return c;
+}
+
+void gc_mark_value(gc *g, value v) {
+  if (IS_FUNCTION(v)) {
+    gc_mark_object(g, &AS_CLOSURE(v)->header);
+  }
+}
+
+void gc_mark_object(gc *g, object *o) {
+  if (o->color != GC_WHITE) {
+    return;
+  }
+
+  o->color = GC_GRAY;
+  if (vector_object_ptr_push(&g->gray, o) != E_VECTOR_OK) {
+    g->gray_overflowed = 1;
+  }
+}
+
+// Returns the size of o, as the amount of work done.
+uint64_t gc_trace(gc *g, object *o) {
+  env *e = 0;
+  uint32_t i = 0;
+
+  o->color = GC_BLACK;
+  switch (o->type) {
+  case OBJECT_ENV:
+    e = (env *)o;
+    if (e->parent) {
+      gc_mark_object(g, &e->parent->header);
+    }
+    for (i = 0; i < e->size; i++) {
+      gc_mark_value(g, e->values[i]);
+    }
+    break;
+  case OBJECT_CLOSURE:
+    e = ((closure *)o)->env;
+    if (e) {
+      gc_mark_object(g, &e->header);
+    }
+    break;
+  }
+
+  return gc_object_size(o);
+}
+
+// Traces some gray objects and returns their size, 0 once there are
+// none left.
+uint64_t gc_mark_some(gc *g) {
+  object *o = 0;
+  uint64_t work = 0;
+
+  if (vector_object_ptr_pop(&g->gray, &o) == E_VECTOR_OK) {
+    return gc_trace(g, o);
+  }
+
+  if (!g->gray_overflowed) {
+    return 0;
+  }
+
+  g->gray_overflowed = 0;
+  for (o = g->objects; o; o = o->next) {
+    if (o->color == GC_GRAY) {
+      work += gc_trace(g, o);
+    }
+  }
+  return work + 1;
+}
+
+// Frees the next unswept object if it is white, otherwise moves it back
+// to the heap as white for the next cycle. Returns its size.
+uint64_t gc_sweep_one(gc *g) {
+  object *o = g->sweeping;
+  uint64_t size = gc_object_size(o);
+
+  g->sweeping = o->next;
+  if (o->color == GC_BLACK) {
+    o->color = GC_WHITE;
+    o->next = g->objects;
+    g->objects = o;
+    return size;
+  }
+
+  g->bytes -= size;
+  g->stats.bytes_freed += size;
+  free(o);
+  return size;
+}
+
+void gc_finish_cycle(gc *g) {
+  g->phase = GC_IDLE;
+  g->stats.collections++;
+  g->threshold = g->bytes * 2;
+  if (g->threshold < GC_MIN_THRESHOLD) {
+    g->threshold = GC_MIN_THRESHOLD;
+  }
+}
+
+// Works on the current cycle for about budget_ns, starting one if there
+// is none. 0 runs the cycle to the end. Each step also traces or sweeps
+// at least twice as many bytes as were allocated since the last one, so
+// a program that allocates faster than short steps can collect gets
+// longer pauses rather than an unbounded heap.
+void gc_step(gc *g, uint64_t budget_ns) {
+  uint64_t start = gc_now_ns(), pause = 0, work = 0, marked = 0, ticks = 0;
+  uint64_t debt = g->allocated_since_step * 2;
+
+  if (g->phase == GC_IDLE) {
+    debt = 0;
+    g->phase = GC_MARK;
+    g->roots(g, g->roots_data);
+  }
+
+  while (g->phase != GC_IDLE) {
+    if (budget_ns && work >= debt && ++ticks % GC_CLOCK_INTERVAL == 0 &&
+        gc_now_ns() - start >= budget_ns) {
+      break;
+    }
+
+    if (g->phase == GC_SWEEP) {
+      if (g->sweeping) {
+        work += gc_sweep_one(g);
+      } else {
+        gc_finish_cycle(g);
+      }
+      continue;
+    }
+
+    marked = gc_mark_some(g);
+    if (marked) {
+      work += marked;
+      continue;
+    }
+
+    // The roots change without barriers, so scan them again and finish
+    // marking in this step. Only what was added since the cycle started
+    // can still be white.
+    g->roots(g, g->roots_data);
+    while ((marked = gc_mark_some(g))) {
+      work += marked;
+    }
+
+    // Objects allocated from here on are white and not swept this cycle.
+    g->phase = GC_SWEEP;
+    g->sweeping = g->objects;
+    g->objects = 0;
+  }
+
+  g->allocated_since_step = 0;
+  pause = gc_now_ns() - start;
+  g->stats.steps++;
+  g->stats.total_pause_ns += pause;
+  if (pause > g->stats.max_pause_ns) {
+    g->stats.max_pause_ns = pause;
+  }
+  if (g->on_pause) {
+    g->on_pause(g->on_pause_data, pause);
+  }
+}
+
+// Finishes the cycle in progress, if any, and then runs a whole one.
+void gc_collect(gc *g) {
+  if (g->phase != GC_IDLE) {
+    gc_step(g, 0);
+  }
+  gc_step(g, 0);
+}
+
+void gc_print_stats(gc *g, FILE *out) {
+  gc_stats *s = &g->stats;
+
+  fprintf(out,
+          "gc: %llu collections in %llu steps, %.3f ms total pause, %.3f ms "
+          "max pause\n"
+          "gc: %llu bytes allocated, %llu bytes reclaimed, %llu bytes live\n",
+          (unsigned long long)s->collections, (unsigned long long)s->steps,
+          s->total_pause_ns / 1e6, s->max_pause_ns / 1e6,
+          (unsigned long long)s->bytes_allocated,
+          (unsigned long long)s->bytes_freed, (unsigned long long)g->bytes);
+}
+
+void gc_free(gc *g) {
+  object *o = 0, *next = 0;
+
+  for (o = g->objects; o; o = next) {
+    next = o->next;
+    free(o);
+  }
+
+  for (o = g->sweeping; o; o = next) {
+    next = o->next;
+    free(o);
+  }
+
+  g->objects = 0;
+  g->sweeping = 0;
+  g->bytes = 0;
+  vector_object_ptr_free(&g->gray);
+}
@@ -0,0 +1,463 @@
+#include "slowjs/inliner.h"
+
+#include "slowjs/common.h"
+#include "slowjs/resolve.h"
+
+struct inliner {
+  flat_ast *flat;
+  inline_options options;
+  FILE *report;
+  // Function the call sites being looked at end up in.
+  uint32_t function;
+  // Functions whose bodies are being copied, so that calls back into
+  // them are left alone.
+  vector_uint32_t active;
+  // Inlining stops once nodes reaches this.
+  uint64_t max_nodes;
+  uint64_t sites;
+  uint64_t inlined;
+};
+typedef struct inliner inliner;
+
+inline_error inliner_push_node(inliner *, flat_node, uint32_t *);
+uint64_t inliner_size(flat_ast *, uint32_t);
+uint64_t inliner_uses(flat_ast *, uint32_t, uint32_t);
+bool inliner_calls(flat_ast *, uint32_t, uint32_t);
+bool inliner_is_leaf(flat_node);
+const char *inliner_order(flat_ast *, uint32_t, uint32_t, bool, uint64_t *,
+                          bool *);
+const char *inliner_refuse(inliner *, flat_node, uint32_t, uint32_t *);
+inline_error inliner_copy(inliner *, uint32_t, uint32_t, uint32_t *);
+inline_error inliner_call(inliner *, uint32_t);
+inline_error inliner_expression(inliner *, uint32_t);
+
+inline_error inliner_push_node(inliner *in, flat_node n, uint32_t *index) {
+  if (vector_flat_node_push(&in->flat->nodes, n) != E_VECTOR_OK) {
+    return E_INLINE_MALLOC;
+  }
+
+  *index = in->flat->nodes.index - 1;
+  return E_INLINE_OK;
+}
+
+uint64_t inliner_size(flat_ast *f, uint32_t node) {
+  flat_node n = f->nodes.elements[node];
+  uint64_t size = 1, i = 0;
+
+  switch (n.type) {
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    return size + inliner_size(f, n.a) + inliner_size(f, n.b);
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+  case FLAT_CONDITIONAL:
+    size += inliner_size(f, n.a);
+    for (i = 0; i < (n.type == FLAT_CONDITIONAL ? 2 : n.count); i++) {
+      size += inliner_size(f, f->extras.elements[n.b + i]);
+    }
+    return size;
+  default:
+    return size;
+  }
+}
+
+// References to slot of the function node is the body of, for a
+// top-level function.
+uint64_t inliner_uses(flat_ast *f, uint32_t node, uint32_t slot) {
+  flat_node n = f->nodes.elements[node];
+  uint64_t uses = 0, i = 0;
+
+  switch (n.type) {
+  case FLAT_LOCAL:
+    return n.b == slot;
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    return inliner_uses(f, n.a, slot) + inliner_uses(f, n.b, slot);
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+  case FLAT_CONDITIONAL:
+    uses = inliner_uses(f, n.a, slot);
+    for (i = 0; i < (n.type == FLAT_CONDITIONAL ? 2 : n.count); i++) {
+      uses += inliner_uses(f, f->extras.elements[n.b + i], slot);
+    }
+    return uses;
+  default:
+    return 0;
+  }
+}
+
+// Whether node makes any call, or with function other than UINT32_MAX,
+// any call to that top-level function.
+bool inliner_calls(flat_ast *f, uint32_t node, uint32_t function) {
+  flat_node n = f->nodes.elements[node], callee = {0};
+  uint64_t i = 0;
+
+  switch (n.type) {
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    return inliner_calls(f, n.a, function) || inliner_calls(f, n.b, function);
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+  case FLAT_CONDITIONAL:
+    callee = f->nodes.elements[n.a];
+    if (n.type != FLAT_CONDITIONAL &&
+        (function == UINT32_MAX ||
+         (callee.type == FLAT_GLOBAL &&
+          f->globals.elements[callee.a] == function))) {
+      return true;
+    }
+
+    if (inliner_calls(f, n.a, function)) {
+      return true;
+    }
+    for (i = 0; i < (n.type == FLAT_CONDITIONAL ? 2 : n.count); i++) {
+      if (inliner_calls(f, f->extras.elements[n.b + i], function)) {
+        return true;
+      }
+    }
+    return false;
+  default:
+    return false;
+  }
+}
+
+bool inliner_is_leaf(flat_node n) {
+  return n.type == FLAT_NUMBER || n.type == FLAT_NULL || n.type == FLAT_BOOL ||
+         n.type == FLAT_LOCAL || n.type == FLAT_GLOBAL;
+}
+
+// Why moving the arguments of the call whose arguments start at args
+// into the body at node would change when they are evaluated, or null
+// if it would not. Arguments that make calls have to be reached in the
+// order they were passed, before any call the body makes itself, and
+// not on only one branch of a conditional. next is the first parameter
+// such an argument may still be passed as, called whether the body has
+// made a call yet.
+const char *inliner_order(flat_ast *f, uint32_t node, uint32_t args,
+                          bool branch, uint64_t *next, bool *called) {
+  flat_node n = f->nodes.elements[node];
+  uint32_t arg = 0;
+  uint64_t i = 0;
+  const char *reason = 0;
+
+  switch (n.type) {
+  case FLAT_LOCAL:
+    arg = f->extras.elements[args + n.b];
+    if (inliner_is_leaf(f->nodes.elements[arg]) ||
+        !inliner_calls(f, arg, UINT32_MAX)) {
+      return 0;
+    }
+
+    if (branch) {
+      return "argument evaluated a different number of times";
+    }
+    if (*called || n.b < *next) {
+      return "arguments evaluated out of order";
+    }
+    *next = n.b + 1;
+    return 0;
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    reason = inliner_order(f, n.a, args, branch, next, called);
+    if (reason) {
+      return reason;
+    }
+    return inliner_order(f, n.b, args, branch, next, called);
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+  case FLAT_CONDITIONAL:
+    reason = inliner_order(f, n.a, args, branch, next, called);
+    if (reason) {
+      return reason;
+    }
+
+    // Only one of the branches is taken.
+    for (i = 0; i < (n.type == FLAT_CONDITIONAL ? 2 : n.count); i++) {
+      reason = inliner_order(f, f->extras.elements[n.b + i], args,
+                             branch || n.type == FLAT_CONDITIONAL, next,
+                             called);
+      if (reason) {
+        return reason;
+      }
+    }
+
+    if (n.type != FLAT_CONDITIONAL) {
+      *called = true;
+    }
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+// Why call cannot be replaced by the body of function, or null if it
+// can. Sets size to the nodes in the body.
+const char *inliner_refuse(inliner *in, flat_node call, uint32_t function,
+                           uint32_t *size) {
+  flat_ast *f = in->flat;
+  flat_function *fn = &f->functions.elements[function];
+  flat_node s = {0}, arg = {0};
+  uint64_t i = 0, uses = 0, next = 0;
+  bool called = false;
+
+  if (fn->nstatements != 1 || fn->nslots != fn->nparameters) {
+    return "body is not a single return";
+  }
+
+  s = f->nodes.elements[f->extras.elements[fn->body]];
+  if (s.type != FLAT_RETURN) {
+    return "body is not a single return";
+  }
+
+  if (call.count != fn->nparameters) {
+    return "argument count differs";
+  }
+
+  for (i = 0; i < in->active.index; i++) {
+    if (in->active.elements[i] == function) {
+      return "recursive";
+    }
+  }
+
+  if (inliner_calls(f, s.a, function)) {
+    return "recursive";
+  }
+
+  *size = inliner_size(f, s.a);
+  if (*size > in->options.max_size) {
+    return "too big";
+  }
+
+  if (f->nodes.index >= in->max_nodes) {
+    return "program grew too much";
+  }
+
+  for (i = 0; i < call.count; i++) {
+    arg = f->nodes.elements[f->extras.elements[call.b + i]];
+    if (inliner_is_leaf(arg)) {
+      continue;
+    }
+
+    uses = inliner_uses(f, s.a, i);
+    if (uses > 1 ||
+        (uses == 0 && inliner_calls(f, f->extras.elements[call.b + i],
+                                    UINT32_MAX))) {
+      return "argument evaluated a different number of times";
+    }
+  }
+
+  return inliner_order(f, s.a, call.b, false, &next, &called);
+}
+
+// Copies the subtree at node of a top-level function's body into the
+// call whose arguments start at args in extras. Calls in the copy are
+// inlined as they are made.
+inline_error inliner_copy(inliner *in, uint32_t node, uint32_t args,
+                          uint32_t *out) {
+  flat_ast *f = in->flat;
+  flat_node n = f->nodes.elements[node], arg = {0};
+  uint32_t child = 0, start = 0, nchildren = 0;
+  uint64_t i = 0;
+  inline_error err = E_INLINE_OK;
+
+  switch (n.type) {
+  case FLAT_LOCAL:
+    // Arguments that are not leaves are used at most once, and those
+    // that make calls in the order they were passed, so they can move
+    // rather than be copied.
+    arg = f->nodes.elements[f->extras.elements[args + n.b]];
+    if (!inliner_is_leaf(arg)) {
+      *out = f->extras.elements[args + n.b];
+      return E_INLINE_OK;
+    }
+    return inliner_push_node(in, arg, out);
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    err = inliner_copy(in, n.a, args, &n.a);
+    if (err != E_INLINE_OK) {
+      return err;
+    }
+    err = inliner_copy(in, n.b, args, &n.b);
+    if (err != E_INLINE_OK) {
+      return err;
+    }
+    return inliner_push_node(in, n, out);
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+  case FLAT_CONDITIONAL:
+    err = inliner_copy(in, n.a, args, &n.a);
+    if (err != E_INLINE_OK) {
+      return err;
+    }
+
+    // The copy is not in tail position in the caller, inline_calls marks
+    // tail calls again once it is done.
+    if (n.type == FLAT_TAIL_CALL) {
+      n.type = FLAT_CALL;
+    }
+
+    // Reserved up front so that copying the children, which may append
+    // lists of their own, leaves this one contiguous.
+    nchildren = n.type == FLAT_CONDITIONAL ? 2 : n.count;
+    start = f->extras.index;
+    for (i = 0; i < nchildren; i++) {
+      if (vector_uint32_t_push(&f->extras, 0) != E_VECTOR_OK) {
+        return E_INLINE_MALLOC;
+      }
+    }
+
+    for (i = 0; i < nchildren; i++) {
+      err = inliner_copy(in, f->extras.elements[n.b + i], args, &child);
+      if (err != E_INLINE_OK) {
+        return err;
+      }
+      f->extras.elements[start + i] = child;
+    }
+    n.b = start;
+
+    err = inliner_push_node(in, n, out);
+    if (err != E_INLINE_OK || n.type != FLAT_CALL) {
+      return err;
+    }
+    return inliner_call(in, *out);
+  default:
+    return inliner_push_node(in, n, out);
+  }
+}
+
+// Replaces the call at node with the body of the function it calls if
+// it is small enough.
+inline_error inliner_call(inliner *in, uint32_t node) {
+  flat_ast *f = in->flat;
+  flat_node call = f->nodes.elements[node], callee = {0};
+  flat_function *fn = 0;
+  uint32_t function = 0, body = 0, size = 0, popped = 0;
+  const char *reason = 0;
+  inline_error err = E_INLINE_OK;
+
+  callee = f->nodes.elements[call.a];
+  if (callee.type != FLAT_GLOBAL) {
+    return E_INLINE_OK;
+  }
+
+  function = f->globals.elements[callee.a];
+  fn = &f->functions.elements[function];
+  in->sites++;
+
+  reason = inliner_refuse(in, call, function, &size);
+  if (reason) {
+    if (in->report) {
+      fprintf(in->report, "inline: %s not inlined into %s, %s\n",
+              interned_name(&f->names, fn->name),
+              interned_name(&f->names,
+                            f->functions.elements[in->function].name),
+              reason);
+    }
+    return E_INLINE_OK;
+  }
+
+  if (in->report) {
+    fprintf(in->report, "inline: %s inlined into %s, %u nodes\n",
+            interned_name(&f->names, fn->name),
+            interned_name(&f->names, f->functions.elements[in->function].name),
+            size);
+  }
+  in->inlined++;
+
+  body = f->nodes.elements[f->extras.elements[fn->body]].a;
+  if (vector_uint32_t_push(&in->active, function) != E_VECTOR_OK) {
+    return E_INLINE_MALLOC;
+  }
+  err = inliner_copy(in, body, call.b, &body);
+  vector_uint32_t_pop(&in->active, &popped);
+  if (err != E_INLINE_OK) {
+    return err;
+  }
+
+  // The call node becomes the root of the copy, anything pointing at it
+  // now points at the body.
+  f->nodes.elements[node] = f->nodes.elements[body];
+  return E_INLINE_OK;
+}
+
+// Inlines calls in the subtree at node, innermost first so arguments
+// are as small as they will get before deciding on the call.
+inline_error inliner_expression(inliner *in, uint32_t node) {
+  flat_ast *f = in->flat;
+  flat_node n = f->nodes.elements[node];
+  uint64_t i = 0;
+  inline_error err = E_INLINE_OK;
+
+  switch (n.type) {
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    err = inliner_expression(in, n.a);
+    if (err != E_INLINE_OK) {
+      return err;
+    }
+    return inliner_expression(in, n.b);
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+  case FLAT_CONDITIONAL:
+    err = inliner_expression(in, n.a);
+    if (err != E_INLINE_OK) {
+      return err;
+    }
+    for (i = 0; i < (n.type == FLAT_CONDITIONAL ? 2 : n.count); i++) {
+      err = inliner_expression(in, f->extras.elements[n.b + i]);
+      if (err != E_INLINE_OK) {
+        return err;
+      }
+    }
+    if (n.type != FLAT_CONDITIONAL) {
+      return inliner_call(in, node);
+    }
+    return E_INLINE_OK;
+  default:
+    return E_INLINE_OK;
+  }
+}
+
+inline_error inline_calls(flat_ast *f, inline_options options, FILE *report) {
+  inliner in = {0};
+  flat_function fn = {0};
+  flat_node s = {0};
+  uint64_t i = 0, j = 0;
+  inline_error err = E_INLINE_OK;
+
+  if (options.max_size == 0) {
+    return E_INLINE_OK;
+  }
+
+  in.flat = f;
+  in.options = options;
+  in.report = report;
+  in.max_nodes = f->nodes.index * INLINE_MAX_GROWTH;
+
+  for (i = 0; i < f->functions.index; i++) {
+    in.function = i;
+    fn = f->functions.elements[i];
+    for (j = 0; j < fn.nstatements; j++) {
+      s = f->nodes.elements[f->extras.elements[fn.body + j]];
+      if (s.type != FLAT_RETURN && s.type != FLAT_EXPRESSION) {
+        continue;
+      }
+
+      err = inliner_expression(&in, s.a);
+      if (err != E_INLINE_OK) {
+        goto cleanup;
+      }
+    }
+  }
+
+  resolve_tail_calls(f);
+
+  if (report) {
+    fprintf(report, "inline: %llu of %llu call sites inlined\n",
+            (unsigned long long)in.inlined, (unsigned long long)in.sites);
+  }
+
+cleanup:
+  vector_uint32_t_free(&in.active);
+  return err;
+}
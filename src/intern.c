@@ -0,0 +1,119 @@
+#include "slowjs/intern.h"
+
+uint64_t intern_hash(const char *, uint64_t);
+intern_error intern_grow(interner *);
+uint32_t *intern_slot(interner *, const char *, uint64_t);
+
+// FNV-1a
+uint64_t intern_hash(const char *name, uint64_t length) {
+  uint64_t h = 14695981039346656037ULL;
+  uint64_t i = 0;
+
+  for (i = 0; i < length; i++) {
+    h ^= (unsigned char)name[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+// Finds the slot holding name, or the empty slot it would go in.
+uint32_t *intern_slot(interner *in, const char *name, uint64_t length) {
+  uint64_t i = intern_hash(name, length) & (in->capacity - 1);
+  string *s = 0;
+
+  while (in->slots[i]) {
+    s = &in->names.elements[in->slots[i] - 1];
+    if (s->index - 1 == length && memcmp(s->elements, name, length) == 0) {
+      break;
+    }
+
+    i = (i + 1) & (in->capacity - 1);
+  }
+
+  return &in->slots[i];
+}
+
+intern_error intern_grow(interner *in) {
+  uint32_t *old = in->slots;
+  uint64_t old_capacity = in->capacity, i = 0;
+  string *s = 0;
+
+  in->capacity = old_capacity ? old_capacity * 2 : 64;
+  in->slots = (uint32_t *)calloc(in->capacity, sizeof(uint32_t));
+  if (in->slots == 0) {
+    in->slots = old;
+    in->capacity = old_capacity;
+    return E_INTERN_MALLOC;
+  }
+
+  for (i = 0; i < in->names.index; i++) {
+    s = &in->names.elements[i];
+    *intern_slot(in, s->elements, s->index - 1) = i + 1;
+  }
+
+  free(old);
+  return E_INTERN_OK;
+}
+
+intern_error intern(interner *in, const char *name, uint64_t length,
+                    uint32_t *id) {
+  string s = {0};
+  uint32_t *slot = 0;
+  intern_error err = E_INTERN_OK;
+
+  // Keep the table at most half full.
+  if (in->names.index * 2 >= in->capacity) {
+    err = intern_grow(in);
+    if (err != E_INTERN_OK) {
+      return err;
+    }
+  }
+
+  slot = intern_slot(in, name, length);
+  if (*slot) {
+    *id = *slot - 1;
+    return E_INTERN_OK;
+  }
+
+  if (vector_char_copy(&s, (char *)name, length) != E_VECTOR_OK ||
+      vector_char_push(&s, 0) != E_VECTOR_OK ||
+      vector_string_push(&in->names, s) != E_VECTOR_OK) {
+    vector_char_free(&s);
+    return E_INTERN_MALLOC;
+  }
+
+  *id = in->names.index - 1;
+  *slot = in->names.index;
+  return E_INTERN_OK;
+}
+
+intern_error intern_lookup(interner *in, const char *name, uint64_t length,
+                           uint32_t *id) {
+  uint32_t *slot = 0;
+
+  if (!in->capacity) {
+    return E_INTERN_NOT_FOUND;
+  }
+
+  slot = intern_slot(in, name, length);
+  if (!*slot) {
+    return E_INTERN_NOT_FOUND;
+  }
+
+  *id = *slot - 1;
+  return E_INTERN_OK;
+}
+
+const char *interned_name(interner *in, uint32_t id) {
+  return in->names.elements[id].elements;
+}
+
+static void string_element_free(string *s) { vector_char_free(s); }
+
+void interner_free(interner *in) {
+  in->names.element_free = string_element_free;
+  vector_string_free(&in->names);
+  free(in->slots);
+  *in = (interner){0};
+}
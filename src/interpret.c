@@ -3,265 +3,745 @@
 #include <stdio.h>
 #include <string.h>
 
-#include "slowjs/ast.h"
 #include "slowjs/common.h"
-#include "slowjs/vector.h"
-
-struct vector_context;
+#include "slowjs/flat.h"
+#include "slowjs/gc.h"
+#include "slowjs/inliner.h"
+#include "slowjs/quicken.h"
+#include "slowjs/resolve.h"
+#include "slowjs/value.h"
+
+// How many values p is past q, without pointer arithmetic on q, which
+// may have been freed.
+#define INTERPRET_OFFSET(p, q)                                                 \
+  (((uintptr_t)(p) - (uintptr_t)(q)) / sizeof(value))
+
+// Evaluation never recurses in C. What is left to do is kept as work on
+// a stack, innermost first, and the loop in interpret_run pops one item
+// at a time and pushes whatever finishes it.
+enum work_type {
+  WORK_EVAL,      // node: expression, pushes its value
+  WORK_OP,        // node: op, pops both operands and pushes the result
+  WORK_BRANCH,    // node: conditional, pops the test
+  WORK_CALL,      // count: arguments on the stack above the callee
+  WORK_TAIL_CALL, // count: same, but replaces the current call
+  WORK_STATEMENT, // node: index of the next statement of the current call
+  WORK_POP,       // drops the value of an expression statement
+  WORK_RETURN,    // ends the current call, leaving its value
+};
+typedef enum work_type work_type;
 
-struct closure {
-  struct vector_context *ctx;
-  vector_string parameters;
-  vector_statement body;
+struct work {
+  uint16_t type;
+  uint16_t count;
+  uint32_t node;
+};
+typedef struct work work;
+
+struct frame {
+  flat_function *fn;
+  // The callee on the stack, the call's arguments and slots follow it
+  // unless it has an env.
+  value *callee;
+  value *slots;
+  // Env of the function the callee was declared in.
+  env *outer;
+  // Env holding the slots if the callee has heap slots.
+  env *env;
 };
-typedef struct closure closure;
+typedef struct frame frame;
+
+struct interpreter {
+  flat_ast *flat;
+  // Closure bound to each global slot.
+  value *globals;
+  // Closure of every function with no env, so top-level functions need
+  // no allocation to become values.
+  closure *functions;
+  gc heap;
+  quicken_stats quicken;
+  // Slots of calls that are not captured, and the values of expressions
+  // still being evaluated.
+  value *stack;
+  value *sp;
+  value *stack_end;
+  uint64_t stack_size;
+  work *work;
+  uint64_t nwork;
+  uint64_t work_size;
+  frame *frames;
+  uint64_t nframes;
+  uint64_t frames_size;
+  // The three stacks above grow on the heap up to this many bytes
+  // together.
+  uint64_t stack_limit;
+  // Nonzero for each node with a call in its subtree, which has to be
+  // evaluated as work. The rest is evaluated directly by
+  // interpret_pure.
+  uint8_t *calls;
+};
+typedef struct interpreter interpreter;
+
+void interpret_roots(gc *, void *);
+uint64_t interpret_stack_bytes(interpreter *);
+interpret_error interpret_grow(interpreter *, void **, uint64_t *, uint64_t,
+                               uint64_t);
+interpret_error interpret_grow_stack(interpreter *, uint64_t);
+interpret_error interpret_reserve(interpreter *, uint64_t, uint64_t);
+interpret_error interpret_hoist(interpreter *, flat_function *, env *);
+interpret_error interpret_bind(interpreter *, frame *, uint64_t);
+interpret_error interpret_call(interpreter *, uint64_t);
+interpret_error interpret_tail_call(interpreter *, uint64_t);
+value interpret_arithmetic(uint8_t, double, double);
+value interpret_op(interpreter *, uint32_t, value, value);
+bool interpret_find_calls(interpreter *, uint32_t);
+value interpret_pure(interpreter *, frame *, uint32_t);
+interpret_error interpret_eval(interpreter *, frame *, uint32_t);
+interpret_error interpret_statement(interpreter *, frame *, uint32_t);
+interpret_error interpret_run(interpreter *, value, value *);
+
+void interpret_roots(gc *g, void *data) {
+  interpreter *in = (interpreter *)data;
+  value *v = 0;
+  uint64_t i = 0;
 
-enum value_type { VALUE_NUMBER, VALUE_CLOSURE, VALUE_NULL, VALUE_BOOL };
-typedef enum value_type value_type;
+  for (v = in->stack; v < in->sp; v++) {
+    gc_mark_value(g, *v);
+  }
 
-struct value {
-  value_type type;
-  union {
-    double number;
-    closure closure;
-  } value;
-};
-typedef struct value value;
+  for (i = 0; i < in->nframes; i++) {
+    if (in->frames[i].outer) {
+      gc_mark_object(g, &in->frames[i].outer->header);
+    }
+    if (in->frames[i].env) {
+      gc_mark_object(g, &in->frames[i].env->header);
+    }
+  }
+}
 
-DECLARE_VECTOR(value)
+uint64_t interpret_stack_bytes(interpreter *in) {
+  return in->stack_size * sizeof(value) + in->work_size * sizeof(work) +
+         in->frames_size * sizeof(frame);
+}
 
-struct context {
-  vector_char name;
-  value value;
-};
-typedef struct context context;
+// Grows the array at *elements of *size elements to hold at least need,
+// doubling it unless that would go past the limit.
+interpret_error interpret_grow(interpreter *in, void **elements,
+                               uint64_t *size, uint64_t element_size,
+                               uint64_t need) {
+  uint64_t other = interpret_stack_bytes(in) - *size * element_size;
+  uint64_t grown = *size * 2;
+  void *p = 0;
+
+  if (grown < INTERPRET_INITIAL_STACK) {
+    grown = INTERPRET_INITIAL_STACK;
+  }
+  if (grown < need) {
+    grown = need;
+  }
 
-DECLARE_VECTOR(context)
+  if (other + grown * element_size > in->stack_limit) {
+    grown = other < in->stack_limit
+                ? (in->stack_limit - other) / element_size
+                : 0;
+    if (grown < need) {
+      return E_INTERPRET_STACK_OVERFLOW;
+    }
+  }
 
-interpret_error interpret_expression(expression, vector_context *, value *);
-interpret_error interpret_statements(vector_statement, vector_context *,
-                                     value *);
-interpret_error interpret_declaration(declaration, vector_context *);
+  p = realloc(*elements, grown * element_size);
+  if (p == 0) {
+    return E_INTERPRET_CRASH;
+  }
 
-interpret_error interpret_function_call(function_call fc, vector_context *ctx,
-                                        value *result) {
-  vector_context child_ctx = {0};
-  value function = {0}, v = {0};
-  vector_char p = {0};
-  context mapping = {0};
-  uint64_t i = 0;
+  *elements = p;
+  *size = grown;
+  return E_INTERPRET_OK;
+}
+
+// Makes room for at least n more values. Frames point into the stack,
+// so they move with it.
+interpret_error interpret_grow_stack(interpreter *in, uint64_t n) {
+  value *old = in->stack;
+  uint64_t used = in->sp - in->stack, i = 0;
+  frame *fr = 0;
   interpret_error err = E_INTERPRET_OK;
 
-  err = interpret_expression(*fc.function, ctx, &function);
+  err = interpret_grow(in, (void **)&in->stack, &in->stack_size, sizeof(value),
+                       used + n);
   if (err != E_INTERPRET_OK) {
     return err;
   }
 
-  if (function.type != VALUE_CLOSURE) {
-    return E_INTERPRET_CALL_NONFUNCTION;
+  // old may be freed, it is only used for offsets.
+  in->sp = in->stack + used;
+  in->stack_end = in->stack + in->stack_size;
+  for (i = 0; i < in->nframes; i++) {
+    fr = &in->frames[i];
+    fr->callee = in->stack + INTERPRET_OFFSET(fr->callee, old);
+    if (fr->env == 0) {
+      fr->slots = in->stack + INTERPRET_OFFSET(fr->slots, old);
+    }
   }
 
-  if (vector_context_copy(&child_ctx, ctx->elements, ctx->index) !=
-      E_VECTOR_OK) {
-    // TODO: log that main is not a function
-    return E_INTERPRET_CRASH;
-  }
+  return E_INTERPRET_OK;
+}
+
+// Makes room for at least nwork more work and nvalues more values.
+interpret_error interpret_reserve(interpreter *in, uint64_t nwork,
+                                  uint64_t nvalues) {
+  interpret_error err = E_INTERPRET_OK;
 
-  for (i = 0; i < function.value.closure.parameters.index; i++) {
-    // TODO: guard against inequal number of arguments
-    p = function.value.closure.parameters.elements[i];
-    err = interpret_expression(fc.arguments->elements[i], ctx, &v);
+  if (in->work_size - in->nwork < nwork) {
+    err = interpret_grow(in, (void **)&in->work, &in->work_size, sizeof(work),
+                         in->nwork + nwork);
     if (err != E_INTERPRET_OK) {
       return err;
     }
+  }
+
+  if ((uint64_t)(in->stack_end - in->sp) < nvalues) {
+    return interpret_grow_stack(in, nvalues);
+  }
+
+  return E_INTERPRET_OK;
+}
+
+// Binds the function declarations in fn's body, which are hoisted, in
+// its env.
+interpret_error interpret_hoist(interpreter *in, flat_function *fn, env *e) {
+  flat_ast *f = in->flat;
+  closure *nested = 0;
+  flat_node s = {0};
+  uint64_t i = 0;
+
+  for (i = 0; e && i < fn->nstatements; i++) {
+    s = f->nodes.elements[f->extras.elements[fn->body + i]];
+    if (s.type != FLAT_FUNCTION) {
+      continue;
+    }
+
+    nested = gc_closure_new(&in->heap, s.a, e);
+    if (nested == 0) {
+      return E_INTERPRET_CRASH;
+    }
+    e->values[s.b] = FUNCTION_VALUE(nested);
+    GC_WRITE_BARRIER(&in->heap, e->values[s.b]);
+  }
+
+  return E_INTERPRET_OK;
+}
+
+// Starts the call in fr, whose callee and count arguments, no more than
+// it has parameters, are on top of the stack.
+interpret_error interpret_bind(interpreter *in, frame *fr, uint64_t count) {
+  closure *c = AS_CLOSURE(*fr->callee);
+  flat_function *fn = &in->flat->functions.elements[c->function];
+  env *e = 0;
+  uint64_t i = 0;
+  interpret_error err = E_INTERPRET_OK;
+
+  fr->fn = fn;
+  fr->outer = c->env;
+  fr->env = 0;
+  fr->slots = fr->callee + 1;
+
+  // Slots nested functions can see have to outlive the call. The
+  // arguments stay on the stack until they are in the env so the
+  // allocation cannot collect them.
+  if (fn->heap_slots) {
+    e = gc_env_new(&in->heap, c->env, fn->nslots);
+    if (e == 0) {
+      return E_INTERPRET_CRASH;
+    }
+    for (i = 0; i < count; i++) {
+      e->values[i] = fr->slots[i];
+      GC_WRITE_BARRIER(&in->heap, e->values[i]);
+    }
+    fr->env = e;
+    fr->slots = e->values;
+    in->sp = fr->callee + 1;
+    return interpret_hoist(in, fn, e);
+  }
 
-    mapping.name = p;
-    mapping.value = v;
-    vector_context_push(&child_ctx, mapping);
+  if ((uint64_t)(in->stack_end - fr->slots) < fn->nslots) {
+    err = interpret_grow_stack(in, fn->nslots - count);
+    if (err != E_INTERPRET_OK) {
+      return err;
+    }
   }
 
-  return interpret_statements(function.value.closure.body, &child_ctx, result);
+  // Missing arguments and the rest of the slots start out null.
+  for (i = count; i < fn->nslots; i++) {
+    fr->slots[i] = NULL_VALUE;
+  }
+  in->sp = fr->slots + fn->nslots;
+  return E_INTERPRET_OK;
 }
 
-interpret_error interpret_op(op o, vector_context *ctx, value *result) {
-  value left = {0}, right = {0};
+interpret_error interpret_call(interpreter *in, uint64_t count) {
+  value callee = in->sp[-(int64_t)count - 1];
+  flat_function *fn = 0;
+  frame *fr = 0;
   interpret_error err = E_INTERPRET_OK;
 
-  err = interpret_expression(*o.left_operand, ctx, &left);
+  if (!IS_FUNCTION(callee)) {
+    return E_INTERPRET_CALL_NONFUNCTION;
+  }
+
+  // Extra arguments are evaluated and dropped.
+  fn = &in->flat->functions.elements[AS_CLOSURE(callee)->function];
+  if (count > fn->nparameters) {
+    in->sp -= count - fn->nparameters;
+    count = fn->nparameters;
+  }
+
+  if (in->nframes == in->frames_size) {
+    err = interpret_grow(in, (void **)&in->frames, &in->frames_size,
+                         sizeof(frame), in->nframes + 1);
+    if (err != E_INTERPRET_OK) {
+      return err;
+    }
+  }
+
+  err = interpret_reserve(in, 1, 0);
   if (err != E_INTERPRET_OK) {
     return err;
   }
 
-  err = interpret_expression(*o.right_operand, ctx, &right);
+  fr = &in->frames[in->nframes++];
+  *fr = (frame){0};
+  fr->callee = in->sp - count - 1;
+  err = interpret_bind(in, fr, count);
   if (err != E_INTERPRET_OK) {
     return err;
   }
 
-  result->type = VALUE_NUMBER;
-  switch (o.type) {
+  in->work[in->nwork++] = (work){WORK_RETURN, 0, 0};
+  return interpret_statement(in, fr, 0);
+}
+
+// Replaces the current call with the one whose callee and arguments are
+// on top of the stack. Everything else the current call had on the stack
+// is dead, so they move down to where its callee was and the stack
+// never grows.
+interpret_error interpret_tail_call(interpreter *in, uint64_t count) {
+  value *callee = in->sp - count - 1;
+  frame *fr = &in->frames[in->nframes - 1];
+  flat_function *fn = 0;
+  interpret_error err = E_INTERPRET_OK;
+
+  if (!IS_FUNCTION(*callee)) {
+    return E_INTERPRET_CALL_NONFUNCTION;
+  }
+
+  fn = &in->flat->functions.elements[AS_CLOSURE(*callee)->function];
+  if (count > fn->nparameters) {
+    count = fn->nparameters;
+  }
+
+  memmove(fr->callee, callee, sizeof(value) * (count + 1));
+  in->sp = fr->callee + count + 1;
+  err = interpret_bind(in, fr, count);
+  if (err != E_INTERPRET_OK) {
+    return err;
+  }
+
+  return interpret_statement(in, fr, 0);
+}
+
+value interpret_arithmetic(uint8_t op, double l, double r) {
+  switch (op) {
   case OP_PLUS:
-    result->value.number = left.value.number + right.value.number;
-    break;
+    return number_value(l + r);
   case OP_MINUS:
-    result->value.number = left.value.number - right.value.number;
-    break;
+    return number_value(l - r);
   case OP_TIMES:
-    result->value.number = left.value.number * right.value.number;
-    break;
+    return number_value(l * r);
   case OP_DIV:
-    result->value.number = left.value.number / right.value.number;
+    return number_value(l / r);
+  case OP_LESS:
+    return BOOL_VALUE(l < r);
+  default:
+    return BOOL_VALUE(l > r);
   }
-
-  return E_INTERPRET_OK;
 }
 
-interpret_error interpret_expression(expression e, vector_context *ctx,
-                                     value *result) {
-  uint64_t i = 0;
-  bool matched = false;
-
-  switch (e.type) {
-  case EXPRESSION_IDENTIFIER:
-    for (i = 0; i < ctx->index; i++) {
-      printf("looking up: %s\n", e.expression.identifier.elements);
-      matched = strncmp(ctx->elements[i].name.elements,
-                        e.expression.identifier.elements,
-                        ctx->elements[i].name.index) == 0;
-      if (matched) {
-        *result = ctx->elements[i].value;
-        return E_INTERPRET_OK;
-      }
+// Quickens the node between FLAT_OP and FLAT_NUMBER_OP depending on
+// what its operands turn out to be.
+value interpret_op(interpreter *in, uint32_t node, value left, value right) {
+  flat_node *site = &in->flat->nodes.elements[node];
+  bool numbers = IS_NUMBER(left) && IS_NUMBER(right);
+
+  if (site->type == FLAT_NUMBER_OP) {
+    if (numbers) {
+      in->quicken.hits++;
+      return interpret_arithmetic(site->op, value_number(left),
+                                  value_number(right));
     }
 
-    // TODO: handle semantics correctly and usefully
-    return E_INTERPRET_CRASH;
-  case EXPRESSION_NUMBER:
-    result->type = VALUE_NUMBER;
-    result->value.number = e.expression.number;
-    return E_INTERPRET_OK;
-  case EXPRESSION_CALL:
-    return interpret_function_call(e.expression.function_call, ctx, result);
-  case EXPRESSION_OP:
-    return interpret_op(e.expression.op, ctx, result);
-  case EXPRESSION_BOOL:
-    result->type = VALUE_BOOL;
-    result->value.number = e.expression.number;
-    return E_INTERPRET_OK;
-  case EXPRESSION_NULL:
-    result->type = VALUE_NULL;
-    result->value.number = 0;
-    return E_INTERPRET_OK;
+    site->type = FLAT_OP;
+    in->quicken.misses++;
+  } else if (numbers) {
+    site->type = FLAT_NUMBER_OP;
+    in->quicken.quickened++;
   }
+
+  in->quicken.generic++;
+  return interpret_arithmetic(site->op, value_to_number(left),
+                              value_to_number(right));
 }
 
-interpret_error interpret_statement(statement s, vector_context *ctx,
-                                    value *result) {
-  value nothing = {0};
+// Whether the subtree at node makes a call, filling in in->calls for
+// it and everything below.
+bool interpret_find_calls(interpreter *in, uint32_t node) {
+  flat_ast *f = in->flat;
+  flat_node n = f->nodes.elements[node];
+  bool calls = false;
+  uint64_t i = 0;
 
-  switch (s.type) {
-  case STATEMENT_RETURN:
-    return interpret_expression(s.statement.ret, ctx, result);
-  case STATEMENT_EXPRESSION:
-    return interpret_expression(s.statement.expression, ctx, &nothing);
-  case STATEMENT_DECLARATION:
-    return interpret_declaration(*s.statement.declaration, ctx);
+  switch (n.type) {
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    calls = interpret_find_calls(in, n.a);
+    calls = interpret_find_calls(in, n.b) || calls;
+    break;
+  case FLAT_CONDITIONAL:
+    calls = interpret_find_calls(in, n.a);
+    for (i = 0; i < 2; i++) {
+      calls = interpret_find_calls(in, f->extras.elements[n.b + i]) || calls;
+    }
+    break;
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+    interpret_find_calls(in, n.a);
+    for (i = 0; i < n.count; i++) {
+      interpret_find_calls(in, f->extras.elements[n.b + i]);
+    }
+    calls = true;
+    break;
+  default:
+    break;
   }
+
+  in->calls[node] = calls;
+  return calls;
 }
 
-interpret_error interpret_statements(vector_statement body, vector_context *ctx,
-                                     value *result) {
-  uint64_t i = 0;
-  interpret_error err = E_INTERPRET_OK;
+// Evaluates node, which makes no calls, right away in C. Its depth is
+// then bounded by the source rather than by the program's recursion.
+// Nothing can be assigned, so reading a variable early gives the same
+// value.
+value interpret_pure(interpreter *in, frame *fr, uint32_t node) {
+  flat_node n = in->flat->nodes.elements[node];
+  value left = 0;
+  env *e = 0;
+  uint32_t depth = 0;
+
+  switch (n.type) {
+  case FLAT_LOCAL:
+    if (n.a == 0) {
+      return fr->slots[n.b];
+    }
 
-  for (i = 0; i < body.index; i++) {
-    err = interpret_statement(body.elements[i], ctx, result);
-    if (err != E_INTERPRET_OK) {
-      return err;
+    e = fr->outer;
+    for (depth = 1; depth < n.a; depth++) {
+      e = e->parent;
     }
+    return e->values[n.b];
+  case FLAT_GLOBAL:
+    return in->globals[n.a];
+  case FLAT_NUMBER:
+    return number_value(flat_number(n));
+  case FLAT_BOOL:
+    return BOOL_VALUE(n.a);
+  case FLAT_NULL:
+    return NULL_VALUE;
+  case FLAT_OP:
+  case FLAT_NUMBER_OP:
+    left = interpret_pure(in, fr, n.a);
+    return interpret_op(in, node, left, interpret_pure(in, fr, n.b));
+  case FLAT_CONDITIONAL:
+    left = interpret_pure(in, fr, n.a);
+    return interpret_pure(
+        in, fr, in->flat->extras.elements[n.b + !value_truthy(left)]);
+  default:
+    return NULL_VALUE;
   }
-
-  return E_INTERPRET_OK;
 }
 
-interpret_error interpret_function_declaration(function_declaration fd,
-                                               vector_context *ctx) {
-  closure c = {0};
-  value v = {0};
-  context mapping = {0};
+// Pushes the value of node, or the work that will.
+interpret_error interpret_eval(interpreter *in, frame *fr, uint32_t node) {
+  flat_ast *f = in->flat;
+  flat_node n = {0};
+  value test = 0;
+  uint32_t operand = 0;
+  uint64_t i = 0, done = 0, operands = 0;
+  interpret_error err = E_INTERPRET_OK;
 
-  c.ctx = ctx;
-  c.parameters = fd.parameters;
-  c.body = fd.body;
+  err = interpret_reserve(in, 3, 1);
+  if (err != E_INTERPRET_OK) {
+    return err;
+  }
 
-  v.value.closure = c;
-  v.type = VALUE_CLOSURE;
+  // Conditionals with a test that makes no calls go straight to the
+  // branch.
+  while (in->calls[node]) {
+    n = f->nodes.elements[node];
+    switch (n.type) {
+    case FLAT_OP:
+    case FLAT_NUMBER_OP:
+      in->work[in->nwork++] = (work){WORK_OP, 0, node};
+      in->work[in->nwork++] = (work){WORK_EVAL, 0, n.b};
+      if (in->calls[n.a]) {
+        in->work[in->nwork++] = (work){WORK_EVAL, 0, n.a};
+      } else {
+        *in->sp++ = interpret_pure(in, fr, n.a);
+      }
+      return E_INTERPRET_OK;
+    case FLAT_CONDITIONAL:
+      if (in->calls[n.a]) {
+        in->work[in->nwork++] = (work){WORK_BRANCH, 0, node};
+        in->work[in->nwork++] = (work){WORK_EVAL, 0, n.a};
+        return E_INTERPRET_OK;
+      }
+      test = interpret_pure(in, fr, n.a);
+      node = f->extras.elements[n.b + !value_truthy(test)];
+      continue;
+    case FLAT_CALL:
+    case FLAT_TAIL_CALL:
+      // The callee and then the arguments. Leading ones that make no
+      // calls go straight on the stack, the rest are evaluated in
+      // order.
+      operands = n.count + 1;
+      err = interpret_reserve(in, operands + 1, operands);
+      if (err != E_INTERPRET_OK) {
+        return err;
+      }
 
-  mapping.name = fd.name;
-  mapping.value = v;
+      in->work[in->nwork++] = (work){
+          n.type == FLAT_CALL ? WORK_CALL : WORK_TAIL_CALL, n.count, node};
+      for (done = 0; done < operands; done++) {
+        operand = done ? f->extras.elements[n.b + done - 1] : n.a;
+        if (in->calls[operand]) {
+          break;
+        }
+        *in->sp++ = interpret_pure(in, fr, operand);
+      }
 
-  printf("storing function: %s\n", fd.name.elements);
+      for (i = operands; i > done; i--) {
+        in->work[in->nwork++] = (work){
+            WORK_EVAL, 0, i == 1 ? n.a : f->extras.elements[n.b + i - 2]};
+      }
+      return E_INTERPRET_OK;
+    default:
+      return E_INTERPRET_CRASH;
+    }
+  }
 
-  return (interpret_error)vector_context_push(ctx, mapping);
+  *in->sp++ = interpret_pure(in, fr, node);
+  return E_INTERPRET_OK;
 }
 
-interpret_error interpret_declaration(declaration d, vector_context *ctx) {
-  if (d.type == DECLARATION_FUNCTION) {
-    return interpret_function_declaration(d.declaration.function, ctx);
+// Runs statement i of the current call onwards up to the first one
+// that needs work.
+interpret_error interpret_statement(interpreter *in, frame *fr, uint32_t i) {
+  flat_ast *f = in->flat;
+  flat_function *fn = fr->fn;
+  flat_node s = {0};
+  interpret_error err = E_INTERPRET_OK;
+
+  // Function declarations are already bound.
+  for (; i < fn->nstatements; i++) {
+    s = f->nodes.elements[f->extras.elements[fn->body + i]];
+    if (s.type != FLAT_FUNCTION) {
+      break;
+    }
   }
 
-  // return interpret_variable_list(d.variable_list, ctx);
-  return E_INTERPRET_CRASH;
+  err = interpret_reserve(in, 3, 1);
+  if (err != E_INTERPRET_OK) {
+    return err;
+  }
+
+  // Falling off the end returns null.
+  if (i == fn->nstatements) {
+    *in->sp++ = NULL_VALUE;
+    return E_INTERPRET_OK;
+  }
+
+  switch (s.type) {
+  case FLAT_RETURN:
+    in->work[in->nwork++] = (work){WORK_EVAL, 0, s.a};
+    return E_INTERPRET_OK;
+  case FLAT_EXPRESSION:
+    in->work[in->nwork++] = (work){WORK_STATEMENT, 0, i + 1};
+    in->work[in->nwork++] = (work){WORK_POP, 0, 0};
+    in->work[in->nwork++] = (work){WORK_EVAL, 0, s.a};
+    return E_INTERPRET_OK;
+  default:
+    return E_INTERPRET_CRASH;
+  }
 }
 
-interpret_error call_main(vector_context *ctx, function_declaration *main) {
-  expression function = {0};
-  vector_expression arguments = {0};
-  value v = {0};
-  function_call fc = {0};
+// Calls callee with no arguments. Everything a program does goes
+// through the loop here, one piece of work at a time.
+interpret_error interpret_run(interpreter *in, value callee, value *result) {
+  frame *fr = 0;
+  flat_node n = {0};
+  work w = {0};
+  value v = 0;
   interpret_error err = E_INTERPRET_OK;
 
-  function.type = EXPRESSION_IDENTIFIER;
-  vector_char_copy(&function.expression.identifier, "main", 4);
-
-  fc.function = &function;
-  fc.arguments = &arguments;
+  err = interpret_reserve(in, 1, 1);
+  if (err != E_INTERPRET_OK) {
+    return err;
+  }
+  *in->sp++ = callee;
+  in->work[in->nwork++] = (work){WORK_CALL, 0, 0};
+
+  while (in->nwork > 0 && err == E_INTERPRET_OK) {
+    w = in->work[--in->nwork];
+    fr = in->nframes ? &in->frames[in->nframes - 1] : 0;
+
+    switch (w.type) {
+    case WORK_EVAL:
+      err = interpret_eval(in, fr, w.node);
+      break;
+    case WORK_OP:
+      v = *--in->sp;
+      in->sp[-1] = interpret_op(in, w.node, in->sp[-1], v);
+      break;
+    case WORK_BRANCH:
+      n = in->flat->nodes.elements[w.node];
+      v = *--in->sp;
+      in->work[in->nwork++] = (work){
+          WORK_EVAL, 0, in->flat->extras.elements[n.b + !value_truthy(v)]};
+      break;
+    case WORK_CALL:
+      err = interpret_call(in, w.count);
+      break;
+    case WORK_TAIL_CALL:
+      err = interpret_tail_call(in, w.count);
+      break;
+    case WORK_STATEMENT:
+      err = interpret_statement(in, fr, w.node);
+      break;
+    case WORK_POP:
+      in->sp--;
+      break;
+    case WORK_RETURN:
+      // Drop the slots and the callee itself.
+      v = in->sp[-1];
+      in->sp = fr->callee;
+      *in->sp++ = v;
+      in->nframes--;
+      break;
+    default:
+      err = E_INTERPRET_CRASH;
+    }
+  }
 
-  err = interpret_function_call(fc, ctx, &v);
   if (err != E_INTERPRET_OK) {
     return err;
   }
 
-  printf("%lf\n", v.value.number);
+  *result = *--in->sp;
   return E_INTERPRET_OK;
 }
 
-interpret_error interpret(ast program) {
-  vector_context ctx = {0};
-  declaration d = {0};
-  function_declaration main = {0};
-  uint64_t i = 0;
+interpret_error interpret(ast program, run_options options) {
+  flat_ast f = {0};
+  interpreter in = {0};
+  flat_function *fn = 0;
+  flat_node s = {0};
+  value result = 0;
+  uint32_t main_function = 0;
+  uint64_t i = 0, j = 0;
   interpret_error err = E_INTERPRET_OK;
-  bool found_main = false, matched = false;
 
-  for (i = 0; i < program.declarations.index; i++) {
-    d = program.declarations.elements[i];
+  if (flatten(&program, &f) != E_FLAT_OK) {
+    LOG_ERROR("interpret", "Failed to flatten program", 0);
+    err = E_INTERPRET_CRASH;
+    goto cleanup;
+  }
 
-    err = interpret_declaration(d, &ctx);
-    if (err != E_INTERPRET_OK) {
-      return err;
-    }
+  if (resolve(&f) != E_RESOLVE_OK) {
+    err = E_INTERPRET_RESOLVE;
+    goto cleanup;
+  }
 
-    matched = strncmp(d.declaration.function.name.elements, "main", 4) == 0;
-    if (d.type == DECLARATION_FUNCTION && matched) {
-      main = d.declaration.function;
-      found_main = true;
-    }
+  if (inline_calls(&f, options.inlining,
+                   options.inlining.report ? stderr : 0) != E_INLINE_OK) {
+    err = E_INTERPRET_CRASH;
+    goto cleanup;
   }
 
-  if (!found_main) {
+  main_function = resolve_main(&f);
+  if (main_function == UINT32_MAX) {
     LOG_ERROR("interpret", "Expected main function", 0);
-    return E_INTERPRET_NO_MAIN;
+    err = E_INTERPRET_NO_MAIN;
+    goto cleanup;
+  }
+
+  in.flat = &f;
+  in.stack_limit = options.stack_limit ? options.stack_limit
+                                       : INTERPRET_DEFAULT_STACK_LIMIT;
+  gc_init(&in.heap, options.gc, interpret_roots, &in);
+
+  in.functions = (closure *)calloc(f.functions.index + 1, sizeof(closure));
+  in.globals = (value *)calloc(f.globals.index + 1, sizeof(value));
+  in.calls = (uint8_t *)calloc(f.nodes.index + 1, sizeof(uint8_t));
+  if (in.functions == 0 || in.globals == 0 || in.calls == 0) {
+    err = E_INTERPRET_CRASH;
+    goto cleanup;
   }
 
-  return call_main(&ctx, &main);
+  for (i = 0; i < f.functions.index; i++) {
+    in.functions[i].header.type = OBJECT_CLOSURE;
+    in.functions[i].header.color = GC_BLACK;
+    in.functions[i].function = i;
+  }
+
+  for (i = 0; i < f.globals.index; i++) {
+    in.globals[i] = FUNCTION_VALUE(&in.functions[f.globals.elements[i]]);
+  }
+
+  for (i = 0; i < f.functions.index; i++) {
+    fn = &f.functions.elements[i];
+    for (j = 0; j < fn->nstatements; j++) {
+      s = f.nodes.elements[f.extras.elements[fn->body + j]];
+      if (s.type == FLAT_RETURN || s.type == FLAT_EXPRESSION) {
+        interpret_find_calls(&in, s.a);
+      }
+    }
+  }
+
+  err = interpret_run(&in, FUNCTION_VALUE(&in.functions[main_function]),
+                      &result);
+  if (err == E_INTERPRET_STACK_OVERFLOW) {
+    fprintf(stderr, "RangeError: Maximum call stack size exceeded\n");
+  }
+  if (err != E_INTERPRET_OK) {
+    goto cleanup;
+  }
+
+  value_fprint(result, options.out ? options.out : stdout);
+
+cleanup:
+  if (options.gc.stats) {
+    gc_print_stats(&in.heap, stderr);
+  }
+  if (options.quicken_stats) {
+    quicken_print_stats(&in.quicken, stderr);
+  }
+  gc_free(&in.heap);
+  free(in.globals);
+  free(in.functions);
+  free(in.calls);
+  free(in.stack);
+  free(in.work);
+  free(in.frames);
+  flat_ast_free(&f);
+  return err;
 }
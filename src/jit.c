@@ -0,0 +1,782 @@
+#include "slowjs/jit.h"
+
+#include <sys/mman.h>
+
+// Code is generated for x86-64 and the System V calling convention,
+// compiled functions take their parameters in xmm0 up and return in
+// xmm0. Position i of a function's operand stack lives in xmmi and
+// xmm15 is scratch, so stacks deeper than that are not compiled.
+// Parameters and the positions live across a call are kept in the
+// frame below rbp.
+
+#define READ_OPERAND(x)                                                        \
+  do {                                                                         \
+    memcpy(&(x), ip, BC_OPERAND_SIZE);                                         \
+    ip += BC_OPERAND_SIZE;                                                     \
+  } while (0)
+
+#define JIT_SCRATCH 15
+#define JIT_MAX_DEPTH JIT_SCRATCH
+
+// SSE opcodes after the 0x0f escape.
+#define SSE_MOVSD_LOAD 0x10
+#define SSE_MOVSD_STORE 0x11
+#define SSE_UCOMISD 0x2e
+#define SSE_XORPD 0x57
+#define SSE_ADDSD 0x58
+#define SSE_MULSD 0x59
+#define SSE_SUBSD 0x5c
+#define SSE_DIVSD 0x5e
+
+// What a position on the operand stack holds in compiled code.
+enum jit_kind { JIT_KIND_NUMBER, JIT_KIND_FUNCTION };
+typedef enum jit_kind jit_kind;
+
+// Membership of the functions being compiled together.
+enum jit_group { JIT_GROUP_NONE, JIT_GROUP_OK, JIT_GROUP_REJECTED };
+typedef enum jit_group jit_group;
+
+// A jump to bytecode not compiled yet, and what the stack looks like
+// when it gets there.
+struct jit_jump {
+  uint64_t at;
+  uint32_t target;
+  uint32_t depth;
+  uint8_t kinds[JIT_MAX_DEPTH];
+};
+typedef struct jit_jump jit_jump;
+
+DECLARE_VECTOR(jit_jump)
+
+// A call to a function that may not have an entry yet.
+struct jit_site {
+  uint64_t at;
+  uint32_t caller;
+  uint32_t callee;
+};
+typedef struct jit_site jit_site;
+
+DECLARE_VECTOR(jit_site)
+
+struct jit_compiler {
+  jit *j;
+  bytecode *bc;
+  uint8_t *code;
+  // Functions compiled along with the hot one, and a jit_group for
+  // every function.
+  vector_uint32_t group;
+  uint8_t *in_group;
+  vector_jit_site sites;
+  // Ran out of code space or memory.
+  bool failed;
+
+  // The function being compiled.
+  vector_jit_jump jumps;
+  uint32_t nparameters;
+  uint32_t nspills;
+  uint32_t depth;
+  uint8_t kinds[JIT_MAX_DEPTH];
+  uint32_t functions[JIT_MAX_DEPTH];
+};
+typedef struct jit_compiler jit_compiler;
+
+typedef int (*jit_enter_fn)(uint8_t *, const double *, double *);
+
+void jit_byte(jit_compiler *, uint8_t);
+void jit_bytes(jit_compiler *, const uint8_t *, uint64_t);
+void jit_word(jit_compiler *, uint32_t);
+void jit_quad(jit_compiler *, uint64_t);
+uint64_t jit_rel32(jit_compiler *);
+void jit_patch(jit *, uint64_t, uint64_t);
+void jit_mov_rax(jit_compiler *, uint64_t);
+void jit_sse(jit_compiler *, uint8_t, uint8_t, uint32_t, uint32_t);
+void jit_sse_frame(jit_compiler *, uint8_t, uint8_t, uint32_t, int32_t);
+int32_t jit_parameter(uint32_t);
+int32_t jit_spill(jit_compiler *, uint32_t);
+void jit_stubs(jit_compiler *);
+bool jit_push(jit_compiler *, jit_kind);
+bool jit_numbers(jit_compiler *, uint32_t);
+bool jit_jump_to(jit_compiler *, uint8_t, uint8_t, uint32_t);
+bool jit_arithmetic(jit_compiler *, uint8_t);
+bool jit_call_site(jit_compiler *, uint32_t, uint32_t, bool);
+bool jit_compile_function(jit_compiler *, uint32_t);
+void jit_compile(jit *, bytecode *, uint8_t *, uint32_t);
+
+void jit_byte(jit_compiler *c, uint8_t b) {
+  if (c->j->used >= JIT_CODE_SIZE) {
+    c->failed = true;
+    return;
+  }
+
+  c->j->code[c->j->used++] = b;
+}
+
+void jit_bytes(jit_compiler *c, const uint8_t *bytes, uint64_t n) {
+  uint64_t i = 0;
+
+  for (i = 0; i < n; i++) {
+    jit_byte(c, bytes[i]);
+  }
+}
+
+void jit_word(jit_compiler *c, uint32_t word) {
+  uint8_t bytes[sizeof(word)] = {0};
+
+  memcpy(bytes, &word, sizeof(word));
+  jit_bytes(c, bytes, sizeof(word));
+}
+
+void jit_quad(jit_compiler *c, uint64_t quad) {
+  uint8_t bytes[sizeof(quad)] = {0};
+
+  memcpy(bytes, &quad, sizeof(quad));
+  jit_bytes(c, bytes, sizeof(quad));
+}
+
+// Emits a rel32 to patch later and returns where it is.
+uint64_t jit_rel32(jit_compiler *c) {
+  uint64_t at = c->j->used;
+
+  jit_word(c, 0);
+  return at;
+}
+
+// Points the rel32 at offset at to target, unless the code ran out
+// before it.
+void jit_patch(jit *j, uint64_t at, uint64_t target) {
+  int32_t rel = (int32_t)(target - (at + sizeof(rel)));
+
+  if (at + sizeof(rel) > j->used) {
+    return;
+  }
+
+  memcpy(j->code + at, &rel, sizeof(rel));
+}
+
+// mov rax, imm64
+void jit_mov_rax(jit_compiler *c, uint64_t imm) {
+  jit_byte(c, 0x48);
+  jit_byte(c, 0xb8);
+  jit_quad(c, imm);
+}
+
+// op xmm<reg>, xmm<rm>, prefix picks the double variant.
+void jit_sse(jit_compiler *c, uint8_t prefix, uint8_t op, uint32_t reg,
+             uint32_t rm) {
+  jit_byte(c, prefix);
+  if (reg >= 8 || rm >= 8) {
+    jit_byte(c, 0x40 | (reg >= 8) << 2 | (rm >= 8));
+  }
+  jit_byte(c, 0x0f);
+  jit_byte(c, op);
+  jit_byte(c, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// op xmm<reg>, [rbp + disp]
+void jit_sse_frame(jit_compiler *c, uint8_t prefix, uint8_t op, uint32_t reg,
+                   int32_t disp) {
+  jit_byte(c, prefix);
+  if (reg >= 8) {
+    jit_byte(c, 0x44);
+  }
+  jit_byte(c, 0x0f);
+  jit_byte(c, op);
+  jit_byte(c, 0x85 | (reg & 7) << 3);
+  jit_word(c, (uint32_t)disp);
+}
+
+int32_t jit_parameter(uint32_t i) {
+  return -8 * (int32_t)(i + 1);
+}
+
+int32_t jit_spill(jit_compiler *c, uint32_t position) {
+  if (position + 1 > c->nspills) {
+    c->nspills = position + 1;
+  }
+
+  return -8 * (int32_t)(c->nparameters + position + 1);
+}
+
+// The stub the VM calls compiled code through, as a jit_enter_fn: it
+// loads the arguments, notes where the C stack was so running out of
+// it can come back here, and returns nonzero if it did.
+void jit_stubs(jit_compiler *c) {
+  jit *j = c->j;
+  static const uint8_t save[] = {
+      0x55,             // push rbp
+      0x48, 0x89, 0xe5, // mov rbp, rsp
+      0x53,             // push rbx
+      0x41, 0x54,       // push r12, keeps rsp 16-byte aligned
+      0x48, 0x89, 0xd3, // mov rbx, rdx
+  };
+  static const uint8_t limit[] = {
+      0x48, 0x89, 0x20,       // mov [rax], rsp
+      0x48, 0x8d, 0x8c, 0x24, // lea rcx, [rsp + disp32]
+  };
+  static const uint8_t store[] = {
+      0x48, 0x89, 0x08, // mov [rax], rcx
+  };
+  static const uint8_t done[] = {
+      0xff, 0xd7,             // call rdi
+      0xf2, 0x0f, 0x11, 0x03, // movsd [rbx], xmm0
+      0x31, 0xc0,             // xor eax, eax
+  };
+  static const uint8_t restore[] = {
+      0x41, 0x5c, // pop r12
+      0x5b,       // pop rbx
+      0x5d,       // pop rbp
+      0xc3,       // ret
+  };
+  static const uint8_t unwind[] = {
+      0x48, 0x8b, 0x20,             // mov rsp, [rax]
+      0xb8, 0x01, 0x00, 0x00, 0x00, // mov eax, 1
+      0xe9,                         // jmp rel32
+  };
+  uint64_t exit = 0;
+  uint32_t i = 0;
+
+  j->enter = j->used;
+  jit_bytes(c, save, sizeof(save));
+  jit_mov_rax(c, (uintptr_t)&j->saved_sp);
+  jit_bytes(c, limit, sizeof(limit));
+  jit_word(c, (uint32_t)-JIT_STACK_SIZE);
+  jit_mov_rax(c, (uintptr_t)&j->stack_limit);
+  jit_bytes(c, store, sizeof(store));
+
+  // movsd xmmi, [rsi + 8 * i]
+  for (i = 0; i < JIT_MAX_PARAMETERS; i++) {
+    jit_byte(c, 0xf2);
+    jit_byte(c, 0x0f);
+    jit_byte(c, SSE_MOVSD_LOAD);
+    jit_byte(c, 0x46 | i << 3);
+    jit_byte(c, 8 * i);
+  }
+
+  jit_bytes(c, done, sizeof(done));
+  exit = j->used;
+  jit_bytes(c, restore, sizeof(restore));
+
+  // Compiled code jumps here with whatever it had on the stack.
+  j->bail = j->used;
+  jit_mov_rax(c, (uintptr_t)&j->saved_sp);
+  jit_bytes(c, unwind, sizeof(unwind));
+  jit_patch(j, jit_rel32(c), exit);
+}
+
+bool jit_push(jit_compiler *c, jit_kind kind) {
+  if (c->depth == JIT_MAX_DEPTH) {
+    return false;
+  }
+
+  c->kinds[c->depth++] = kind;
+  return true;
+}
+
+// Whether the top n positions are all numbers.
+bool jit_numbers(jit_compiler *c, uint32_t n) {
+  uint32_t i = 0;
+
+  if (c->depth < n) {
+    return false;
+  }
+
+  for (i = c->depth - n; i < c->depth; i++) {
+    if (c->kinds[i] != JIT_KIND_NUMBER) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Emits a jump with the two opcode bytes op, the second 0 for a
+// one-byte opcode, to target in the bytecode.
+bool jit_jump_to(jit_compiler *c, uint8_t op, uint8_t op2, uint32_t target) {
+  jit_jump jump = {0};
+
+  jit_byte(c, op);
+  if (op2) {
+    jit_byte(c, op2);
+  }
+
+  jump.at = jit_rel32(c);
+  jump.target = target;
+  jump.depth = c->depth;
+  memcpy(jump.kinds, c->kinds, sizeof(jump.kinds));
+  if (vector_jit_jump_push(&c->jumps, jump) != E_VECTOR_OK) {
+    c->failed = true;
+  }
+
+  return true;
+}
+
+bool jit_arithmetic(jit_compiler *c, uint8_t op) {
+  if (!jit_numbers(c, 2)) {
+    return false;
+  }
+
+  jit_sse(c, 0xf2, op, c->depth - 2, c->depth - 1);
+  c->depth--;
+  return true;
+}
+
+// Calls from function to the function below argc arguments on the
+// stack, which have to be numbers and as many as it has parameters. A
+// tail call leaves this frame first and never comes back.
+bool jit_call_site(jit_compiler *c, uint32_t function, uint32_t argc,
+                   bool tail) {
+  jit_site site = {0};
+  uint32_t callee_at = 0, callee = 0, i = 0;
+
+  if (c->depth < argc + 1 || !jit_numbers(c, argc)) {
+    return false;
+  }
+
+  callee_at = c->depth - argc - 1;
+  callee = c->functions[callee_at];
+  if (c->kinds[callee_at] != JIT_KIND_FUNCTION ||
+      c->j->functions[callee].state == JIT_NEVER ||
+      c->bc->functions.elements[callee].nparameters != argc) {
+    return false;
+  }
+
+  if (c->j->functions[callee].state == JIT_COLD &&
+      c->in_group[callee] == JIT_GROUP_NONE) {
+    c->in_group[callee] = JIT_GROUP_OK;
+    if (vector_uint32_t_push(&c->group, callee) != E_VECTOR_OK) {
+      c->failed = true;
+    }
+  }
+
+  // Every xmm register belongs to the callee.
+  for (i = 0; !tail && i < callee_at; i++) {
+    if (c->kinds[i] == JIT_KIND_NUMBER) {
+      jit_sse_frame(c, 0xf2, SSE_MOVSD_STORE, i, jit_spill(c, i));
+    }
+  }
+
+  // Each argument moves to a lower register than it is in.
+  for (i = 0; i < argc; i++) {
+    if (callee_at + 1 + i != i) {
+      jit_sse(c, 0xf2, SSE_MOVSD_LOAD, i, callee_at + 1 + i);
+    }
+  }
+
+  if (tail) {
+    jit_bytes(c, (const uint8_t[]){0x48, 0x89, 0xec, 0x5d, 0xe9}, 5);
+  } else {
+    jit_byte(c, 0xe8);
+  }
+
+  site.at = jit_rel32(c);
+  site.caller = function;
+  site.callee = callee;
+  if (vector_jit_site_push(&c->sites, site) != E_VECTOR_OK) {
+    c->failed = true;
+  }
+
+  if (tail) {
+    c->depth = callee_at;
+    return true;
+  }
+
+  if (callee_at != 0) {
+    jit_sse(c, 0xf2, SSE_MOVSD_LOAD, callee_at, 0);
+  }
+  for (i = 0; i < callee_at; i++) {
+    if (c->kinds[i] == JIT_KIND_NUMBER) {
+      jit_sse_frame(c, 0xf2, SSE_MOVSD_LOAD, i, jit_spill(c, i));
+    }
+  }
+
+  c->kinds[callee_at] = JIT_KIND_NUMBER;
+  c->depth = callee_at + 1;
+  return true;
+}
+
+// Compiles function at the end of the code, or returns false if it does
+// something compiled code cannot. Calls are patched once every function
+// they may go to has been compiled.
+bool jit_compile_function(jit_compiler *c, uint32_t function) {
+  bc_function *fn = &c->bc->functions.elements[function];
+  uint8_t *ip = c->code + fn->code;
+  uint64_t frame_at = 0, i = 0;
+  uint32_t operand = 0, offset = 0, next = 0;
+  uint8_t op = 0;
+  double constant = 0;
+  bool reachable = true, ok = true;
+
+  // Locals past the parameters hold nested functions.
+  if (fn->nparameters > JIT_MAX_PARAMETERS || fn->nlocals != fn->nparameters) {
+    return false;
+  }
+
+  c->nparameters = fn->nparameters;
+  c->nspills = 0;
+  c->depth = 0;
+  c->jumps.index = 0;
+
+  // Give up and go back to the VM when out of stack. Tail calls come
+  // back here too.
+  jit_mov_rax(c, (uintptr_t)&c->j->stack_limit);
+  jit_bytes(c, (const uint8_t[]){0x48, 0x3b, 0x20, 0x0f, 0x82}, 5);
+  jit_patch(c->j, jit_rel32(c), c->j->bail);
+
+  // push rbp; mov rbp, rsp; sub rsp, imm32
+  jit_bytes(c, (const uint8_t[]){0x55, 0x48, 0x89, 0xe5, 0x48, 0x81, 0xec},
+            7);
+  frame_at = jit_rel32(c);
+  for (i = 0; i < c->nparameters; i++) {
+    jit_sse_frame(c, 0xf2, SSE_MOVSD_STORE, i, jit_parameter(i));
+  }
+
+  while (ok && !c->failed) {
+    // Code only jumped to takes the stack the jump had.
+    offset = ip - c->code;
+    next = UINT32_MAX;
+    for (i = 0; i < c->jumps.index; i++) {
+      if (c->jumps.elements[i].target != offset) {
+        if (c->jumps.elements[i].target < next) {
+          next = c->jumps.elements[i].target;
+        }
+        continue;
+      }
+
+      if (reachable && (c->depth != c->jumps.elements[i].depth ||
+                        memcmp(c->kinds, c->jumps.elements[i].kinds,
+                               c->depth) != 0)) {
+        return false;
+      }
+      c->depth = c->jumps.elements[i].depth;
+      memcpy(c->kinds, c->jumps.elements[i].kinds, sizeof(c->kinds));
+      reachable = true;
+      jit_patch(c->j, c->jumps.elements[i].at, c->j->used);
+      c->jumps.elements[i--] = c->jumps.elements[--c->jumps.index];
+    }
+
+    // Jumps only go forward, so once none are left neither is the
+    // function.
+    if (!reachable) {
+      if (next == UINT32_MAX) {
+        break;
+      }
+      ip = c->code + next;
+      continue;
+    }
+
+    op = *ip++;
+    switch (op) {
+    case BC_CONSTANT:
+      READ_OPERAND(operand);
+      constant = c->bc->constants.elements[operand];
+      ok = jit_push(c, JIT_KIND_NUMBER);
+      if (ok) {
+        // movq xmm, rax
+        jit_mov_rax(c, number_value(constant));
+        jit_byte(c, 0x66);
+        jit_byte(c, 0x48 | (c->depth - 1 >= 8) << 2);
+        jit_byte(c, 0x0f);
+        jit_byte(c, 0x6e);
+        jit_byte(c, 0xc0 | ((c->depth - 1) & 7) << 3);
+      }
+      break;
+    case BC_GET_LOCAL:
+      READ_OPERAND(operand);
+      ok = jit_push(c, JIT_KIND_NUMBER);
+      if (ok) {
+        jit_sse_frame(c, 0xf2, SSE_MOVSD_LOAD, c->depth - 1,
+                      jit_parameter(operand));
+      }
+      break;
+    case BC_FUNCTION:
+      READ_OPERAND(operand);
+      ok = jit_push(c, JIT_KIND_FUNCTION);
+      if (ok) {
+        c->functions[c->depth - 1] = operand;
+      }
+      break;
+    case BC_ADD:
+    case BC_ADD_NUMBER:
+      ok = jit_arithmetic(c, SSE_ADDSD);
+      break;
+    case BC_SUB:
+    case BC_SUB_NUMBER:
+      ok = jit_arithmetic(c, SSE_SUBSD);
+      break;
+    case BC_MUL:
+    case BC_MUL_NUMBER:
+      ok = jit_arithmetic(c, SSE_MULSD);
+      break;
+    case BC_DIV:
+    case BC_DIV_NUMBER:
+      ok = jit_arithmetic(c, SSE_DIVSD);
+      break;
+    case BC_LESS:
+    case BC_LESS_NUMBER:
+    case BC_GREATER:
+    case BC_GREATER_NUMBER:
+      // Booleans are never materialized, a comparison has to be the
+      // test of a conditional. a < b is b > a, and jbe is taken when
+      // that is false or either is NaN.
+      if (!jit_numbers(c, 2) || *ip != BC_JUMP_IF_FALSE) {
+        ok = false;
+        break;
+      }
+      ip++;
+      READ_OPERAND(operand);
+      if (op == BC_LESS || op == BC_LESS_NUMBER) {
+        jit_sse(c, 0x66, SSE_UCOMISD, c->depth - 1, c->depth - 2);
+      } else {
+        jit_sse(c, 0x66, SSE_UCOMISD, c->depth - 2, c->depth - 1);
+      }
+      c->depth -= 2;
+      ok = jit_jump_to(c, 0x0f, 0x86, operand);
+      break;
+    case BC_JUMP_IF_FALSE:
+      // Zero and NaN compare equal to zero.
+      READ_OPERAND(operand);
+      ok = jit_numbers(c, 1);
+      if (ok) {
+        jit_sse(c, 0x66, SSE_XORPD, JIT_SCRATCH, JIT_SCRATCH);
+        jit_sse(c, 0x66, SSE_UCOMISD, c->depth - 1, JIT_SCRATCH);
+        c->depth--;
+        ok = jit_jump_to(c, 0x0f, 0x84, operand);
+      }
+      break;
+    case BC_JUMP:
+      READ_OPERAND(operand);
+      ok = jit_jump_to(c, 0xe9, 0, operand);
+      reachable = false;
+      break;
+    case BC_CALL:
+    case BC_TAIL_CALL:
+      READ_OPERAND(operand);
+      ok = jit_call_site(c, function, operand, op == BC_TAIL_CALL);
+      reachable = op == BC_CALL;
+      break;
+    case BC_RETURN:
+      ok = jit_numbers(c, 1);
+      if (ok) {
+        if (c->depth != 1) {
+          jit_sse(c, 0xf2, SSE_MOVSD_LOAD, 0, c->depth - 1);
+        }
+        // mov rsp, rbp; pop rbp; ret
+        jit_bytes(c, (const uint8_t[]){0x48, 0x89, 0xec, 0x5d, 0xc3}, 5);
+      }
+      reachable = false;
+      break;
+    case BC_POP:
+      c->depth--;
+      break;
+    default:
+      ok = false;
+    }
+  }
+
+  if (!ok || c->failed) {
+    return false;
+  }
+
+  // Parameters and spills, keeping rsp 16-byte aligned for calls.
+  operand = 8 * (c->nparameters + c->nspills);
+  operand = (operand + 15) & ~15u;
+  memcpy(c->j->code + frame_at, &operand, sizeof(operand));
+  return true;
+}
+
+// Compiles function and every function it calls that has not been
+// compiled yet, so calls between them go straight from one to the
+// other. Any that cannot be compiled are never tried again, and
+// neither is anything that calls them.
+void jit_compile(jit *j, bytecode *bc, uint8_t *code, uint32_t function) {
+  jit_compiler c = {0};
+  jit_site site = {0};
+  uint64_t i = 0, start = 0, nsites = 0;
+  uint32_t f = 0;
+  bool changed = false;
+
+  c.j = j;
+  c.bc = bc;
+  c.code = code;
+  c.in_group = (uint8_t *)calloc(j->nfunctions + 1, sizeof(uint8_t));
+  if (c.in_group == 0 ||
+      vector_uint32_t_push(&c.group, function) != E_VECTOR_OK ||
+      mprotect(j->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+    j->functions[function].state = JIT_NEVER;
+    goto cleanup;
+  }
+  c.in_group[function] = JIT_GROUP_OK;
+
+  // Calls append to group as they find functions.
+  for (i = 0; i < c.group.index; i++) {
+    f = c.group.elements[i];
+    start = j->used;
+    nsites = c.sites.index;
+
+    if (jit_compile_function(&c, f) && !c.failed) {
+      j->functions[f].entry = start;
+    } else {
+      c.in_group[f] = JIT_GROUP_REJECTED;
+      j->used = start;
+      c.sites.index = nsites;
+    }
+    c.failed = false;
+  }
+
+  // Calls to a function that was rejected reject the caller, which may
+  // reject the functions calling it in turn.
+  do {
+    changed = false;
+    for (i = 0; i < c.sites.index; i++) {
+      site = c.sites.elements[i];
+      if (c.in_group[site.caller] != JIT_GROUP_OK ||
+          j->functions[site.callee].state == JIT_NATIVE ||
+          c.in_group[site.callee] == JIT_GROUP_OK) {
+        continue;
+      }
+
+      c.in_group[site.caller] = JIT_GROUP_REJECTED;
+      changed = true;
+    }
+  } while (changed);
+
+  for (i = 0; i < c.sites.index; i++) {
+    site = c.sites.elements[i];
+    if (c.in_group[site.caller] == JIT_GROUP_OK) {
+      jit_patch(j, site.at, j->functions[site.callee].entry);
+    }
+  }
+
+  for (i = 0; i < c.group.index; i++) {
+    f = c.group.elements[i];
+    if (c.in_group[f] == JIT_GROUP_OK) {
+      j->functions[f].state = JIT_NATIVE;
+      j->stats.compiled++;
+    } else {
+      j->functions[f].state = JIT_NEVER;
+      j->stats.rejected++;
+    }
+  }
+
+  // Without it nothing compiled can run.
+  if (mprotect(j->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+    for (i = 0; i < j->nfunctions; i++) {
+      j->functions[i].state = JIT_NEVER;
+    }
+  }
+
+cleanup:
+  free(c.in_group);
+  vector_uint32_t_free(&c.group);
+  vector_jit_site_free(&c.sites);
+  vector_jit_jump_free(&c.jumps);
+}
+
+jit_error jit_prepare(jit *j, jit_options options, uint64_t nfunctions) {
+  jit_compiler c = {0};
+  void *code = 0;
+
+#ifndef __x86_64__
+  return E_JIT_UNSUPPORTED;
+#endif
+
+  j->options = options;
+  if (j->code == 0) {
+    code = mmap(0, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+      return E_JIT_MALLOC;
+    }
+    j->code = (uint8_t *)code;
+  } else if (mprotect(j->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+    return E_JIT_MALLOC;
+  }
+
+  // Code from a previous program is dropped.
+  c.j = j;
+  j->used = 0;
+  jit_stubs(&c);
+  if (mprotect(j->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+    return E_JIT_MALLOC;
+  }
+
+  free(j->functions);
+  j->nfunctions = nfunctions;
+  j->functions = (jit_function *)calloc(nfunctions + 1, sizeof(jit_function));
+  if (j->functions == 0) {
+    j->nfunctions = 0;
+    return E_JIT_MALLOC;
+  }
+
+  return E_JIT_OK;
+}
+
+bool jit_call(jit *j, bytecode *bc, uint8_t *code, uint32_t function,
+              value *args, uint32_t argc, value *result) {
+  jit_function *jf = &j->functions[function];
+  double numbers[JIT_MAX_PARAMETERS] = {0};
+  double out = 0;
+  uint32_t i = 0, nparameters = 0;
+
+  if (jf->state == JIT_NEVER) {
+    return false;
+  }
+
+  if (jf->state == JIT_COLD) {
+    if (jf->calls < j->options.threshold) {
+      jf->calls++;
+      return false;
+    }
+
+    jit_compile(j, bc, code, function);
+    if (jf->state != JIT_NATIVE) {
+      return false;
+    }
+  }
+
+  // Missing arguments would be null, extra ones are dropped.
+  nparameters = bc->functions.elements[function].nparameters;
+  if (argc < nparameters) {
+    return false;
+  }
+  for (i = 0; i < nparameters; i++) {
+    if (!IS_NUMBER(args[i])) {
+      return false;
+    }
+    numbers[i] = value_number(args[i]);
+  }
+
+  j->stats.native_calls++;
+  if (((jit_enter_fn)(j->code + j->enter))(j->code + jf->entry, numbers,
+                                            &out) != 0) {
+    // Compiled code has no effects, so the VM can run the call from the
+    // start. It will not be entered here again.
+    j->stats.bails++;
+    jf->state = JIT_NEVER;
+    return false;
+  }
+
+  *result = number_value(out);
+  return true;
+}
+
+void jit_print_stats(jit *j, FILE *out) {
+  jit_stats *s = &j->stats;
+
+  fprintf(out,
+          "jit: %llu functions compiled, %llu rejected\n"
+          "jit: %llu calls ran compiled, %llu ran out of stack\n",
+          (unsigned long long)s->compiled, (unsigned long long)s->rejected,
+          (unsigned long long)s->native_calls, (unsigned long long)s->bails);
+}
+
+void jit_free(jit *j) {
+  if (j->code) {
+    munmap(j->code, JIT_CODE_SIZE);
+  }
+  free(j->functions);
+  j->code = 0;
+  j->used = 0;
+  j->functions = 0;
+  j->nfunctions = 0;
+}
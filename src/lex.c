@@ -7,59 +7,117 @@
 #define LEX_ERROR(msg, t)                                                      \
   fprintf(stderr, "%s near %llu:%llu\n", msg, t.line, t.col)
 
-vector_error vector_token_push_char(vector_token *, uint64_t, uint64_t, char);
-lex_error reverse_tokens_and_null_terminate(vector_token *);
-
-vector_error vector_token_push_char(vector_token *v, uint64_t line,
-                                    uint64_t col, char c) {
-  token t = {0};
-  vector_error err = E_VECTOR_OK;
-
-  t.col = col;
-  t.line = line;
-
-  err = vector_char_copy(&t.string, &c, 1);
-  if (err != E_VECTOR_OK) {
-    return err;
+token_type lex_punctuator(char);
+token_type lex_word(const char *, uint64_t);
+
+struct keyword {
+  const char *keyword;
+  uint64_t length;
+  token_type type;
+};
+typedef struct keyword keyword;
+
+// Perfect hash over the keyword set, see KEYWORD_HASH. Empty slots have
+// a null keyword.
+static const keyword keywords[16] = {
+    [2] = {"return", 6, TOKEN_RETURN},
+    [4] = {"const", 5, TOKEN_CONST},
+    [6] = {"null", 4, TOKEN_NULL},
+    [7] = {"true", 4, TOKEN_TRUE},
+    [8] = {"function", 8, TOKEN_FUNCTION},
+    [10] = {"false", 5, TOKEN_FALSE},
+    [11] = {"let", 3, TOKEN_LET},
+    [15] = {"var", 3, TOKEN_VAR},
+};
+
+#define KEYWORD_HASH(s, len)                                                   \
+  (((len) + (unsigned char)(s)[0] + 3 * (unsigned char)(s)[(len)-1]) & 15)
+
+token_type lex_keyword(const char *s, uint64_t len) {
+  const keyword *k = &keywords[KEYWORD_HASH(s, len)];
+
+  if (k->length == len && memcmp(k->keyword, s, len) == 0) {
+    return k->type;
   }
 
-  return vector_token_push(v, t);
+  return TOKEN_IDENTIFIER;
 }
 
-lex_error reverse_tokens_and_null_terminate(vector_token *tokens_out) {
-  vector_token copy = {0};
+token_type lex_word(const char *s, uint64_t len) {
   uint64_t i = 0;
-  lex_error err = E_LEX_OK;
+  char c = 0;
 
-  err = (lex_error)vector_token_copy(&copy, tokens_out->elements,
-                                     tokens_out->index);
-  if (err != E_VECTOR_OK) {
-    LEX_ERROR("Error copying for reversal", tokens_out->elements[0]);
-    return err;
+  if (s[0] >= '0' && s[0] <= '9') {
+    return TOKEN_NUMBER;
   }
 
-  for (i = 0; i < copy.index; i++) {
-    // Null-terminate all tokens
-    err = (lex_error)vector_char_push(&copy.elements[i].string, 0);
-    if (err != E_VECTOR_OK) {
-      LEX_ERROR("Error null-terminating tokens", copy.elements[i]);
-      break;
+  for (i = 0; i < len; i++) {
+    c = s[i];
+
+    // Can start with [$_a-Z]
+    if (c == '$' || c == '_' ||
+        ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+      continue;
+    }
+
+    if (i > 0 && c >= '0' && c <= '9') {
+      continue;
     }
 
-    // Reverse the tokens to form a stack.
-    memcpy(&tokens_out->elements[copy.index - i - 1], &copy.elements[i],
-           sizeof(token));
+    return TOKEN_INVALID;
   }
 
-  vector_token_free(&copy);
-  return err;
+  return lex_keyword(s, len);
+}
+
+token_type lex_punctuator(char c) {
+  switch (c) {
+  case '{':
+    return TOKEN_LBRACE;
+  case '}':
+    return TOKEN_RBRACE;
+  case '(':
+    return TOKEN_LPAREN;
+  case ')':
+    return TOKEN_RPAREN;
+  case '[':
+    return TOKEN_LBRACKET;
+  case ']':
+    return TOKEN_RBRACKET;
+  case ';':
+    return TOKEN_SEMICOLON;
+  case '+':
+    return TOKEN_PLUS;
+  case '-':
+    return TOKEN_MINUS;
+  case '/':
+    return TOKEN_SLASH;
+  case '*':
+    return TOKEN_STAR;
+  case '&':
+    return TOKEN_AMPERSAND;
+  case ',':
+    return TOKEN_COMMA;
+  case '.':
+    return TOKEN_DOT;
+  case ':':
+    return TOKEN_COLON;
+  case '<':
+    return TOKEN_LESS;
+  case '>':
+    return TOKEN_GREATER;
+  case '?':
+    return TOKEN_QUESTION;
+  default:
+    return TOKEN_INVALID;
+  }
 }
 
 lex_error lex(vector_char source, vector_token *tokens_out) {
   token current = {0};
   lex_error err = E_LEX_OK;
   char c = 0;
-  uint64_t i = 0;
+  uint64_t i = 0, line = 1, col = 0;
   bool in_comment = false;
 
   for (i = 0; i < source.index; i++) {
@@ -67,39 +125,22 @@ lex_error lex(vector_char source, vector_token *tokens_out) {
 
     if (c == '\n') {
       in_comment = false;
-      current.line++;
-      continue;
-    } else if (c == 0) {
+      line++;
+      col = 0;
+    } else if (c != 0) {
+      col++;
+    }
+
+    if (in_comment) {
       continue;
-    } else {
-      current.col++;
-      if (in_comment) {
-        continue;
-      }
     }
 
     // Handle line comments
     if (c == '/' && i + 1 < source.index && source.elements[i + 1] == '/') {
       in_comment = true;
-      continue;
     }
 
     switch (c) {
-    case ' ':
-    case '\r':
-    case '\t':
-      if (!current.string.index) {
-        continue;
-      }
-
-      err = (lex_error)vector_token_push(tokens_out, current);
-      if (err != E_VECTOR_OK) {
-        LEX_ERROR("Error lexing", current);
-        return err;
-      }
-
-      current.string = (vector_char){0};
-      break;
     case '{':
     case '}':
     case '(':
@@ -115,43 +156,65 @@ lex_error lex(vector_char source, vector_token *tokens_out) {
     case ',':
     case '.':
     case ':':
-      // TODO: support double character operators: +=, ++, &&, etc.
-      if (current.string.index) {
+    case '<':
+    case '>':
+    case '?':
+    case ' ':
+    case '\r':
+    case '\t':
+    case '\n':
+    case 0:
+      if (current.length) {
+        current.type =
+            lex_word(source.elements + current.offset, current.length);
         err = (lex_error)vector_token_push(tokens_out, current);
         if (err != E_VECTOR_OK) {
           LEX_ERROR("Error lexing", current);
+          return err;
         }
 
-        current.string = (vector_char){0};
+        current.length = 0;
+      }
+
+      if (in_comment || c == ' ' || c == '\r' || c == '\t' || c == '\n' ||
+          c == 0) {
+        continue;
       }
 
-      err = (lex_error)vector_token_push_char(tokens_out, current.line,
-                                              current.col, c);
+      // TODO: support double character operators: +=, ++, &&, etc.
+      current.line = line;
+      current.col = col;
+      current.offset = i;
+      current.length = 1;
+      current.type = lex_punctuator(c);
+      err = (lex_error)vector_token_push(tokens_out, current);
       if (err != E_VECTOR_OK) {
         LEX_ERROR("Error lexing", current);
         return err;
       }
 
-      current.string = (vector_char){0};
-
+      current.length = 0;
       break;
     default:
-      err = (lex_error)vector_char_push(&current.string, c);
-      if (err != E_VECTOR_OK) {
-        LEX_ERROR("Error lexing", current);
-        return err;
+      if (!current.length) {
+        current.line = line;
+        current.col = col;
+        current.offset = i;
       }
 
+      current.length++;
       break;
     }
   }
 
-  if (current.string.index) {
+  if (current.length) {
+    current.type = lex_word(source.elements + current.offset, current.length);
     err = (lex_error)vector_token_push(tokens_out, current);
     if (err != E_VECTOR_OK) {
       LEX_ERROR("Error lexing", current);
+      return err;
     }
   }
 
-  return reverse_tokens_and_null_terminate(tokens_out);
+  return E_LEX_OK;
 }
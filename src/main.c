@@ -1,17 +1,38 @@
 #include <execinfo.h>
+#include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "slowjs/batch.h"
+#include "slowjs/cache.h"
+#include "slowjs/emit.h"
 #include "slowjs/file.h"
+#include "slowjs/fold.h"
 #include "slowjs/interpret.h"
 #include "slowjs/lex.h"
+#include "slowjs/parallel.h"
 #include "slowjs/parse.h"
+#include "slowjs/server.h"
 #include "slowjs/vector.h"
+#include "slowjs/vm.h"
+
+// Calls --threads makes at each number of threads unless told otherwise.
+#define DEFAULT_REQUESTS 10000
 
 void generate_backtrace(int);
 void register_backtraces();
+void usage(const char *);
+int run_threads(vector_char *, run_options, uint32_t, uint64_t);
+char **read_manifest(FILE *, uint64_t *);
+int run_batch(char **, uint64_t, batch_options);
+void stop_server(int);
+int run_server(const char *, run_options);
+int run_cached(const char *, vector_char *, run_options);
+
+// The one --serve runs, for stop_server.
+server serving;
 
 // SOURCE: https://stackoverflow.com/a/77336/1507139
 void generate_backtrace(int sig) {
@@ -43,29 +64,462 @@ void register_backtraces() {
   }
 }
 
+void usage(const char *program) {
+  printf("Usage: %s [--vm] [--gc-stats] [--gc-max-pause-us=N] "
+         "[--quicken-stats]\n"
+         "       [--dump-ast] [--inline-max-size=N] [--inline-report]\n"
+         "       [--stack-limit-mb=N] [--jit] [--jit-threshold=N] "
+         "[--jit-stats]\n"
+         "       [--emit-c] [--threads=N] [--requests=M] [--jobs=N] "
+         "[--manifest]\n"
+         "       [--serve=socket] [--cache-dir=dir] file.js...\n\n"
+         "  --vm                 Compile to bytecode and run that instead of "
+         "walking\n"
+         "                       the AST\n"
+         "  --gc-stats           Report collections, pause times and bytes "
+         "reclaimed\n"
+         "                       on exit\n"
+         "  --gc-max-pause-us=N  Collect incrementally, pausing for about N "
+         "microseconds\n"
+         "                       at a time\n"
+         "  --quicken-stats      Report how often arithmetic specialized for "
+         "numbers\n"
+         "                       hit on exit\n"
+         "  --dump-ast           Print the program before and after constant "
+         "folding\n"
+         "  --inline-max-size=N  Inline calls to functions returning at most N "
+         "nodes,\n"
+         "                       0 turns inlining off (default %d)\n"
+         "  --inline-report      Print every call site considered for "
+         "inlining\n"
+         "  --stack-limit-mb=N   Let the tree walker recurse until its stacks "
+         "take N MiB\n"
+         "                       (default %llu)\n"
+         "  --jit                With --vm, compile hot numeric functions to "
+         "x86-64\n"
+         "                       machine code\n"
+         "  --jit-threshold=N    Compile functions once they have been called "
+         "N times\n"
+         "                       (default %d)\n"
+         "  --jit-stats          Report how many functions were compiled on "
+         "exit\n"
+         "  --emit-c             Print the program as a standalone C file "
+         "instead of\n"
+         "                       running it\n"
+         "  --threads=N          Call main from 1 thread up to N at once, "
+         "reporting\n"
+         "                       calls per second\n"
+         "  --requests=M         Calls to make at each number of threads "
+         "(default %d)\n"
+         "  --jobs=N             Run several files on N threads, one per "
+         "processor by\n"
+         "                       default\n"
+         "  --manifest           Read the files to run from stdin, one per "
+         "line\n"
+         "  --serve=socket       Answer calls to scripts over a Unix socket "
+         "instead,\n"
+         "                       see server.h\n"
+         "  --cache-dir=dir      Run with the VM from a compiled image kept in "
+         "dir,\n"
+         "                       making one the first time. It only runs "
+         "the\n"
+         "                       program, so not with --dump-ast, --emit-c "
+         "or\n"
+         "                       --inline-report\n",
+         program, INLINE_DEFAULT_MAX_SIZE,
+         (unsigned long long)(INTERPRET_DEFAULT_STACK_LIMIT >> 20),
+         JIT_DEFAULT_THRESHOLD, DEFAULT_REQUESTS);
+}
+
+// Paths in stream, one per line with empty lines skipped.
+char **read_manifest(FILE *stream, uint64_t *npaths) {
+  char **paths = 0, **grown = 0, *line = 0;
+  size_t size = 0;
+  ssize_t length = 0;
+  uint64_t capacity = 0;
+
+  *npaths = 0;
+  while ((length = getline(&line, &size, stream)) >= 0) {
+    if (length > 0 && line[length - 1] == '\n') {
+      line[--length] = 0;
+    }
+    if (length == 0) {
+      continue;
+    }
+
+    if (*npaths == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      grown = (char **)realloc(paths, sizeof(char *) * capacity);
+      if (grown == 0) {
+        break;
+      }
+      paths = grown;
+    }
+
+    paths[(*npaths)++] = line;
+    line = 0;
+    size = 0;
+  }
+
+  free(line);
+  return paths;
+}
+
+int run_batch(char **paths, uint64_t npaths, batch_options options) {
+  batch_stats stats = {0};
+  int err = 0;
+
+  err = batch_run(paths, npaths, options, stdout, &stats);
+  if (err != E_BATCH_OK) {
+    return err;
+  }
+
+  fflush(stdout);
+  batch_print_stats(&stats, stderr);
+  return stats.failed > 0;
+}
+
+void stop_server(int sig) {
+  (void)sig;
+  server_stop(&serving);
+}
+
+// Runs until interrupted, then reports what it served.
+int run_server(const char *path, run_options options) {
+  server_options serve = {0};
+  struct sigaction action = {0};
+  int err = 0;
+
+  serve.run = options;
+  err = server_init(&serving, path, serve);
+  if (err != E_SERVER_OK) {
+    fprintf(stderr, "Error listening on %s.\n", path);
+    goto cleanup;
+  }
+
+  action.sa_handler = stop_server;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  fprintf(stderr, "Listening on %s\n", path);
+  err = server_run(&serving);
+  server_print_stats(&serving.stats, stderr);
+
+cleanup:
+  server_free(&serving);
+  return err;
+}
+
+// Runs main from the image of source in dir, compiling the source and
+// storing its image first if there is none that matches.
+int run_cached(const char *dir, vector_char *source, run_options options) {
+  cache_image image = {0};
+  ast program = {0};
+  flat_ast f = {0};
+  bytecode bc = {0};
+  int err = 0;
+
+  if (cache_load(dir, source, options, &image) == E_CACHE_OK) {
+    err = vm_run_main(&image.bc, options);
+    cache_image_free(&image);
+    goto cleanup;
+  }
+
+  err = parse(*source, &program);
+  if (err != E_PARSE_OK) {
+    printf("Error parsing program.\n");
+    return err;
+  }
+  fold(&program);
+
+  err = vm_compile(program, options, &f, &bc);
+  if (err == E_VM_OK) {
+    // The program can still run without its image.
+    if (cache_store(dir, source, options, &bc) != E_CACHE_OK) {
+      fprintf(stderr, "Error writing to cache %s.\n", dir);
+    }
+    err = vm_run_main(&bc, options);
+  }
+
+  bytecode_free(&bc);
+  flat_ast_free(&f);
+  ast_free(&program);
+
+cleanup:
+  if (err != E_VM_OK) {
+    printf("Error interpreting program.\n");
+  }
+  return err;
+}
+
+// Compiles the program once and calls main requests times from 1, 2,
+// 4 and so on up to threads threads, each with a VM of its own.
+int run_threads(vector_char *source, run_options options, uint32_t threads,
+                uint64_t requests) {
+  slowjs_script *s = 0;
+  parallel_stats stats = {0};
+  value result = 0;
+  double base = 0;
+  uint32_t n = 1;
+  int err = 0;
+
+  err = vector_char_push(source, 0);
+  if (err != E_VECTOR_OK) {
+    return err;
+  }
+
+  err = slowjs_compile(source->elements, options, &s);
+  if (err != E_SLOWJS_OK) {
+    return err;
+  }
+
+  err = slowjs_call(s, "main", 0, 0, &result);
+  if (err != E_SLOWJS_OK) {
+    goto cleanup;
+  }
+  value_print(result);
+
+  printf("%8s %12s %14s %8s\n", "threads", "calls", "calls/sec", "speedup");
+  for (;;) {
+    err = parallel_calls(s, "main", n, requests, &stats);
+    if (err != E_PARALLEL_OK) {
+      goto cleanup;
+    }
+
+    if (n == 1) {
+      base = stats.calls / stats.seconds;
+    }
+    printf("%8u %12llu %14.0f %7.2fx\n", n, (unsigned long long)stats.calls,
+           stats.calls / stats.seconds, stats.calls / stats.seconds / base);
+
+    if (n == threads) {
+      break;
+    }
+    n = n * 2 < threads ? n * 2 : threads;
+  }
+
+cleanup:
+  slowjs_free(s);
+  return err;
+}
+
 int main(int argc, char **argv) {
+  static struct option options[] = {
+      {"vm", no_argument, 0, 'v'},
+      {"gc-stats", no_argument, 0, 's'},
+      {"gc-max-pause-us", required_argument, 0, 'p'},
+      {"quicken-stats", no_argument, 0, 'q'},
+      {"dump-ast", no_argument, 0, 'd'},
+      {"inline-max-size", required_argument, 0, 'i'},
+      {"inline-report", no_argument, 0, 'r'},
+      {"stack-limit-mb", required_argument, 0, 'l'},
+      {"jit", no_argument, 0, 'j'},
+      {"jit-threshold", required_argument, 0, 't'},
+      {"jit-stats", no_argument, 0, 'J'},
+      {"emit-c", no_argument, 0, 'c'},
+      {"threads", required_argument, 0, 'n'},
+      {"requests", required_argument, 0, 'm'},
+      {"jobs", required_argument, 0, 'w'},
+      {"manifest", no_argument, 0, 'M'},
+      {"serve", required_argument, 0, 'S'},
+      {"cache-dir", required_argument, 0, 'C'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0},
+  };
   ast program = {0};
   vector_char source = {0};
-  int err = 0;
+  run_options run = {0};
+  batch_options batch = {0};
+  char **manifest = 0, *serve = 0, *cache_dir = 0;
+  uint64_t nmanifest = 0;
+  char *end = 0;
+  uint64_t folded = 0, requests = DEFAULT_REQUESTS;
+  uint32_t threads = 0;
+  bool use_vm = false, dump_ast = false, emit = false, from_stdin = false;
+  int err = 0, option = 0;
 
   register_backtraces();
 
-  if (argc != 2) {
+  run.inlining.max_size = INLINE_DEFAULT_MAX_SIZE;
+  run.jit.threshold = JIT_DEFAULT_THRESHOLD;
+
+  while ((option = getopt_long(argc, argv, "h", options, 0)) != -1) {
+    switch (option) {
+    case 'v':
+      use_vm = true;
+      break;
+    case 's':
+      run.gc.stats = 1;
+      break;
+    case 'p':
+      run.gc.max_pause_us = strtoull(optarg, &end, 10);
+      if (*optarg == 0 || *end != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'q':
+      run.quicken_stats = 1;
+      break;
+    case 'd':
+      dump_ast = true;
+      break;
+    case 'i':
+      run.inlining.max_size = strtoul(optarg, &end, 10);
+      if (*optarg == 0 || *end != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'r':
+      run.inlining.report = 1;
+      break;
+    case 'l':
+      run.stack_limit = strtoull(optarg, &end, 10) << 20;
+      if (*optarg == 0 || *end != 0 || run.stack_limit == 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'j':
+      run.jit.enabled = 1;
+      break;
+    case 't':
+      run.jit.threshold = strtoul(optarg, &end, 10);
+      if (*optarg == 0 || *end != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'J':
+      run.jit.stats = 1;
+      break;
+    case 'c':
+      emit = true;
+      break;
+    case 'n':
+      threads = strtoul(optarg, &end, 10);
+      if (*optarg == 0 || *end != 0 || threads == 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'm':
+      requests = strtoull(optarg, &end, 10);
+      if (*optarg == 0 || *end != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'w':
+      batch.threads = strtoul(optarg, &end, 10);
+      if (*optarg == 0 || *end != 0 || batch.threads == 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'M':
+      from_stdin = true;
+      break;
+    case 'S':
+      serve = optarg;
+      break;
+    case 'C':
+      cache_dir = optarg;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // An image has no AST to print or report on.
+  if (cache_dir && (dump_ast || emit || run.inlining.report)) {
+    printf("--cache-dir cannot be used with --dump-ast, --emit-c or "
+           "--inline-report.\n");
+    return 1;
+  }
+
+  if (serve) {
+    return run_server(serve, run);
+  }
+
+  // More than one file runs as a batch.
+  if (from_stdin || argc - optind > 1) {
+    batch.run = run;
+    batch.vm = use_vm;
+    if (batch.threads == 0) {
+      batch.threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    if (!from_stdin) {
+      return run_batch(argv + optind, argc - optind, batch);
+    }
+
+    manifest = read_manifest(stdin, &nmanifest);
+    err = run_batch(manifest, nmanifest, batch);
+    for (; nmanifest > 0; nmanifest--) {
+      free(manifest[nmanifest - 1]);
+    }
+    free(manifest);
+    return err;
+  }
+
+  if (optind != argc - 1) {
     printf("Expected a JavaScript file argument, got nothing.");
     return 1;
   }
 
-  err = read_file(argv[1], &source);
+  err = read_file(argv[optind], &source);
   if (err != E_FILE_OK) {
     goto cleanup_file;
   }
 
+  if (threads > 0) {
+    err = run_threads(&source, run, threads, requests);
+    if (err != E_SLOWJS_OK) {
+      printf("Error running program.\n");
+    }
+    goto cleanup_parse;
+  }
+
+  if (cache_dir) {
+    err = run_cached(cache_dir, &source, run);
+    goto cleanup_parse;
+  }
+
   err = parse(source, &program);
   if (err != E_PARSE_OK) {
     goto cleanup_parse;
   }
 
-  err = interpret(program);
+  if (dump_ast) {
+    fprintf(stderr, "// Parsed\n");
+    ast_print(&program, stderr);
+  }
+
+  folded = fold(&program);
+  if (dump_ast) {
+    fprintf(stderr, "// Folded %llu expressions\n", (unsigned long long)folded);
+    ast_print(&program, stderr);
+  }
+
+  if (emit) {
+    err = emit_c(program, run, stdout);
+    if (err != E_EMIT_OK) {
+      fprintf(stderr, "Error emitting program.\n");
+    }
+    goto cleanup_interpret;
+  }
+
+  if (use_vm) {
+    err = vm_interpret(program, run);
+  } else {
+    err = interpret(program, run);
+  }
   if (err != E_INTERPRET_OK) {
     printf("Error interpreting program.\n");
     goto cleanup_interpret;
@@ -0,0 +1,139 @@
+#include "slowjs/parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "slowjs/common.h"
+
+struct parallel;
+
+struct parallel_worker {
+  struct parallel *p;
+  slowjs_script *script;
+  pthread_t thread;
+  uint64_t calls;
+  slowjs_error error;
+};
+typedef struct parallel_worker parallel_worker;
+
+struct parallel {
+  const char *name;
+  uint64_t calls;
+  // Next call to be claimed, changed atomically.
+  uint64_t next;
+  // Workers wait for go so that starting threads is not timed.
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  bool go;
+};
+typedef struct parallel parallel;
+
+double parallel_now();
+void *parallel_work(void *);
+
+double parallel_now() {
+  struct timespec ts = {0};
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *parallel_work(void *data) {
+  parallel_worker *w = (parallel_worker *)data;
+  parallel *p = w->p;
+  value result = 0;
+  uint64_t start = 0, end = 0, i = 0;
+
+  pthread_mutex_lock(&p->lock);
+  while (!p->go) {
+    pthread_cond_wait(&p->start, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+
+  for (;;) {
+    start = __atomic_fetch_add(&p->next, PARALLEL_BATCH, __ATOMIC_RELAXED);
+    if (start >= p->calls) {
+      return 0;
+    }
+
+    end = start + PARALLEL_BATCH < p->calls ? start + PARALLEL_BATCH
+                                            : p->calls;
+    for (i = start; i < end; i++) {
+      w->error = slowjs_call(w->script, p->name, 0, 0, &result);
+      if (w->error != E_SLOWJS_OK) {
+        return 0;
+      }
+      w->calls++;
+    }
+  }
+}
+
+parallel_error parallel_calls(slowjs_script *s, const char *name,
+                              uint32_t threads, uint64_t calls,
+                              parallel_stats *stats) {
+  parallel p = {0};
+  parallel_worker *workers = 0;
+  uint32_t i = 0, started = 0;
+  double start = 0;
+  parallel_error err = E_PARALLEL_OK;
+
+  *stats = (parallel_stats){0};
+  p.name = name;
+  p.calls = calls;
+
+  workers = (parallel_worker *)calloc(threads, sizeof(parallel_worker));
+  if (workers == 0) {
+    return E_PARALLEL_MALLOC;
+  }
+
+  for (i = 0; i < threads; i++) {
+    workers[i].p = &p;
+    if (slowjs_clone(s, &workers[i].script) != E_SLOWJS_OK) {
+      err = E_PARALLEL_MALLOC;
+      goto cleanup;
+    }
+  }
+
+  pthread_mutex_init(&p.lock, 0);
+  pthread_cond_init(&p.start, 0);
+  for (started = 0; started < threads; started++) {
+    if (pthread_create(&workers[started].thread, 0, parallel_work,
+                       &workers[started]) != 0) {
+      // The ones that did start are let go with nothing to do.
+      err = E_PARALLEL_THREAD;
+      p.calls = 0;
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&p.lock);
+  p.go = true;
+  pthread_cond_broadcast(&p.start);
+  pthread_mutex_unlock(&p.lock);
+
+  start = parallel_now();
+  for (i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, 0);
+  }
+  stats->seconds = parallel_now() - start;
+  pthread_cond_destroy(&p.start);
+  pthread_mutex_destroy(&p.lock);
+
+  for (i = 0; i < threads; i++) {
+    stats->calls += workers[i].calls;
+    if (stats->error == E_SLOWJS_OK) {
+      stats->error = workers[i].error;
+    }
+  }
+  if (err == E_PARALLEL_OK && stats->error != E_SLOWJS_OK) {
+    err = E_PARALLEL_CALL;
+  }
+
+cleanup:
+  for (i = 0; i < threads; i++) {
+    slowjs_free(workers[i].script);
+  }
+  free(workers);
+  return err;
+}
@@ -4,405 +4,452 @@
 #include <stdio.h>
 #include <string.h>
 
-#define PARSE_ERROR(msg, t)                                                    \
-  fprintf(stderr, "%s near \"%s\" at %llu:%llu.\n", msg, t.string.elements,    \
-          t.line, t.col - t.string.index)
-
-#define PUSH(tokens, t, err)                                                   \
-  err = vector_token_push(tokens, t);                                          \
-  if (err != E_VECTOR_OK) {                                                    \
-    PARSE_ERROR("Failed to restore token", t);                                 \
-    return false;                                                              \
+#define PARSE_ERROR(p, msg, t)                                                 \
+  fprintf(stderr, "%s near \"%.*s\" at %llu:%llu.\n", msg, (int)t.length,     \
+          token_text(p, t), t.line, t.col)
+
+// Parsing runs over the immutable token array with a cursor, so a
+// checkpoint is just the cursor value to rewind to on failure.
+#define CHECKPOINT(p) ((p)->index)
+#define RESTORE(p, checkpoint) ((p)->index = (checkpoint))
+
+// Lists are collected on a scratch stack shared by every list of the
+// same element type, nested ones included, and copied into the arena in
+// one piece once complete.
+#define SCRATCH_FINISH(p, scratch, start, out, t)                              \
+  (out)->index = (scratch).index - (start);                                    \
+  (out)->size = (out)->index;                                                  \
+  (out)->elements = (t *)arena_copy((p)->arena, (scratch).elements + (start),  \
+                                    sizeof(t) * (out)->index);                 \
+  (scratch).index = (start);                                                   \
+  if ((out)->elements == 0) {                                                  \
+    LOG_ERROR("parse", "Out of memory", 0);                                    \
+    goto cleanup;                                                              \
   }
 
-#define STORE_TOKENS_COPY(tokens, copy, err)                                   \
-  err = vector_token_copy(copy, (tokens)->elements, (tokens)->index);          \
-  if (err != E_VECTOR_OK) {                                                    \
-    LOG_ERROR("parse", "Failed to copy tokens", 0);                            \
-    return false;                                                              \
+const char *token_text(parser *p, token t) {
+  return p->source.elements + t.offset;
+}
+
+// Fetches the nth token ahead without consuming anything.
+bool peek_token(parser *p, uint64_t n, token *t) {
+  if (p->index + n >= p->tokens.index) {
+    return false;
   }
 
-#define RESTORE_TOKENS_COPY(tokens, copy, err)                                 \
-  STORE_TOKENS_COPY(copy, tokens, err)                                         \
-  vector_token_free(copy);
+  *t = p->tokens.elements[p->index + n];
+  return true;
+}
+
+// Copies the token's span into a null-terminated string in the arena.
+bool token_copy_string(parser *p, token t, vector_char *out) {
+  char *s = (char *)arena_alloc(p->arena, t.length + 1);
 
-#define SLICE(tokens, slice, t, err)                                           \
-  err = vector_token_pop(tokens, &t);                                          \
-  if (err != E_VECTOR_OK) {                                                    \
-    goto cleanup;                                                              \
-  }                                                                            \
-                                                                               \
-  err = vector_token_push(&slice, t);                                          \
-  if (err != E_VECTOR_OK) {                                                    \
-    goto cleanup;                                                              \
+  if (s == 0) {
+    return false;
   }
 
-bool parse_number(vector_token *tokens, double *n) {
+  memcpy(s, token_text(p, t), t.length);
+  s[t.length] = 0;
+
+  out->elements = s;
+  out->index = t.length + 1;
+  out->size = t.length + 1;
+  out->element_free = 0;
+  return true;
+}
+
+bool parse_number(parser *p, double *n) {
   token t = {0};
+  char buf[64] = {0};
   char *notfound = 0;
-  vector_error err = E_VECTOR_OK;
 
-  err = vector_token_pop(tokens, &t);
-  if (err != E_VECTOR_OK) {
-    goto cleanup; // EOF?
+  if (!peek_token(p, 0, &t) || t.type != TOKEN_NUMBER) {
+    return false;
   }
 
+  // The span is not null-terminated so strtod needs a bounded copy.
+  if (t.length >= sizeof(buf)) {
+    return false;
+  }
+
+  memcpy(buf, token_text(p, t), t.length);
   errno = 0;
-  *n = strtod(t.string.elements, &notfound);
-  if (*n == 0 && (errno != 0 || t.string.elements == notfound)) {
-    goto cleanup;
+  *n = strtod(buf, &notfound);
+  if (errno != 0 || notfound != buf + t.length) {
+    return false;
   }
 
+  p->index++;
   return true;
-
-cleanup:
-  PUSH(tokens, t, err);
-  return false;
 }
 
-bool parse_literal(vector_token *tokens, const char *match) {
+bool parse_literal(parser *p, token_type match) {
   token t = {0};
-  vector_error err = E_VECTOR_OK;
-  bool matched = false;
-
-  err = vector_token_pop(tokens, &t);
-  if (err == E_VECTOR_POP) {
-    goto cleanup;
-  }
 
-  // TODO: is this going to crash if match is longer?
-  matched = strncmp(t.string.elements, match, strlen(match)) == 0;
-  if (!matched) {
-    goto cleanup;
+  if (!peek_token(p, 0, &t) || t.type != match) {
+    return false;
   }
 
+  p->index++;
   return true;
-
-cleanup:
-  PUSH(tokens, t, err);
-  return false;
 }
 
-bool parse_identifier(vector_token *tokens, vector_char *identifer_out) {
-  uint64_t i = 0;
-  char c = 0;
+bool parse_identifier(parser *p, vector_char *identifier_out) {
   token t = {0};
-  vector_error err = E_VECTOR_OK;
-  uint64_t token_length = 0;
 
-  err = vector_token_pop(tokens, &t);
-  if (err == E_VECTOR_POP) {
-    goto cleanup;
+  if (!peek_token(p, 0, &t) || t.type != TOKEN_IDENTIFIER) {
+    return false;
   }
 
-  token_length = t.string.index - 1; // Omit trailing \0
-  for (i = 0; i < token_length; i++) {
-    c = t.string.elements[i];
-
-    // Can start with [$_a-Z]
-    if (c == '$' || c == '_' ||
-        ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
-      continue;
-    }
-
-    if (i > 0 && c >= '0' && c <= '9') {
-      continue;
-    }
-
-    goto cleanup;
+  if (!token_copy_string(p, t, identifier_out)) {
+    return false;
   }
 
+  p->index++;
   return true;
-
-cleanup:
-  PUSH(tokens, t, err);
-  return false;
 }
 
-bool parse_parameters(vector_token *tokens, vector_string *parameters) {
+bool parse_parameters(parser *p, vector_string *parameters) {
   vector_char parameter = {0};
-  vector_token copy = {0};
   token t = {0};
-  uint64_t i = 0;
-  vector_error err = 0;
-  char c = 0;
-  bool found_closing_paren = false;
-
-  STORE_TOKENS_COPY(tokens, &copy, err);
+  uint64_t checkpoint = CHECKPOINT(p), start = p->strings.index;
 
   while (true) {
-    if (parse_literal(tokens, ")")) {
+    if (parse_literal(p, TOKEN_RPAREN)) {
       break;
     }
 
-    if (parameters->index > 0 && !parse_literal(tokens, ",")) {
-      vector_token_get(tokens, tokens->index - 1, &t);
-      PARSE_ERROR("Expected comma after parameter", t);
+    if (p->strings.index > start && !parse_literal(p, TOKEN_COMMA)) {
+      peek_token(p, 0, &t);
+      PARSE_ERROR(p, "Expected comma after parameter", t);
       goto cleanup;
     }
 
-    if (!parse_identifier(tokens, &parameter)) {
-      vector_token_get(tokens, tokens->index - 1, &t);
-      PARSE_ERROR("Invalid identifier", t);
+    parameter = (vector_char){0};
+    if (!parse_identifier(p, &parameter)) {
+      peek_token(p, 0, &t);
+      PARSE_ERROR(p, "Invalid identifier", t);
       goto cleanup;
     }
 
-    if (vector_string_push(parameters, parameter) != E_VECTOR_OK) {
+    if (vector_string_push(&p->strings, parameter) != E_VECTOR_OK) {
       goto cleanup;
     }
   }
 
-  vector_token_free(&copy);
+  SCRATCH_FINISH(p, p->strings, start, parameters, string);
   return true;
 
 cleanup:
-  RESTORE_TOKENS_COPY(tokens, &copy, err);
+  p->strings.index = start;
+  RESTORE(p, checkpoint);
   return false;
 }
 
-bool parse_function_call(vector_token *tokens, function_call *fc) {
-  vector_expression expressions = {0};
-  vector_token copy = {0}, slice = {0};
-  expression function = {0};
+// Moves a parsed expression into the arena so it can be linked into a
+// parent node.
+expression *expression_box(parser *p, expression *e) {
+  expression *boxed = 0;
   token t = {0};
-  vector_error err = E_VECTOR_OK;
-  bool matched = false;
 
-  // Must be of form <expression>(...)
-  if (tokens->index < 3) {
-    return false;
+  boxed = (expression *)arena_alloc(p->arena, sizeof(expression));
+  if (boxed == 0) {
+    peek_token(p, 0, &t);
+    PARSE_ERROR(p, "Out of memory", t);
+    return 0;
   }
 
-  STORE_TOKENS_COPY(tokens, &copy, err);
+  memcpy(boxed, e, sizeof(expression));
+  return boxed;
+}
 
-  if (!parse_expression(tokens, &function)) {
-    goto cleanup;
-  }
+bool parse_function_call(parser *p, function_call *fc) {
+  expression e = {0};
+  uint64_t checkpoint = CHECKPOINT(p);
 
-  if (!parse_literal(tokens, "(")) {
-    goto cleanup;
+  // Must be of form <expression>(...)
+  if (!parse_postfix(p, &e)) {
+    return false;
   }
 
-  if (!parse_expressions(tokens, &expressions)) {
-    goto cleanup;
+  if (e.type != EXPRESSION_CALL) {
+    RESTORE(p, checkpoint);
+    return false;
   }
 
-  vector_token_free(&copy);
+  *fc = e.expression.function_call;
   return true;
-
-cleanup:
-  RESTORE_TOKENS_COPY(tokens, &copy, err);
-  return false;
 }
 
-bool parse_binary_op(vector_token *tokens, op *o) {
-  const char *ops[] = {"+", "-", "/", "*"};
-  vector_token copy = {0}, slice = {0};
-  expression left = {0}, right = {0};
+bool parse_primary(parser *p, expression *e) {
+  vector_char id = {0};
+  double n = 0;
   token t = {0};
-  uint64_t i = 0;
-  vector_error err = E_VECTOR_OK;
-  bool matched = false;
+  uint64_t checkpoint = CHECKPOINT(p);
 
-  if (tokens->index < 2) {
+  if (!peek_token(p, 0, &t)) {
     return false;
   }
 
-  t = tokens->elements[tokens->index - 2];
-  for (i = 0; i < (sizeof ops / sizeof ops[0]); i++) {
-    matched = strncmp(t.string.elements, ops[i], 1) == 0;
-    if (!matched) {
-      continue;
+  switch (t.type) {
+  case TOKEN_LPAREN:
+    parse_literal(p, TOKEN_LPAREN);
+
+    if (parse_expression(p, e)) {
+      if (parse_literal(p, TOKEN_RPAREN)) {
+        return true;
+      }
     }
 
-    switch (ops[i][0]) {
-    case '+':
-      o->type = OP_PLUS;
-      break;
-    case '-':
-      o->type = OP_MINUS;
-      break;
-    case '*':
-      o->type = OP_TIMES;
-      break;
-    case '/':
-      o->type = OP_DIV;
-      break;
-    default:
-      vector_token_get(tokens, tokens->index - 1, &t);
-      PARSE_ERROR("Unhandled op", t);
-      goto cleanup;
+    RESTORE(p, checkpoint);
+    return false;
+  case TOKEN_IDENTIFIER:
+    if (!parse_identifier(p, &id)) {
+      return false;
     }
 
-    break;
-  }
+    e->type = EXPRESSION_IDENTIFIER;
+    e->expression.identifier = id;
+    return true;
+  case TOKEN_NULL:
+    parse_literal(p, TOKEN_NULL);
+    e->type = EXPRESSION_NULL;
+    e->expression.number = 0;
+    return true;
+  case TOKEN_TRUE:
+    parse_literal(p, TOKEN_TRUE);
+    e->type = EXPRESSION_BOOL;
+    e->expression.number = 1;
+    return true;
+  case TOKEN_FALSE:
+    parse_literal(p, TOKEN_FALSE);
+    e->type = EXPRESSION_BOOL;
+    e->expression.number = 0;
+    return true;
+  case TOKEN_NUMBER:
+    if (!parse_number(p, &n)) {
+      PARSE_ERROR(p, "Invalid number", t);
+      return false;
+    }
 
-  if (!matched) {
+    e->type = EXPRESSION_NUMBER;
+    e->expression.number = n;
+    return true;
+  default:
     return false;
   }
+}
 
-  STORE_TOKENS_COPY(tokens, &copy, err);
-
-  SLICE(tokens, slice, t, err);
-  if (!parse_expression(&slice, &left)) {
-    goto cleanup;
-  }
+// A primary expression followed by any number of call suffixes.
+bool parse_postfix(parser *p, expression *e) {
+  function_call fc = {0};
+  vector_expression arguments = {0};
+  uint64_t checkpoint = CHECKPOINT(p);
 
-  // Drop the op
-  err = vector_token_pop(tokens, &t);
-  if (err != E_VECTOR_OK) {
-    goto cleanup;
+  if (!parse_primary(p, e)) {
+    return false;
   }
 
-  if (!parse_expression(tokens, &right)) {
-    goto cleanup;
-  }
+  while (parse_literal(p, TOKEN_LPAREN)) {
+    arguments = (vector_expression){0};
+    if (!parse_expressions(p, &arguments)) {
+      goto cleanup;
+    }
 
-  o->left_operand = (expression *)malloc(sizeof(expression));
-  if (o->left_operand == 0) {
-    vector_token_get(tokens, tokens->index - 1, &t);
-    PARSE_ERROR("Out of memory", t);
-    goto cleanup;
-  }
-  memcpy(o->left_operand, &left, sizeof(expression));
+    fc.function = expression_box(p, e);
+    fc.arguments = (vector_expression *)arena_copy(p->arena, &arguments,
+                                                   sizeof(vector_expression));
+    if (fc.function == 0 || fc.arguments == 0) {
+      LOG_ERROR("parse", "Out of memory", 0);
+      goto cleanup;
+    }
 
-  o->right_operand = (expression *)malloc(sizeof(expression));
-  if (o->right_operand == 0) {
-    vector_token_get(tokens, tokens->index - 1, &t);
-    PARSE_ERROR("Out of memory", t);
-    goto cleanup;
+    e->type = EXPRESSION_CALL;
+    e->expression.function_call = fc;
   }
-  memcpy(o->right_operand, &right, sizeof(expression));
 
-  vector_token_free(&copy);
   return true;
 
 cleanup:
-  RESTORE_TOKENS_COPY(tokens, &copy, err);
+  RESTORE(p, checkpoint);
   return false;
 }
 
-bool parse_expression(vector_token *tokens, expression *e) {
-  vector_token copy = {0};
-  vector_char id = {0};
-  function_call fc = {0};
+// Binding power of the token as a binary operator, zero if it is not
+// one.
+int binary_op_precedence(token t, op_type *type) {
+  switch (t.type) {
+  case TOKEN_LESS:
+    *type = OP_LESS;
+    return 1;
+  case TOKEN_GREATER:
+    *type = OP_GREATER;
+    return 1;
+  case TOKEN_PLUS:
+    *type = OP_PLUS;
+    return 2;
+  case TOKEN_MINUS:
+    *type = OP_MINUS;
+    return 2;
+  case TOKEN_STAR:
+    *type = OP_TIMES;
+    return 3;
+  case TOKEN_SLASH:
+    *type = OP_DIV;
+    return 3;
+  default:
+    return 0;
+  }
+}
+
+// Precedence climbing: folds operators binding at least as tightly as
+// min_precedence into left. Operators of equal precedence associate to
+// the left by looping, so the only recursion is on increasing
+// precedence and every token is visited once.
+bool parse_binary_op(parser *p, int min_precedence, expression *left) {
+  expression right = {0};
   op o = {0};
-  double n = 0;
-  vector_error err = E_VECTOR_OK;
+  op_type next_type = OP_PLUS;
+  token t = {0};
+  int precedence = 0, next_precedence = 0;
+
+  while (peek_token(p, 0, &t)) {
+    precedence = binary_op_precedence(t, &o.type);
+    if (precedence == 0 || precedence < min_precedence) {
+      break;
+    }
 
-  if (parse_literal(tokens, "(")) {
-    STORE_TOKENS_COPY(tokens, &copy, err);
+    // Drop the op
+    p->index++;
 
-    if (parse_expression(tokens, e)) {
-      if (parse_literal(tokens, ")")) {
-        return true;
+    right = (expression){0};
+    if (!parse_postfix(p, &right)) {
+      peek_token(p, 0, &t);
+      PARSE_ERROR(p, "Expected right operand", t);
+      return false;
+    }
+
+    while (peek_token(p, 0, &t)) {
+      next_precedence = binary_op_precedence(t, &next_type);
+      if (next_precedence <= precedence) {
+        break;
+      }
+
+      if (!parse_binary_op(p, precedence + 1, &right)) {
+        return false;
       }
     }
 
-    RESTORE_TOKENS_COPY(tokens, &copy, err);
-    return false;
-  }
+    o.left_operand = expression_box(p, left);
+    o.right_operand = expression_box(p, &right);
+    if (o.left_operand == 0 || o.right_operand == 0) {
+      return false;
+    }
 
-  if (parse_binary_op(tokens, &o)) {
-    e->type = EXPRESSION_OP;
-    e->expression.op = o;
-    return true;
+    left->type = EXPRESSION_OP;
+    left->expression.op = o;
   }
 
-  if (parse_identifier(tokens, &id)) {
-    e->type = EXPRESSION_IDENTIFIER;
-    e->expression.identifier = id;
-    return true;
-  }
+  return true;
+}
 
-  if (parse_literal(tokens, "null")) {
-    e->type = EXPRESSION_NULL;
-    e->expression.number = 0;
-  }
+// A binary expression, optionally followed by `? expression :
+// expression`. The alternate is parsed as a whole expression so nested
+// conditionals associate to the right.
+bool parse_expression(parser *p, expression *e) {
+  expression consequent = {0}, alternate = {0};
+  conditional c = {0};
+  token t = {0};
+  uint64_t checkpoint = CHECKPOINT(p);
 
-  if (parse_literal(tokens, "true")) {
-    e->type = EXPRESSION_BOOL;
-    e->expression.number = 0;
+  if (!parse_postfix(p, e)) {
+    return false;
   }
 
-  if (parse_literal(tokens, "false")) {
-    e->type = EXPRESSION_BOOL;
-    e->expression.number = 1;
+  if (!parse_binary_op(p, 1, e)) {
+    goto cleanup;
   }
 
-  if (parse_number(tokens, &n)) {
-    e->type = EXPRESSION_NUMBER;
-    e->expression.number = n;
+  if (!parse_literal(p, TOKEN_QUESTION)) {
     return true;
   }
 
-  if (parse_function_call(tokens, &fc)) {
-    e->type = EXPRESSION_CALL;
-    e->expression.function_call = fc;
-    return true;
+  if (!parse_expression(p, &consequent) || !parse_literal(p, TOKEN_COLON) ||
+      !parse_expression(p, &alternate)) {
+    peek_token(p, 0, &t);
+    PARSE_ERROR(p, "Invalid conditional expression", t);
+    goto cleanup;
+  }
+
+  c.test = expression_box(p, e);
+  c.consequent = expression_box(p, &consequent);
+  c.alternate = expression_box(p, &alternate);
+  if (c.test == 0 || c.consequent == 0 || c.alternate == 0) {
+    goto cleanup;
   }
 
+  e->type = EXPRESSION_CONDITIONAL;
+  e->expression.conditional = c;
+  return true;
+
+cleanup:
+  RESTORE(p, checkpoint);
   return false;
 }
 
-bool parse_expressions(vector_token *tokens, vector_expression *expressions) {
-  vector_token copy = {0};
+bool parse_expressions(parser *p, vector_expression *expressions) {
   expression e = {0};
-  vector_error err = E_VECTOR_OK;
-
-  STORE_TOKENS_COPY(tokens, &copy, err);
+  uint64_t checkpoint = CHECKPOINT(p), start = p->expressions.index;
 
   while (true) {
-    if (parse_literal(tokens, ")")) {
+    if (parse_literal(p, TOKEN_RPAREN)) {
       break;
     }
 
-    if (expressions->index > 0 && !parse_literal(tokens, ",")) {
+    if (p->expressions.index > start && !parse_literal(p, TOKEN_COMMA)) {
       goto cleanup;
     }
 
-    if (!parse_expression(tokens, &e)) {
+    if (!parse_expression(p, &e)) {
       goto cleanup;
     }
 
-    if (vector_expression_push(expressions, e) != E_VECTOR_OK) {
+    if (vector_expression_push(&p->expressions, e) != E_VECTOR_OK) {
       goto cleanup;
     }
   }
 
-  vector_token_free(&copy);
+  SCRATCH_FINISH(p, p->expressions, start, expressions, expression);
   return true;
 
 cleanup:
-  RESTORE_TOKENS_COPY(tokens, &copy, err);
+  p->expressions.index = start;
+  RESTORE(p, checkpoint);
   return false;
 }
 
-bool parse_statement(vector_token *tokens, statement *statement) {
+bool parse_statement(parser *p, statement *statement) {
   declaration d = {0};
   expression e = {0};
   token t = {0};
+  uint64_t checkpoint = CHECKPOINT(p);
   bool matched = false;
 
-  if (parse_declaration(tokens, &d)) {
+  if (parse_declaration(p, &d)) {
     statement->type = STATEMENT_DECLARATION;
-    statement->statement.declaration = malloc(sizeof(declaration));
-    if (statement->statement.declaration == 0) {
-      return false;
-    }
-
-    memcpy(statement->statement.declaration, &d, sizeof(declaration));
-    return true;
+    statement->statement.declaration =
+        (declaration *)arena_copy(p->arena, &d, sizeof(declaration));
+    return statement->statement.declaration != 0;
   }
 
-  if (parse_literal(tokens, "return")) {
-    vector_token_get(tokens, tokens->index - 1, &t);
-    matched = strncmp(t.string.elements, ";", 1) == 0;
+  if (parse_literal(p, TOKEN_RETURN)) {
+    matched = peek_token(p, 0, &t) && t.type == TOKEN_SEMICOLON;
 
     if (matched) {
       e.type = EXPRESSION_NULL;
     } else {
-      matched = parse_expression(tokens, &e);
+      matched = parse_expression(p, &e);
     }
 
     if (matched) {
@@ -410,9 +457,12 @@ bool parse_statement(vector_token *tokens, statement *statement) {
       statement->statement.ret = e;
       return true;
     }
+
+    RESTORE(p, checkpoint);
+    return false;
   }
 
-  if (parse_expression(tokens, &e)) {
+  if (parse_expression(p, &e)) {
     statement->type = STATEMENT_EXPRESSION;
     statement->statement.expression = e;
     return true;
@@ -421,181 +471,171 @@ bool parse_statement(vector_token *tokens, statement *statement) {
   return false;
 }
 
-bool parse_block(vector_token *tokens, vector_statement *statements) {
-  vector_token copy = {0};
+bool parse_block(parser *p, vector_statement *statements) {
   statement s = {0};
   token t = {0};
-  vector_error err = E_VECTOR_OK;
+  uint64_t checkpoint = CHECKPOINT(p), start = p->statements.index;
 
-  STORE_TOKENS_COPY(tokens, &copy, err);
-
-  if (!parse_literal(tokens, "{")) {
-    vector_token_get(tokens, tokens->index - 1, &t);
-    PARSE_ERROR("Expected opening brace", t);
+  if (!parse_literal(p, TOKEN_LBRACE)) {
+    peek_token(p, 0, &t);
+    PARSE_ERROR(p, "Expected opening brace", t);
     goto cleanup;
   }
 
   while (true) {
-    if (parse_literal(tokens, "}")) {
+    if (parse_literal(p, TOKEN_RBRACE)) {
       break;
     }
 
-    if (!parse_statement(tokens, &s)) {
-      vector_token_get(tokens, tokens->index - 1, &t);
-      PARSE_ERROR("Expected statement", t);
+    s = (statement){0};
+    if (!parse_statement(p, &s)) {
+      peek_token(p, 0, &t);
+      PARSE_ERROR(p, "Expected statement", t);
       goto cleanup;
     }
 
-    if (vector_statement_push(statements, s) != E_VECTOR_OK) {
+    if (vector_statement_push(&p->statements, s) != E_VECTOR_OK) {
       goto cleanup;
     }
 
-    if (statements->index > 0 && !parse_literal(tokens, ";")) {
-      vector_token_get(tokens, tokens->index - 1, &t);
-      PARSE_ERROR("Expected semi-colon", t);
+    // Declarations do not need to be terminated.
+    if (s.type == STATEMENT_DECLARATION) {
+      parse_literal(p, TOKEN_SEMICOLON);
+      continue;
+    }
+
+    if (!parse_literal(p, TOKEN_SEMICOLON)) {
+      peek_token(p, 0, &t);
+      PARSE_ERROR(p, "Expected semi-colon", t);
       goto cleanup;
     }
   }
 
-  vector_token_free(&copy);
+  SCRATCH_FINISH(p, p->statements, start, statements, statement);
   return true;
 
 cleanup:
-  statement_free(&s);
-  RESTORE_TOKENS_COPY(tokens, &copy, err);
+  p->statements.index = start;
+  RESTORE(p, checkpoint);
   return false;
 }
 
-bool parse_function_declaration(vector_token *tokens,
-                                function_declaration *fd) {
-  vector_token copy = {0};
+bool parse_function_declaration(parser *p, function_declaration *fd) {
   token t = {0};
-  vector_error err = E_VECTOR_OK;
-
-  STORE_TOKENS_COPY(tokens, &copy, err);
-
-  if (!parse_literal(tokens, "function")) {
-    goto cleanup;
-  }
+  uint64_t checkpoint = CHECKPOINT(p);
 
-  if (vector_token_pop(tokens, &t) != E_VECTOR_OK) {
-    PARSE_ERROR("Expected function name", t);
+  if (!parse_literal(p, TOKEN_FUNCTION)) {
     goto cleanup;
   }
 
-  if (vector_char_copy(&fd->name, t.string.elements, t.string.index) !=
-      E_VECTOR_OK) {
-    PARSE_ERROR("Expected function name", t);
+  if (!parse_identifier(p, &fd->name)) {
+    peek_token(p, 0, &t);
+    PARSE_ERROR(p, "Expected function name", t);
     goto cleanup;
   }
 
-  if (!parse_literal(tokens, "(")) {
-    vector_token_get(tokens, tokens->index - 1, &t);
-    PARSE_ERROR("Expected parenthesis after function name", t);
+  if (!parse_literal(p, TOKEN_LPAREN)) {
+    peek_token(p, 0, &t);
+    PARSE_ERROR(p, "Expected parenthesis after function name", t);
     goto cleanup;
   }
 
-  if (!parse_parameters(tokens, &fd->parameters)) {
-    vector_token_get(tokens, tokens->index - 1, &t);
-    PARSE_ERROR("Expected parameters", t);
+  if (!parse_parameters(p, &fd->parameters)) {
+    peek_token(p, 0, &t);
+    PARSE_ERROR(p, "Expected parameters", t);
     goto cleanup;
   }
 
-  if (!parse_block(tokens, &fd->body)) {
-    vector_token_get(tokens, tokens->index - 1, &t);
-    PARSE_ERROR("Expected body", t);
+  if (!parse_block(p, &fd->body)) {
+    peek_token(p, 0, &t);
+    PARSE_ERROR(p, "Expected body", t);
     goto cleanup;
   }
 
-  vector_token_free(&copy);
   return true;
 
 cleanup:
-  RESTORE_TOKENS_COPY(tokens, &copy, err);
+  RESTORE(p, checkpoint);
   return false;
 }
 
-bool parse_const_declaration(vector_token *tokens,
-                             vector_variable_declaration *vd) {
-  if (!parse_literal(tokens, "const")) {
+bool parse_const_declaration(parser *p, vector_variable_declaration *vd) {
+  if (!parse_literal(p, TOKEN_CONST)) {
     return false;
   }
 
   return false;
 }
 
-bool parse_let_declaration(vector_token *tokens,
-                           vector_variable_declaration *vd) {
-  if (!parse_literal(tokens, "let")) {
+bool parse_let_declaration(parser *p, vector_variable_declaration *vd) {
+  if (!parse_literal(p, TOKEN_LET)) {
     return false;
   }
 
   return false;
 }
 
-bool parse_var_declaration(vector_token *tokens,
-                           vector_variable_declaration *vd) {
-  if (!parse_literal(tokens, "var")) {
+bool parse_var_declaration(parser *p, vector_variable_declaration *vd) {
+  if (!parse_literal(p, TOKEN_VAR)) {
     return false;
   }
 
   return false;
 }
 
-bool parse_declaration(vector_token *tokens, declaration *d) {
+bool parse_declaration(parser *p, declaration *d) {
   vector_variable_declaration vd = {0};
   function_declaration fd = {0};
 
-  if (parse_function_declaration(tokens, &fd)) {
+  if (parse_function_declaration(p, &fd)) {
     d->type = DECLARATION_FUNCTION;
     d->declaration.function = fd;
     return true;
   }
 
-  if (parse_const_declaration(tokens, &vd)) {
+  if (parse_const_declaration(p, &vd)) {
     d->type = DECLARATION_CONST;
     d->declaration.variable_list = vd;
     return true;
   }
 
-  if (parse_let_declaration(tokens, &vd)) {
+  if (parse_let_declaration(p, &vd)) {
     d->type = DECLARATION_LET;
     d->declaration.variable_list = vd;
     return true;
   }
 
-  if (parse_var_declaration(tokens, &vd)) {
+  if (parse_var_declaration(p, &vd)) {
     d->type = DECLARATION_VAR;
     d->declaration.variable_list = vd;
     return true;
   }
 
-  vector_variable_declaration_free(&vd);
-  function_declaration_free(&fd);
   return false;
 }
 
 parse_error parse(vector_char source, ast *program_out) {
-  vector_token tokens = {0};
+  parser p = {0};
   declaration d = {0};
   parse_error err = E_PARSE_OK;
 
-  tokens.element_free = token_element_free;
-  err = (parse_error)lex(source, &tokens);
+  p.source = source;
+  p.arena = &program_out->arena;
+  err = (parse_error)lex(source, &p.tokens);
   if (err != E_LEX_OK) {
     LOG_ERROR("lex", "Error during initialization", err);
     goto cleanup;
   }
 
-  if (!tokens.index) {
+  if (!p.tokens.index) {
     LOG_ERROR("parse", "Program is empty", 0);
     err = E_PARSE_EMPTY;
     goto cleanup;
   }
 
-  while (tokens.index) {
+  while (p.index < p.tokens.index) {
     d = (declaration){0};
-    if (!parse_declaration(&tokens, &d)) {
+    if (!parse_declaration(&p, &d)) {
       LOG_ERROR("parse", "Expected top-level declaration", 0);
       err = E_PARSE_TOPLEVEL_DECLARATION;
       goto cleanup;
@@ -609,6 +649,9 @@ parse_error parse(vector_char source, ast *program_out) {
   }
 
 cleanup:
-  vector_token_free(&tokens);
+  vector_token_free(&p.tokens);
+  vector_expression_free(&p.expressions);
+  vector_statement_free(&p.statements);
+  vector_string_free(&p.strings);
   return err;
 }
@@ -0,0 +1,127 @@
+#include "slowjs/pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "slowjs/common.h"
+
+// Tasks begin up to end have not been taken yet.
+struct pool_queue {
+  pthread_mutex_t lock;
+  uint64_t begin;
+  uint64_t end;
+};
+typedef struct pool_queue pool_queue;
+
+struct pool {
+  pool_queue *queues;
+  uint32_t nqueues;
+  pool_task task;
+  void *data;
+};
+typedef struct pool pool;
+
+struct pool_worker {
+  pool *p;
+  uint32_t queue;
+  pthread_t thread;
+};
+typedef struct pool_worker pool_worker;
+
+bool pool_take(pool *, uint32_t, uint64_t *);
+void *pool_work(void *);
+
+// The owner takes from the front of its queue, everyone else from the
+// back.
+bool pool_take(pool *p, uint32_t queue, uint64_t *task) {
+  pool_queue *q = &p->queues[queue];
+  uint32_t i = 0;
+  bool taken = false;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->begin < q->end) {
+    *task = q->begin++;
+    taken = true;
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  for (i = 1; i < p->nqueues && !taken; i++) {
+    q = &p->queues[(queue + i) % p->nqueues];
+    pthread_mutex_lock(&q->lock);
+    if (q->begin < q->end) {
+      *task = --q->end;
+      taken = true;
+    }
+    pthread_mutex_unlock(&q->lock);
+  }
+
+  return taken;
+}
+
+void *pool_work(void *data) {
+  pool_worker *w = (pool_worker *)data;
+  uint64_t task = 0;
+
+  while (pool_take(w->p, w->queue, &task)) {
+    w->p->task(w->p->data, task);
+  }
+
+  return 0;
+}
+
+pool_error pool_run(uint32_t threads, uint64_t ntasks, pool_task task,
+                    void *data) {
+  pool p = {0};
+  pool_worker *workers = 0;
+  bool *started = 0;
+  uint32_t i = 0;
+  pool_error err = E_POOL_OK;
+
+  if (threads > ntasks) {
+    threads = ntasks;
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+
+  p.nqueues = threads;
+  p.task = task;
+  p.data = data;
+  p.queues = (pool_queue *)calloc(threads, sizeof(pool_queue));
+  workers = (pool_worker *)calloc(threads, sizeof(pool_worker));
+  started = (bool *)calloc(threads, sizeof(bool));
+  if (p.queues == 0 || workers == 0 || started == 0) {
+    err = E_POOL_MALLOC;
+    goto cleanup;
+  }
+
+  for (i = 0; i < threads; i++) {
+    pthread_mutex_init(&p.queues[i].lock, 0);
+    p.queues[i].begin = ntasks * i / threads;
+    p.queues[i].end = ntasks * (i + 1) / threads;
+    workers[i].p = &p;
+    workers[i].queue = i;
+  }
+
+  for (i = 1; i < threads; i++) {
+    started[i] = pthread_create(&workers[i].thread, 0, pool_work,
+                                &workers[i]) == 0;
+  }
+  pool_work(&workers[0]);
+
+  for (i = 1; i < threads; i++) {
+    if (started[i]) {
+      pthread_join(workers[i].thread, 0);
+    }
+  }
+
+  for (i = 0; i < threads; i++) {
+    pthread_mutex_destroy(&p.queues[i].lock);
+  }
+
+cleanup:
+  free(started);
+  free(workers);
+  free(p.queues);
+  return err;
+}
@@ -0,0 +1,14 @@
+#include "slowjs/quicken.h"
+
+void quicken_print_stats(quicken_stats *s, FILE *out) {
+  // A miss runs again as generic.
+  uint64_t total = s->hits + s->generic;
+
+  fprintf(out,
+          "quicken: %llu sites quickened, %llu deoptimized\n"
+          "quicken: %llu of %llu arithmetic ops specialized (%.1f%% hit "
+          "rate)\n",
+          (unsigned long long)s->quickened, (unsigned long long)s->misses,
+          (unsigned long long)s->hits, (unsigned long long)total,
+          total ? 100.0 * s->hits / total : 0.0);
+}
@@ -0,0 +1,251 @@
+#include "slowjs/resolve.h"
+
+#include <stdio.h>
+
+#include "slowjs/common.h"
+
+struct resolver {
+  flat_ast *flat;
+  // Global slot of each name id, UINT32_MAX if there is none.
+  uint32_t *globals;
+};
+typedef struct resolver resolver;
+
+uint32_t resolve_slot(flat_ast *, flat_function *, uint32_t, uint64_t);
+uint32_t resolve_global(flat_ast *, uint32_t);
+resolve_error resolve_expression(resolver *, uint32_t, uint32_t);
+resolve_error resolve_function(resolver *, uint32_t);
+void resolve_tail_position(flat_ast *, uint32_t);
+
+// Slot name is bound to in fn, considering only the first n statements
+// for declarations, or UINT32_MAX. Declarations shadow parameters and
+// later parameters shadow earlier ones.
+uint32_t resolve_slot(flat_ast *f, flat_function *fn, uint32_t name,
+                      uint64_t n) {
+  flat_node s = {0};
+  uint64_t i = 0;
+
+  for (i = n; i > 0; i--) {
+    s = f->nodes.elements[f->extras.elements[fn->body + i - 1]];
+    if (s.type == FLAT_FUNCTION && f->functions.elements[s.a].name == name) {
+      return s.b;
+    }
+  }
+
+  for (i = fn->nparameters; i > 0; i--) {
+    if (f->extras.elements[fn->parameters + i - 1] == name) {
+      return i - 1;
+    }
+  }
+
+  return UINT32_MAX;
+}
+
+uint32_t resolve_global(flat_ast *f, uint32_t name) {
+  uint64_t i = 0;
+
+  for (i = 0; i < f->globals.index; i++) {
+    if (f->functions.elements[f->globals.elements[i]].name == name) {
+      return i;
+    }
+  }
+
+  return UINT32_MAX;
+}
+
+resolve_error resolve_expression(resolver *r, uint32_t function,
+                                 uint32_t node) {
+  flat_ast *f = r->flat;
+  flat_node *n = &f->nodes.elements[node];
+  flat_function *fn = 0;
+  uint32_t depth = 0, slot = 0, name = 0, args = 0, nargs = 0;
+  uint64_t i = 0;
+  resolve_error err = E_RESOLVE_OK, first_err = E_RESOLVE_OK;
+
+  switch (n->type) {
+  case FLAT_IDENTIFIER:
+    name = n->a;
+    for (; function != UINT32_MAX; function = fn->parent, depth++) {
+      fn = &f->functions.elements[function];
+      slot = resolve_slot(f, fn, name, fn->nstatements);
+      if (slot != UINT32_MAX) {
+        n->type = FLAT_LOCAL;
+        n->a = depth;
+        n->b = slot;
+        return E_RESOLVE_OK;
+      }
+    }
+
+    slot = r->globals[name];
+    if (slot != UINT32_MAX) {
+      n->type = FLAT_GLOBAL;
+      n->a = slot;
+      return E_RESOLVE_OK;
+    }
+
+    fprintf(stderr, "ReferenceError: %s is not defined\n",
+            interned_name(&f->names, name));
+    return E_RESOLVE_UNDEFINED;
+  case FLAT_OP:
+    first_err = resolve_expression(r, function, n->a);
+    err = resolve_expression(r, function, f->nodes.elements[node].b);
+    break;
+  case FLAT_CALL:
+  case FLAT_TAIL_CALL:
+  case FLAT_CONDITIONAL:
+    // The callee or test, then the rest from extras.
+    args = n->b;
+    nargs = n->type == FLAT_CONDITIONAL ? 2 : n->count;
+    first_err = resolve_expression(r, function, n->a);
+    for (i = 0; i < nargs; i++) {
+      err = resolve_expression(r, function, f->extras.elements[args + i]);
+      if (first_err == E_RESOLVE_OK) {
+        first_err = err;
+      }
+    }
+    break;
+  default:
+    return E_RESOLVE_OK;
+  }
+
+  return first_err != E_RESOLVE_OK ? first_err : err;
+}
+
+resolve_error resolve_function(resolver *r, uint32_t function) {
+  flat_ast *f = r->flat;
+  flat_function *fn = &f->functions.elements[function];
+  flat_node *s = 0;
+  uint32_t slot = 0;
+  uint64_t i = 0;
+  resolve_error err = E_RESOLVE_OK, first_err = E_RESOLVE_OK;
+
+  fn->nslots = fn->nparameters;
+
+  // Assign every declaration a slot before resolving any references so
+  // that functions are visible throughout the body they are declared in.
+  for (i = 0; i < fn->nstatements; i++) {
+    s = &f->nodes.elements[f->extras.elements[fn->body + i]];
+    if (s->type != FLAT_FUNCTION) {
+      continue;
+    }
+
+    f->functions.elements[s->a].parent = function;
+    fn->heap_slots = 1;
+
+    slot = resolve_slot(f, fn, f->functions.elements[s->a].name, i);
+    if (slot == UINT32_MAX) {
+      slot = fn->nslots++;
+    }
+    s->b = slot;
+  }
+
+  for (i = 0; i < fn->nstatements; i++) {
+    s = &f->nodes.elements[f->extras.elements[fn->body + i]];
+    if (s->type == FLAT_RETURN || s->type == FLAT_EXPRESSION) {
+      err = resolve_expression(r, function, s->a);
+      if (first_err == E_RESOLVE_OK) {
+        first_err = err;
+      }
+    }
+  }
+
+  return first_err;
+}
+
+resolve_error resolve(flat_ast *f) {
+  resolver r = {0};
+  uint32_t function = 0, name = 0;
+  uint64_t i = 0;
+  resolve_error err = E_RESOLVE_OK, first_err = E_RESOLVE_OK;
+
+  r.flat = f;
+  r.globals = (uint32_t *)malloc(sizeof(uint32_t) * (f->names.names.index + 1));
+  if (r.globals == 0) {
+    return E_RESOLVE_MALLOC;
+  }
+  memset(r.globals, 0xff, sizeof(uint32_t) * f->names.names.index);
+
+  for (i = 0; i < f->functions.index; i++) {
+    f->functions.elements[i].parent = UINT32_MAX;
+  }
+
+  // A later top-level function replaces an earlier one of the same name.
+  for (i = 0; i < f->declarations.index; i++) {
+    function = f->declarations.elements[i];
+    name = f->functions.elements[function].name;
+    if (r.globals[name] != UINT32_MAX) {
+      f->globals.elements[r.globals[name]] = function;
+      continue;
+    }
+
+    r.globals[name] = f->globals.index;
+    if (vector_uint32_t_push(&f->globals, function) != E_VECTOR_OK) {
+      first_err = E_RESOLVE_MALLOC;
+      goto cleanup;
+    }
+  }
+
+  // Enclosing functions come before the functions nested in them, so
+  // parents are set by the time a function is resolved.
+  for (i = 0; i < f->functions.index; i++) {
+    err = resolve_function(&r, i);
+    if (first_err == E_RESOLVE_OK) {
+      first_err = err;
+    }
+  }
+
+  if (first_err == E_RESOLVE_OK) {
+    resolve_tail_calls(f);
+  }
+
+cleanup:
+  free(r.globals);
+  return first_err;
+}
+
+void resolve_tail_position(flat_ast *f, uint32_t node) {
+  flat_node *n = &f->nodes.elements[node];
+
+  switch (n->type) {
+  case FLAT_CALL:
+    n->type = FLAT_TAIL_CALL;
+    break;
+  case FLAT_CONDITIONAL:
+    resolve_tail_position(f, f->extras.elements[n->b]);
+    resolve_tail_position(f, f->extras.elements[n->b + 1]);
+    break;
+  default:
+    break;
+  }
+}
+
+void resolve_tail_calls(flat_ast *f) {
+  flat_function *fn = 0;
+  flat_node s = {0};
+  uint64_t i = 0, j = 0;
+
+  for (i = 0; i < f->functions.index; i++) {
+    fn = &f->functions.elements[i];
+    for (j = 0; j < fn->nstatements; j++) {
+      s = f->nodes.elements[f->extras.elements[fn->body + j]];
+      if (s.type == FLAT_RETURN) {
+        resolve_tail_position(f, s.a);
+      }
+    }
+  }
+}
+
+uint32_t resolve_main(flat_ast *f) {
+  uint32_t main = 0, slot = 0;
+
+  if (intern_lookup(&f->names, "main", 4, &main) != E_INTERN_OK) {
+    return UINT32_MAX;
+  }
+
+  slot = resolve_global(f, main);
+  if (slot == UINT32_MAX) {
+    return UINT32_MAX;
+  }
+
+  return f->globals.elements[slot];
+}
@@ -0,0 +1,76 @@
+#include "slowjs/scheduler.h"
+
+void scheduler_finish(scheduler *, scheduler_task *, slowjs_error, uint64_t);
+
+void scheduler_init(scheduler *s, uint64_t slice, uint64_t limit) {
+  s->slice = slice ? slice : SCHEDULER_DEFAULT_SLICE;
+  s->limit = limit;
+  s->head = 0;
+  s->tail = 0;
+  s->waiting = 0;
+}
+
+// Counts the slice t just had and puts it at the back of the line if it
+// yielded and has fuel left.
+void scheduler_finish(scheduler *s, scheduler_task *t, slowjs_error err,
+                      uint64_t fuel_before) {
+  t->slices++;
+  t->fuel += slowjs_fuel_used(t->script) - fuel_before;
+  if (err != E_SLOWJS_YIELD || (s->limit && t->fuel >= s->limit)) {
+    t->done = true;
+    t->error = err;
+    return;
+  }
+
+  t->next = 0;
+  if (s->tail) {
+    s->tail->next = t;
+  } else {
+    s->head = t;
+  }
+  s->tail = t;
+  s->waiting++;
+}
+
+void scheduler_start(scheduler *s, scheduler_task *t, const char *name,
+                     value *args, uint32_t nargs) {
+  uint64_t fuel = slowjs_fuel_used(t->script);
+  slowjs_error err = E_SLOWJS_OK;
+
+  t->done = false;
+  t->error = E_SLOWJS_OK;
+  t->result = NULL_VALUE;
+  t->slices = 0;
+  t->fuel = 0;
+  t->next = 0;
+
+  slowjs_set_fuel(t->script, s->slice);
+  err = slowjs_call(t->script, name, args, nargs, &t->result);
+  scheduler_finish(s, t, err, fuel);
+}
+
+bool scheduler_step(scheduler *s) {
+  scheduler_task *t = s->head;
+  uint64_t fuel = 0;
+  slowjs_error err = E_SLOWJS_OK;
+
+  if (t == 0) {
+    return false;
+  }
+
+  s->head = t->next;
+  if (s->head == 0) {
+    s->tail = 0;
+  }
+  s->waiting--;
+
+  fuel = slowjs_fuel_used(t->script);
+  err = slowjs_resume(t->script, &t->result);
+  scheduler_finish(s, t, err, fuel);
+  return true;
+}
+
+void scheduler_run(scheduler *s) {
+  while (scheduler_step(s)) {
+  }
+}
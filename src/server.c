@@ -0,0 +1,619 @@
+#include "slowjs/server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "slowjs/file.h"
+
+// Events taken per epoll_wait, and slices run between two of them while
+// calls are waiting.
+#define SERVER_EVENTS 64
+#define SERVER_STEPS 16
+
+// A compiled script. Calls run on clones of script, which are kept for
+// later requests once their call is done.
+struct server_script {
+  slowjs_script *script;
+  // What the file looked like when it was compiled.
+  struct timespec mtime;
+  off_t size;
+  ino_t inode;
+  slowjs_script **idle;
+  uint64_t nidle;
+  uint64_t idle_capacity;
+};
+typedef struct server_script server_script;
+
+struct server_buffer {
+  char *data;
+  uint64_t length;
+  uint64_t capacity;
+};
+typedef struct server_buffer server_buffer;
+
+struct server_connection {
+  int fd;
+  // What epoll is watching fd for.
+  uint32_t events;
+  server_buffer in;
+  server_buffer out;
+  // The peer will send nothing more.
+  bool eof;
+  // Nothing more can be sent to the peer either.
+  bool broken;
+  // Set while task runs, requests after it wait until it is done.
+  bool busy;
+  scheduler_task task;
+  server_script *script;
+  struct server_connection *prev;
+  struct server_connection *next;
+};
+typedef struct server_connection server_connection;
+
+bool server_buffer_append(server_buffer *, const char *, uint64_t);
+void server_buffer_consume(server_buffer *, uint64_t);
+const char *server_reason(slowjs_error);
+void server_script_reset(server_script *);
+const char *server_acquire(server *, const char *, server_script **,
+                           slowjs_script **);
+void server_release(server_script *, slowjs_script *);
+void server_watch(server *, server_connection *);
+void server_flush(server *, server_connection *);
+void server_respond(server *, server_connection *, const char *);
+void server_respond_value(server *, server_connection *, value);
+void server_request(server *, server_connection *, char *);
+void server_next(server *, server_connection *);
+void server_done(server *, server_connection *);
+void server_read(server *, server_connection *);
+void server_accept(server *);
+void server_connection_free(server *, server_connection *);
+void server_settle(server *, server_connection *);
+
+bool server_buffer_append(server_buffer *b, const char *data,
+                          uint64_t length) {
+  char *grown = 0;
+  uint64_t capacity = b->capacity ? b->capacity : 256;
+
+  while (capacity < b->length + length) {
+    capacity *= 2;
+  }
+
+  if (capacity != b->capacity) {
+    grown = (char *)realloc(b->data, capacity);
+    if (grown == 0) {
+      return false;
+    }
+    b->data = grown;
+    b->capacity = capacity;
+  }
+
+  memcpy(b->data + b->length, data, length);
+  b->length += length;
+  return true;
+}
+
+void server_buffer_consume(server_buffer *b, uint64_t length) {
+  memmove(b->data, b->data + length, b->length - length);
+  b->length -= length;
+}
+
+const char *server_reason(slowjs_error err) {
+  switch (err) {
+  case E_SLOWJS_PARSE:
+    return "error parsing program";
+  case E_SLOWJS_COMPILE:
+    return "error compiling program";
+  case E_SLOWJS_NOT_FOUND:
+    return "error function not found";
+  case E_SLOWJS_CALL_NONFUNCTION:
+    return "error calling a non-function";
+  case E_SLOWJS_STACK_OVERFLOW:
+    return "error maximum call stack size exceeded";
+  case E_SLOWJS_YIELD:
+    return "error too many calls";
+  default:
+    return "error out of memory";
+  }
+}
+
+// Frees every script of the program, except clones still running.
+void server_script_reset(server_script *entry) {
+  for (; entry->nidle > 0; entry->nidle--) {
+    slowjs_free(entry->idle[entry->nidle - 1]);
+  }
+  slowjs_free(entry->script);
+  entry->script = 0;
+}
+
+// Finds a script for path that is free to call, compiling the file if
+// it is new or has changed. Returns why it failed, or 0.
+const char *server_acquire(server *s, const char *path,
+                           server_script **entry_out, slowjs_script **out) {
+  struct stat st = {0};
+  vector_char source = {0};
+  server_script *entry = 0, **grown = 0;
+  slowjs_script *compiled = 0;
+  uint32_t id = 0;
+  slowjs_error err = E_SLOWJS_OK;
+
+  if (stat(path, &st) != 0) {
+    return "error reading file";
+  }
+
+  if (intern(&s->paths, path, strlen(path), &id) != E_INTERN_OK) {
+    return "error out of memory";
+  }
+
+  if (id >= s->nscripts) {
+    grown = (server_script **)realloc(s->scripts,
+                                      sizeof(server_script *) * (id + 1));
+    if (grown == 0) {
+      return "error out of memory";
+    }
+    memset(grown + s->nscripts, 0,
+           sizeof(server_script *) * (id + 1 - s->nscripts));
+    s->scripts = grown;
+    s->nscripts = id + 1;
+  }
+
+  entry = s->scripts[id];
+  if (entry == 0) {
+    entry = (server_script *)calloc(1, sizeof(server_script));
+    if (entry == 0) {
+      return "error out of memory";
+    }
+    s->scripts[id] = entry;
+  }
+
+  if (entry->script == 0 || entry->mtime.tv_sec != st.st_mtim.tv_sec ||
+      entry->mtime.tv_nsec != st.st_mtim.tv_nsec ||
+      entry->size != st.st_size || entry->inode != st.st_ino) {
+    if (read_file((char *)path, &source) != E_FILE_OK ||
+        vector_char_push(&source, 0) != E_VECTOR_OK) {
+      vector_char_free(&source);
+      return "error reading file";
+    }
+
+    err = slowjs_compile(source.elements, s->options.run, &compiled);
+    vector_char_free(&source);
+    if (err != E_SLOWJS_OK) {
+      return server_reason(err);
+    }
+
+    // Clones still running keep the old program until they are done.
+    server_script_reset(entry);
+    entry->script = compiled;
+    entry->mtime = st.st_mtim;
+    entry->size = st.st_size;
+    entry->inode = st.st_ino;
+    s->stats.compiles++;
+  }
+
+  if (entry->nidle > 0) {
+    *out = entry->idle[--entry->nidle];
+  } else if (slowjs_clone(entry->script, out) != E_SLOWJS_OK) {
+    return "error out of memory";
+  }
+
+  *entry_out = entry;
+  return 0;
+}
+
+// Keeps script for the next request unless its program is out of date.
+void server_release(server_script *entry, slowjs_script *script) {
+  slowjs_script **grown = 0;
+  uint64_t capacity = 0;
+
+  if (script->program != entry->script->program) {
+    slowjs_free(script);
+    return;
+  }
+
+  if (entry->nidle == entry->idle_capacity) {
+    capacity = entry->idle_capacity ? entry->idle_capacity * 2 : 4;
+    grown = (slowjs_script **)realloc(entry->idle,
+                                      sizeof(slowjs_script *) * capacity);
+    if (grown == 0) {
+      slowjs_free(script);
+      return;
+    }
+    entry->idle = grown;
+    entry->idle_capacity = capacity;
+  }
+
+  entry->idle[entry->nidle++] = script;
+}
+
+// Watches for more requests while none is running and the peer is not
+// done sending, and for room to write while answers are waiting.
+void server_watch(server *s, server_connection *c) {
+  struct epoll_event event = {0};
+
+  if (c->broken) {
+    if (c->fd >= 0) {
+      close(c->fd);
+      c->fd = -1;
+    }
+    return;
+  }
+
+  event.events = (c->eof || c->busy ? 0 : EPOLLIN) |
+                 (c->out.length ? EPOLLOUT : 0);
+  event.data.ptr = c;
+  if (event.events != c->events &&
+      epoll_ctl(s->epoll, EPOLL_CTL_MOD, c->fd, &event) == 0) {
+    c->events = event.events;
+  }
+}
+
+void server_flush(server *s, server_connection *c) {
+  ssize_t written = 0;
+
+  while (c->out.length > 0 && !c->broken) {
+    written = send(c->fd, c->out.data, c->out.length, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (written < 0) {
+      c->broken = true;
+      break;
+    }
+    server_buffer_consume(&c->out, written);
+  }
+
+  server_watch(s, c);
+}
+
+void server_respond(server *s, server_connection *c, const char *line) {
+  if (!server_buffer_append(&c->out, line, strlen(line)) ||
+      !server_buffer_append(&c->out, "\n", 1)) {
+    c->broken = true;
+  }
+  s->stats.failed++;
+  server_flush(s, c);
+}
+
+// Answers with what value_print would print.
+void server_respond_value(server *s, server_connection *c, value v) {
+  char line[512] = {0};
+  FILE *out = fmemopen(line, sizeof(line), "w");
+
+  if (out == 0) {
+    server_respond(s, c, "error out of memory");
+    return;
+  }
+  value_fprint(v, out);
+  fclose(out);
+
+  if (!server_buffer_append(&c->out, line, strlen(line))) {
+    c->broken = true;
+  }
+  server_flush(s, c);
+}
+
+// line is one request without its newline.
+void server_request(server *s, server_connection *c, char *line) {
+  char *path = 0, *name = 0, *word = 0, *end = 0, *rest = 0;
+  value args[SERVER_MAX_ARGS] = {0};
+  uint32_t nargs = 0;
+  const char *reason = 0;
+
+  s->stats.requests++;
+  path = strtok_r(line, " \t\r", &rest);
+  name = strtok_r(0, " \t\r", &rest);
+  if (path == 0 || name == 0) {
+    server_respond(s, c, "error bad request");
+    return;
+  }
+
+  while ((word = strtok_r(0, " \t\r", &rest)) != 0) {
+    if (nargs == SERVER_MAX_ARGS) {
+      server_respond(s, c, "error too many arguments");
+      return;
+    }
+    args[nargs++] = number_value(strtod(word, &end));
+    if (*end != 0) {
+      server_respond(s, c, "error bad request");
+      return;
+    }
+  }
+
+  reason = server_acquire(s, path, &c->script, &c->task.script);
+  if (reason) {
+    server_respond(s, c, reason);
+    return;
+  }
+
+  c->busy = true;
+  scheduler_start(&s->tasks, &c->task, name, args, nargs);
+  if (c->task.done) {
+    server_done(s, c);
+  }
+}
+
+// Runs the requests read so far, up to the first that has to wait.
+void server_next(server *s, server_connection *c) {
+  char *newline = 0;
+  uint64_t length = 0;
+
+  while (!c->busy && !c->broken && c->in.length > 0) {
+    newline = (char *)memchr(c->in.data, '\n', c->in.length);
+    if (newline == 0) {
+      if (c->in.length > SERVER_MAX_REQUEST || c->eof) {
+        c->broken = true;
+      }
+      return;
+    }
+
+    *newline = 0;
+    length = newline - c->in.data + 1;
+    server_request(s, c, c->in.data);
+    server_buffer_consume(&c->in, length);
+  }
+}
+
+void server_done(server *s, server_connection *c) {
+  c->busy = false;
+  if (c->task.error == E_SLOWJS_OK) {
+    server_respond_value(s, c, c->task.result);
+  } else {
+    server_respond(s, c, server_reason(c->task.error));
+  }
+  server_release(c->script, c->task.script);
+  c->task.script = 0;
+}
+
+void server_read(server *s, server_connection *c) {
+  char chunk[4096] = {0};
+  ssize_t length = 0;
+
+  while (!c->eof) {
+    length = recv(c->fd, chunk, sizeof(chunk), 0);
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (length <= 0) {
+      c->eof = true;
+      break;
+    }
+    if (!server_buffer_append(&c->in, chunk, length)) {
+      c->broken = true;
+      return;
+    }
+  }
+
+  server_next(s, c);
+  server_watch(s, c);
+}
+
+void server_accept(server *s) {
+  server_connection *c = 0;
+  struct epoll_event event = {0};
+  int fd = 0;
+
+  while ((fd = accept(s->listener, 0, 0)) >= 0) {
+    c = (server_connection *)calloc(1, sizeof(server_connection));
+    event.events = EPOLLIN;
+    event.data.ptr = c;
+    if (c == 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) != 0 ||
+        epoll_ctl(s->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+      free(c);
+      close(fd);
+      continue;
+    }
+
+    c->fd = fd;
+    c->events = EPOLLIN;
+    c->next = s->connections;
+    if (c->next) {
+      c->next->prev = c;
+    }
+    s->connections = c;
+    s->stats.connections++;
+  }
+}
+
+void server_connection_free(server *s, server_connection *c) {
+  if (c->prev) {
+    c->prev->next = c->next;
+  } else {
+    s->connections = c->next;
+  }
+  if (c->next) {
+    c->next->prev = c->prev;
+  }
+
+  // Only when the whole server goes, otherwise a busy connection waits
+  // for its task.
+  slowjs_free(c->task.script);
+  if (c->fd >= 0) {
+    close(c->fd);
+  }
+  free(c->in.data);
+  free(c->out.data);
+  free(c);
+}
+
+// Closes c once its last answer is out or cannot be sent.
+void server_settle(server *s, server_connection *c) {
+  server_watch(s, c);
+  if (!c->busy && (c->broken || (c->eof && c->out.length == 0))) {
+    server_connection_free(s, c);
+  }
+}
+
+server_error server_init(server *s, const char *path, server_options options) {
+  struct sockaddr_un address = {0};
+  struct epoll_event event = {0};
+
+  *s = (server){0};
+  s->listener = -1;
+  s->epoll = -1;
+  s->wake = -1;
+  s->options = options;
+  if (s->options.limit == 0) {
+    s->options.limit = SERVER_DEFAULT_LIMIT;
+  }
+  scheduler_init(&s->tasks, s->options.slice, s->options.limit);
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    return E_SERVER_SOCKET;
+  }
+  s->path = strdup(path);
+  if (s->path == 0) {
+    return E_SERVER_MALLOC;
+  }
+
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  unlink(path);
+  s->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (s->listener < 0 ||
+      bind(s->listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(s->listener, SOMAXCONN) != 0) {
+    return E_SERVER_SOCKET;
+  }
+
+  s->epoll = epoll_create1(EPOLL_CLOEXEC);
+  s->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (s->epoll < 0 || s->wake < 0) {
+    return E_SERVER_EPOLL;
+  }
+
+  event.events = EPOLLIN;
+  event.data.ptr = &s->listener;
+  if (epoll_ctl(s->epoll, EPOLL_CTL_ADD, s->listener, &event) != 0) {
+    return E_SERVER_EPOLL;
+  }
+  event.data.ptr = &s->wake;
+  if (epoll_ctl(s->epoll, EPOLL_CTL_ADD, s->wake, &event) != 0) {
+    return E_SERVER_EPOLL;
+  }
+
+  return E_SERVER_OK;
+}
+
+// Everything runs on this thread. Requests are read and started as
+// they come in, and while calls are left the loop polls without
+// blocking between every few slices.
+server_error server_run(server *s) {
+  struct epoll_event events[SERVER_EVENTS] = {{0}};
+  server_connection *c = 0;
+  scheduler_task *t = 0;
+  int n = 0, i = 0;
+
+  while (!s->stopping) {
+    n = epoll_wait(s->epoll, events, SERVER_EVENTS, s->tasks.head ? 0 : -1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return E_SERVER_EPOLL;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (events[i].data.ptr == &s->listener) {
+        server_accept(s);
+        continue;
+      }
+      if (events[i].data.ptr == &s->wake) {
+        s->stopping = true;
+        continue;
+      }
+
+      c = (server_connection *)events[i].data.ptr;
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        server_read(s, c);
+      }
+      if (events[i].events & EPOLLOUT) {
+        server_flush(s, c);
+      }
+      // Hung up with nothing left to read, which would come back on
+      // every poll.
+      if ((events[i].events & (EPOLLHUP | EPOLLERR)) && c->eof) {
+        c->broken = true;
+      }
+      server_settle(s, c);
+    }
+
+    for (i = 0; i < SERVER_STEPS && (t = s->tasks.head) != 0; i++) {
+      scheduler_step(&s->tasks);
+      if (!t->done) {
+        continue;
+      }
+
+      c = (server_connection *)((char *)t -
+                                offsetof(server_connection, task));
+      server_done(s, c);
+      server_next(s, c);
+      server_settle(s, c);
+    }
+  }
+
+  return E_SERVER_OK;
+}
+
+void server_stop(server *s) {
+  uint64_t one = 1;
+
+  if (write(s->wake, &one, sizeof(one)) < 0) {
+    // Already woken enough that the counter is full.
+  }
+}
+
+void server_free(server *s) {
+  uint64_t i = 0;
+
+  while (s->connections) {
+    server_connection_free(s, s->connections);
+  }
+
+  for (i = 0; i < s->nscripts; i++) {
+    if (s->scripts[i]) {
+      server_script_reset(s->scripts[i]);
+      free(s->scripts[i]->idle);
+      free(s->scripts[i]);
+    }
+  }
+  free(s->scripts);
+  interner_free(&s->paths);
+
+  if (s->listener >= 0) {
+    close(s->listener);
+    unlink(s->path);
+  }
+  if (s->epoll >= 0) {
+    close(s->epoll);
+  }
+  if (s->wake >= 0) {
+    close(s->wake);
+  }
+  free(s->path);
+  *s = (server){0};
+}
+
+void server_print_stats(server_stats *stats, FILE *out) {
+  fprintf(out,
+          "[server] connections: %llu, requests: %llu, failed: %llu, "
+          "compiles: %llu\n",
+          (unsigned long long)stats->connections,
+          (unsigned long long)stats->requests,
+          (unsigned long long)stats->failed,
+          (unsigned long long)stats->compiles);
+}
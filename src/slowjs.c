@@ -0,0 +1,186 @@
+#include "slowjs/slowjs.h"
+
+#include <stdlib.h>
+
+#include "slowjs/common.h"
+#include "slowjs/fold.h"
+#include "slowjs/inliner.h"
+#include "slowjs/parse.h"
+#include "slowjs/resolve.h"
+
+slowjs_error slowjs_program_init(slowjs_program *, const char *,
+                                 run_options);
+void slowjs_program_release(slowjs_program *);
+slowjs_error slowjs_script_new(slowjs_program *, run_options,
+                               slowjs_script **);
+slowjs_error slowjs_vm_error(vm_error);
+
+slowjs_error slowjs_program_init(slowjs_program *p, const char *source,
+                                 run_options options) {
+  vector_char text = {0};
+  ast program = {0};
+  uint64_t i = 0;
+  uint32_t function = 0;
+  slowjs_error err = E_SLOWJS_OK;
+
+  if (vector_char_copy(&text, (char *)source, strlen(source) + 1) !=
+      E_VECTOR_OK) {
+    err = E_SLOWJS_MALLOC;
+    goto cleanup;
+  }
+
+  if (parse(text, &program) != E_PARSE_OK) {
+    err = E_SLOWJS_PARSE;
+    goto cleanup;
+  }
+  fold(&program);
+
+  // Interning copies every name, so the ast and source can go once the
+  // program is flat.
+  if (flatten(&program, &p->flat) != E_FLAT_OK ||
+      resolve(&p->flat) != E_RESOLVE_OK) {
+    err = E_SLOWJS_COMPILE;
+    goto cleanup;
+  }
+
+  if (inline_calls(&p->flat, options.inlining,
+                   options.inlining.report ? stderr : 0) != E_INLINE_OK) {
+    err = E_SLOWJS_MALLOC;
+    goto cleanup;
+  }
+
+  p->functions = (uint32_t *)malloc(sizeof(uint32_t) *
+                                    (p->flat.names.names.index + 1));
+  if (p->functions == 0) {
+    err = E_SLOWJS_MALLOC;
+    goto cleanup;
+  }
+  memset(p->functions, 0xff, sizeof(uint32_t) * p->flat.names.names.index);
+  for (i = 0; i < p->flat.globals.index; i++) {
+    function = p->flat.globals.elements[i];
+    p->functions[p->flat.functions.elements[function].name] = function;
+  }
+
+  if (compile(&p->flat, &p->bc) != E_COMPILE_OK) {
+    err = E_SLOWJS_COMPILE;
+    goto cleanup;
+  }
+
+cleanup:
+  ast_free(&program);
+  vector_char_free(&text);
+  return err;
+}
+
+void slowjs_program_release(slowjs_program *p) {
+  if (__atomic_sub_fetch(&p->references, 1, __ATOMIC_ACQ_REL) > 0) {
+    return;
+  }
+
+  bytecode_free(&p->bc);
+  free(p->functions);
+  flat_ast_free(&p->flat);
+  free(p);
+}
+
+// Takes a reference to p, which is dropped again if it fails.
+slowjs_error slowjs_script_new(slowjs_program *p, run_options options,
+                               slowjs_script **out) {
+  slowjs_script *s = 0;
+
+  __atomic_add_fetch(&p->references, 1, __ATOMIC_RELAXED);
+  s = (slowjs_script *)calloc(1, sizeof(slowjs_script));
+  if (s == 0) {
+    slowjs_program_release(p);
+    return E_SLOWJS_MALLOC;
+  }
+  s->program = p;
+
+  if (vm_init(&s->m, options) != E_VM_OK ||
+      vm_load(&s->m, &p->bc) != E_VM_OK) {
+    slowjs_free(s);
+    return E_SLOWJS_MALLOC;
+  }
+
+  *out = s;
+  return E_SLOWJS_OK;
+}
+
+slowjs_error slowjs_compile(const char *source, run_options options,
+                            slowjs_script **out) {
+  slowjs_program *p = 0;
+  slowjs_error err = E_SLOWJS_OK;
+
+  *out = 0;
+  p = (slowjs_program *)calloc(1, sizeof(slowjs_program));
+  if (p == 0) {
+    return E_SLOWJS_MALLOC;
+  }
+
+  // Held until the script has its own reference.
+  p->references = 1;
+  err = slowjs_program_init(p, source, options);
+  if (err == E_SLOWJS_OK) {
+    err = slowjs_script_new(p, options, out);
+  }
+
+  slowjs_program_release(p);
+  return err;
+}
+
+slowjs_error slowjs_call(slowjs_script *s, const char *name, value *args,
+                         uint32_t nargs, value *result) {
+  slowjs_program *p = s->program;
+  uint32_t id = 0, function = 0;
+
+  if (intern_lookup(&p->flat.names, name, strlen(name), &id) !=
+      E_INTERN_OK) {
+    return E_SLOWJS_NOT_FOUND;
+  }
+
+  function = p->functions[id];
+  if (function == UINT32_MAX) {
+    return E_SLOWJS_NOT_FOUND;
+  }
+
+  return slowjs_vm_error(
+      vm_call(&s->m, &p->bc, function, args, nargs, result));
+}
+
+slowjs_error slowjs_vm_error(vm_error err) {
+  switch (err) {
+  case E_VM_OK:
+    return E_SLOWJS_OK;
+  case E_VM_CALL_NONFUNCTION:
+    return E_SLOWJS_CALL_NONFUNCTION;
+  case E_VM_STACK_OVERFLOW:
+    return E_SLOWJS_STACK_OVERFLOW;
+  case E_VM_YIELD:
+    return E_SLOWJS_YIELD;
+  default:
+    return E_SLOWJS_MALLOC;
+  }
+}
+
+void slowjs_set_fuel(slowjs_script *s, uint64_t fuel) { s->m.fuel = fuel; }
+
+slowjs_error slowjs_resume(slowjs_script *s, value *result) {
+  return slowjs_vm_error(vm_resume(&s->m, &s->program->bc, result));
+}
+
+uint64_t slowjs_fuel_used(slowjs_script *s) { return s->m.fuel_used; }
+
+slowjs_error slowjs_clone(slowjs_script *s, slowjs_script **out) {
+  *out = 0;
+  return slowjs_script_new(s->program, s->m.options, out);
+}
+
+void slowjs_free(slowjs_script *s) {
+  if (s == 0) {
+    return;
+  }
+
+  vm_free(&s->m);
+  slowjs_program_release(s->program);
+  free(s);
+}
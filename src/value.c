@@ -0,0 +1,32 @@
+#include "slowjs/value.h"
+
+value_type value_typeof(value v) {
+  if (IS_NUMBER(v)) {
+    return VALUE_NUMBER;
+  }
+
+  if (IS_FUNCTION(v)) {
+    return VALUE_FUNCTION;
+  }
+
+  return IS_BOOL(v) ? VALUE_BOOL : VALUE_NULL;
+}
+
+void value_fprint(value v, FILE *out) {
+  switch (value_typeof(v)) {
+  case VALUE_NUMBER:
+    fprintf(out, "%lf\n", value_number(v));
+    break;
+  case VALUE_BOOL:
+    fprintf(out, "%s\n", v == TRUE_VALUE ? "true" : "false");
+    break;
+  case VALUE_NULL:
+    fprintf(out, "null\n");
+    break;
+  case VALUE_FUNCTION:
+    fprintf(out, "[Function]\n");
+    break;
+  }
+}
+
+void value_print(value v) { value_fprint(v, stdout); }
@@ -0,0 +1,572 @@
+#include "slowjs/vm.h"
+
+#include <stdio.h>
+
+#include "slowjs/common.h"
+#include "slowjs/flat.h"
+#include "slowjs/inliner.h"
+#include "slowjs/resolve.h"
+
+#define READ_OPERAND(x)                                                        \
+  do {                                                                         \
+    memcpy(&(x), ip, BC_OPERAND_SIZE);                                         \
+    ip += BC_OPERAND_SIZE;                                                     \
+  } while (0)
+
+#define DISPATCH() goto *dispatch[*ip++]
+
+// Allocating may collect, which needs the current stack and frames.
+#define SAVE_ROOTS()                                                           \
+  do {                                                                         \
+    m->sp = sp;                                                                \
+    m->frame = frame;                                                          \
+    m->env = e;                                                                \
+  } while (0)
+
+// wrap is number_value or BOOL_VALUE depending on the result. The
+// first time both operands are numbers the op is rewritten in place to
+// its number-only variant.
+#define BINARY_OP(op, wrap, specialized)                                       \
+  do {                                                                         \
+    if (IS_NUMBER(sp[-1]) && IS_NUMBER(sp[-2])) {                              \
+      ip[-1] = specialized;                                                    \
+      m->quicken.quickened++;                                                  \
+    }                                                                          \
+    m->quicken.generic++;                                                      \
+    sp--;                                                                      \
+    sp[-1] = wrap(value_to_number(sp[-1]) op value_to_number(sp[0]));          \
+  } while (0)
+
+// Guards that both operands are still numbers, otherwise rewrites the op
+// back to generic and runs that instead.
+#define NUMBER_OP(op, wrap, generic)                                           \
+  do {                                                                         \
+    if (!IS_NUMBER(sp[-1]) || !IS_NUMBER(sp[-2])) {                            \
+      ip[-1] = generic;                                                        \
+      m->quicken.misses++;                                                     \
+      ip--;                                                                    \
+      DISPATCH();                                                              \
+    }                                                                          \
+    m->quicken.hits++;                                                         \
+    sp--;                                                                      \
+    sp[-1] = wrap(value_number(sp[-1]) op value_number(sp[0]));                \
+  } while (0)
+
+void vm_roots(gc *, void *);
+vm_error vm_prepare(vm *, bytecode *);
+vm_error vm_prepare_jit(vm *, bytecode *);
+vm_error vm_execute(vm *, bytecode *, uint32_t, value *, uint32_t, value *);
+
+vm_error vm_init(vm *m, run_options options) {
+  m->options = options;
+  gc_init(&m->heap, options.gc, vm_roots, m);
+  m->stack_size = VM_STACK_SIZE;
+  m->stack = (value *)malloc(sizeof(value) * m->stack_size);
+  m->frames_size = VM_FRAMES_SIZE;
+  m->frames = (vm_frame *)malloc(sizeof(vm_frame) * m->frames_size);
+  if (m->stack == 0 || m->frames == 0) {
+    vm_free(m);
+    return E_VM_MALLOC;
+  }
+
+  return E_VM_OK;
+}
+
+void vm_free(vm *m) {
+  gc_free(&m->heap);
+  jit_free(&m->jit);
+  free(m->functions);
+  free(m->code);
+  free(m->stack);
+  free(m->frames);
+  m->functions = 0;
+  m->code = 0;
+  m->code_size = 0;
+  m->nfunctions = 0;
+  m->stack = 0;
+  m->frames = 0;
+}
+
+void vm_roots(gc *g, void *data) {
+  vm *m = (vm *)data;
+  vm_frame *frame = 0;
+  value *v = 0;
+
+  for (v = m->stack; v < m->sp; v++) {
+    gc_mark_value(g, *v);
+  }
+
+  for (frame = m->frames; frame < m->frame; frame++) {
+    if (frame->env) {
+      gc_mark_object(g, &frame->env->header);
+    }
+  }
+
+  if (m->env) {
+    gc_mark_object(g, &m->env->header);
+  }
+}
+
+// Copies the code so quickening never changes bc. Top-level functions
+// become values without allocating by pointing at a closure made once
+// per function here.
+vm_error vm_prepare(vm *m, bytecode *bc) {
+  uint8_t *code = 0;
+  uint64_t i = 0;
+
+  if (m->code_size < bc->code.index) {
+    code = (uint8_t *)realloc(m->code, bc->code.index);
+    if (code == 0) {
+      return E_VM_MALLOC;
+    }
+    m->code = code;
+    m->code_size = bc->code.index;
+  }
+  memcpy(m->code, bc->code.elements, bc->code.index);
+
+  if (m->functions && m->nfunctions == bc->functions.index) {
+    return E_VM_OK;
+  }
+
+  free(m->functions);
+  m->nfunctions = bc->functions.index;
+  m->functions = (closure *)calloc(m->nfunctions + 1, sizeof(closure));
+  if (m->functions == 0) {
+    m->nfunctions = 0;
+    return E_VM_MALLOC;
+  }
+
+  for (i = 0; i < m->nfunctions; i++) {
+    m->functions[i].header.type = OBJECT_CLOSURE;
+    m->functions[i].header.color = GC_BLACK;
+    m->functions[i].function = i;
+  }
+
+  return E_VM_OK;
+}
+
+// Starts counting calls for the JIT over. Without support for this
+// machine the program runs in the VM alone.
+vm_error vm_prepare_jit(vm *m, bytecode *bc) {
+  jit_error err = E_JIT_OK;
+
+  if (!m->options.jit.enabled) {
+    return E_VM_OK;
+  }
+
+  err = jit_prepare(&m->jit, m->options.jit, bc->functions.index);
+  if (err == E_JIT_MALLOC) {
+    return E_VM_MALLOC;
+  }
+
+  return E_VM_OK;
+}
+
+vm_error vm_load(vm *m, bytecode *bc) {
+  if (vm_prepare(m, bc) != E_VM_OK || vm_prepare_jit(m, bc) != E_VM_OK) {
+    return E_VM_MALLOC;
+  }
+
+  return E_VM_OK;
+}
+
+vm_error vm_run(vm *m, bytecode *bc, uint32_t function, value *result) {
+  vm_error err = vm_load(m, bc);
+
+  if (err != E_VM_OK) {
+    return err;
+  }
+
+  return vm_call(m, bc, function, 0, 0, result);
+}
+
+vm_error vm_call(vm *m, bytecode *bc, uint32_t function, value *args,
+                 uint32_t nargs, value *result) {
+  m->ip = 0;
+  return vm_execute(m, bc, function, args, nargs, result);
+}
+
+vm_error vm_resume(vm *m, bytecode *bc, value *result) {
+  return vm_execute(m, bc, 0, 0, 0, result);
+}
+
+// Calls within the program do not recurse in C, they push a frame and
+// keep going in the same loop. If the vm yielded it picks up where it
+// was instead of making a new call.
+vm_error vm_execute(vm *m, bytecode *bc, uint32_t function, value *args,
+                    uint32_t nargs, value *result) {
+  static void *dispatch[] = {
+      [BC_CONSTANT] = &&op_constant, [BC_NULL] = &&op_null,
+      [BC_TRUE] = &&op_true,         [BC_FALSE] = &&op_false,
+      [BC_FUNCTION] = &&op_function, [BC_CLOSURE] = &&op_closure,
+      [BC_GET_LOCAL] = &&op_get_local, [BC_ENV] = &&op_env,
+      [BC_GET_ENV] = &&op_get_env,   [BC_SET_ENV] = &&op_set_env,
+      [BC_GET_OUTER] = &&op_get_outer, [BC_ADD] = &&op_add,
+      [BC_SUB] = &&op_sub,           [BC_MUL] = &&op_mul,
+      [BC_DIV] = &&op_div,           [BC_LESS] = &&op_less,
+      [BC_GREATER] = &&op_greater,   [BC_JUMP] = &&op_jump,
+      [BC_JUMP_IF_FALSE] = &&op_jump_if_false, [BC_CALL] = &&op_call,
+      [BC_RETURN] = &&op_return,     [BC_POP] = &&op_pop,
+      [BC_TAIL_CALL] = &&op_tail_call,
+      [BC_ADD_NUMBER] = &&op_add_number, [BC_SUB_NUMBER] = &&op_sub_number,
+      [BC_MUL_NUMBER] = &&op_mul_number, [BC_DIV_NUMBER] = &&op_div_number,
+      [BC_LESS_NUMBER] = &&op_less_number,
+      [BC_GREATER_NUMBER] = &&op_greater_number,
+  };
+  uint8_t *code = 0, *ip = 0;
+  const double *constants = bc->constants.elements;
+  value *sp = m->stack, *base = 0, *stack_end = m->stack + m->stack_size;
+  env *e = 0, *outer = 0;
+  closure *c = 0;
+  vm_frame *frame = m->frames, *frames_end = m->frames + m->frames_size;
+  bc_function *fn = 0;
+  value v = 0;
+  uint32_t operand = 0, slot = 0, argc = 0;
+  // Where fuel_used has to stop for this call to yield.
+  uint64_t limit = m->fuel ? m->fuel_used + m->fuel : UINT64_MAX;
+
+  code = m->code;
+  if (m->ip) {
+    ip = m->ip;
+    base = m->base;
+    sp = m->sp;
+    frame = m->frame;
+    e = m->env;
+    m->ip = 0;
+    DISPATCH();
+  }
+
+  if (nargs >= m->stack_size) {
+    return E_VM_STACK_OVERFLOW;
+  }
+
+  *sp++ = FUNCTION_VALUE(&m->functions[function]);
+  for (argc = 0; argc < nargs; argc++) {
+    *sp++ = args[argc];
+  }
+  m->fuel_used++;
+  goto call;
+
+op_constant:
+  READ_OPERAND(operand);
+  *sp++ = number_value(constants[operand]);
+  DISPATCH();
+
+op_null:
+  *sp++ = NULL_VALUE;
+  DISPATCH();
+
+op_true:
+  *sp++ = TRUE_VALUE;
+  DISPATCH();
+
+op_false:
+  *sp++ = FALSE_VALUE;
+  DISPATCH();
+
+op_function:
+  READ_OPERAND(operand);
+  *sp++ = FUNCTION_VALUE(&m->functions[operand]);
+  DISPATCH();
+
+op_closure:
+  READ_OPERAND(operand);
+  SAVE_ROOTS();
+  c = gc_closure_new(&m->heap, operand, e);
+  if (c == 0) {
+    return E_VM_MALLOC;
+  }
+  *sp++ = FUNCTION_VALUE(c);
+  DISPATCH();
+
+op_get_local:
+  READ_OPERAND(operand);
+  *sp++ = base[operand];
+  DISPATCH();
+
+op_env:
+  // Only the arguments are on the stack at this point.
+  READ_OPERAND(operand);
+  SAVE_ROOTS();
+  e = gc_env_new(&m->heap, AS_CLOSURE(base[-1])->env, operand);
+  if (e == 0) {
+    return E_VM_MALLOC;
+  }
+  for (slot = 0; base + slot < sp; slot++) {
+    e->values[slot] = base[slot];
+    GC_WRITE_BARRIER(&m->heap, base[slot]);
+  }
+  DISPATCH();
+
+op_get_env:
+  READ_OPERAND(operand);
+  *sp++ = e->values[operand];
+  DISPATCH();
+
+op_set_env:
+  READ_OPERAND(operand);
+  e->values[operand] = *--sp;
+  GC_WRITE_BARRIER(&m->heap, *sp);
+  DISPATCH();
+
+op_get_outer:
+  READ_OPERAND(operand);
+  READ_OPERAND(slot);
+  outer = AS_CLOSURE(base[-1])->env;
+  for (; operand > 0; operand--) {
+    outer = outer->parent;
+  }
+  *sp++ = outer->values[slot];
+  DISPATCH();
+
+op_add:
+  BINARY_OP(+, number_value, BC_ADD_NUMBER);
+  DISPATCH();
+
+op_sub:
+  BINARY_OP(-, number_value, BC_SUB_NUMBER);
+  DISPATCH();
+
+op_mul:
+  BINARY_OP(*, number_value, BC_MUL_NUMBER);
+  DISPATCH();
+
+op_div:
+  BINARY_OP(/, number_value, BC_DIV_NUMBER);
+  DISPATCH();
+
+op_less:
+  BINARY_OP(<, BOOL_VALUE, BC_LESS_NUMBER);
+  DISPATCH();
+
+op_greater:
+  BINARY_OP(>, BOOL_VALUE, BC_GREATER_NUMBER);
+  DISPATCH();
+
+op_add_number:
+  NUMBER_OP(+, number_value, BC_ADD);
+  DISPATCH();
+
+op_sub_number:
+  NUMBER_OP(-, number_value, BC_SUB);
+  DISPATCH();
+
+op_mul_number:
+  NUMBER_OP(*, number_value, BC_MUL);
+  DISPATCH();
+
+op_div_number:
+  NUMBER_OP(/, number_value, BC_DIV);
+  DISPATCH();
+
+op_less_number:
+  NUMBER_OP(<, BOOL_VALUE, BC_LESS);
+  DISPATCH();
+
+op_greater_number:
+  NUMBER_OP(>, BOOL_VALUE, BC_GREATER);
+  DISPATCH();
+
+op_jump:
+  READ_OPERAND(operand);
+  ip = code + operand;
+  DISPATCH();
+
+op_jump_if_false:
+  READ_OPERAND(operand);
+  sp--;
+  if (!value_truthy(*sp)) {
+    ip = code + operand;
+  }
+  DISPATCH();
+
+op_pop:
+  sp--;
+  DISPATCH();
+
+op_call:
+  READ_OPERAND(argc);
+  if (m->fuel_used == limit) {
+    goto yield;
+  }
+  m->fuel_used++;
+call:
+  v = sp[-(int64_t)argc - 1];
+  if (!IS_FUNCTION(v)) {
+    return E_VM_CALL_NONFUNCTION;
+  }
+
+  // Hot functions may run as machine code instead, see jit.h. The call
+  // that starts the program has no frame to come back to.
+  fn = &bc->functions.elements[AS_CLOSURE(v)->function];
+  if (m->jit.functions && !m->fuel && frame != m->frames &&
+      jit_call(&m->jit, bc, code, AS_CLOSURE(v)->function, sp - argc, argc,
+               &v)) {
+    sp -= argc;
+    sp[-1] = v;
+    DISPATCH();
+  }
+
+  if (frame == frames_end ||
+      (uint64_t)(stack_end - sp) < fn->nlocals + fn->max_stack) {
+    return E_VM_STACK_OVERFLOW;
+  }
+
+  frame->ip = ip;
+  frame->base = base;
+  frame->env = e;
+  frame++;
+
+  // Extra arguments are dropped, missing ones and the body's locals
+  // start out null.
+  for (; argc > fn->nparameters; argc--) {
+    sp--;
+  }
+  for (; argc < fn->nlocals; argc++) {
+    *sp++ = NULL_VALUE;
+  }
+
+  base = sp - fn->nlocals;
+  ip = code + fn->code;
+  DISPATCH();
+
+op_tail_call:
+  READ_OPERAND(argc);
+  if (m->fuel_used == limit) {
+    goto yield;
+  }
+  m->fuel_used++;
+  v = sp[-(int64_t)argc - 1];
+  if (!IS_FUNCTION(v)) {
+    return E_VM_CALL_NONFUNCTION;
+  }
+
+  fn = &bc->functions.elements[AS_CLOSURE(v)->function];
+  if (m->jit.functions && !m->fuel &&
+      jit_call(&m->jit, bc, code, AS_CLOSURE(v)->function, sp - argc, argc,
+               &v)) {
+    sp -= argc;
+    sp[-1] = v;
+    goto op_return;
+  }
+
+  for (; argc > fn->nparameters; argc--) {
+    sp--;
+  }
+
+  // The callee and its arguments take the place of the current callee
+  // and its locals, and the frame that called it is returned to.
+  memmove(base - 1, sp - argc - 1, sizeof(value) * (argc + 1));
+  sp = base + argc;
+  if ((uint64_t)(stack_end - sp) < fn->nlocals + fn->max_stack) {
+    return E_VM_STACK_OVERFLOW;
+  }
+
+  for (; argc < fn->nlocals; argc++) {
+    *sp++ = NULL_VALUE;
+  }
+
+  ip = code + fn->code;
+  DISPATCH();
+
+op_return:
+  v = sp[-1];
+  // Drop the locals and the callee itself.
+  sp = base - 1;
+  *sp++ = v;
+
+  frame--;
+  ip = frame->ip;
+  base = frame->base;
+  e = frame->env;
+  if (frame == m->frames) {
+    *result = v;
+    return E_VM_OK;
+  }
+  DISPATCH();
+
+  // The call op is run again when resumed, so nothing of it is undone.
+yield:
+  SAVE_ROOTS();
+  m->ip = ip - 1 - BC_OPERAND_SIZE;
+  m->base = base;
+  return E_VM_YIELD;
+}
+
+vm_error vm_compile(ast program, run_options options, flat_ast *f,
+                    bytecode *bc) {
+  if (flatten(&program, f) != E_FLAT_OK) {
+    LOG_ERROR("vm", "Failed to flatten program", 0);
+    return E_VM_COMPILE;
+  }
+
+  if (resolve(f) != E_RESOLVE_OK) {
+    return E_VM_RESOLVE;
+  }
+
+  if (inline_calls(f, options.inlining,
+                   options.inlining.report ? stderr : 0) != E_INLINE_OK) {
+    return E_VM_MALLOC;
+  }
+
+  if (compile(f, bc) != E_COMPILE_OK) {
+    LOG_ERROR("vm", "Failed to compile program", 0);
+    return E_VM_COMPILE;
+  }
+
+  return E_VM_OK;
+}
+
+vm_error vm_run_main(bytecode *bc, run_options options) {
+  vm m = {0};
+  value result = 0;
+  vm_error err = E_VM_OK;
+
+  if (bc->main == UINT32_MAX) {
+    LOG_ERROR("vm", "Expected main function", 0);
+    return E_VM_NO_MAIN;
+  }
+
+  err = vm_init(&m, options);
+  if (err != E_VM_OK) {
+    goto cleanup;
+  }
+
+  err = vm_run(&m, bc, bc->main, &result);
+  if (err == E_VM_STACK_OVERFLOW) {
+    fprintf(stderr, "RangeError: Maximum call stack size exceeded\n");
+  }
+  if (err != E_VM_OK) {
+    goto cleanup;
+  }
+
+  value_fprint(result, options.out ? options.out : stdout);
+
+cleanup:
+  if (options.gc.stats) {
+    gc_print_stats(&m.heap, stderr);
+  }
+  if (options.quicken_stats) {
+    quicken_print_stats(&m.quicken, stderr);
+  }
+  if (options.jit.stats) {
+    jit_print_stats(&m.jit, stderr);
+  }
+  vm_free(&m);
+  return err;
+}
+
+vm_error vm_interpret(ast program, run_options options) {
+  flat_ast f = {0};
+  bytecode bc = {0};
+  vm_error err = E_VM_OK;
+
+  err = vm_compile(program, options, &f, &bc);
+  if (err == E_VM_OK) {
+    err = vm_run_main(&bc, options);
+  }
+
+  bytecode_free(&bc);
+  flat_ast_free(&f);
+  return err;
+}
@@ -0,0 +1,70 @@
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/arena.h"
+}
+
+TEST(arena, alloc_aligned) {
+  arena a = {0};
+  void *p = 0;
+  uint64_t i = 0;
+
+  for (i = 1; i < 100; i++) {
+    p = arena_alloc(&a, i);
+    ASSERT_NE(nullptr, p);
+    ASSERT_EQ(0, (uintptr_t)p % 16);
+    memset(p, 0xff, i);
+  }
+
+  ASSERT_EQ(99, a.allocations);
+  ASSERT_EQ(1, a.chunks);
+
+  arena_free(&a);
+  ASSERT_EQ(nullptr, a.head);
+  ASSERT_EQ(0, a.allocations);
+}
+
+TEST(arena, alloc_many_chunks) {
+  arena a = {0};
+  uint64_t i = 0;
+
+  for (i = 0; i < 10000; i++) {
+    ASSERT_NE(nullptr, arena_alloc(&a, 64));
+  }
+
+  ASSERT_EQ(10000, a.allocations);
+  ASSERT_LT(1, a.chunks);
+  ASSERT_GT(100, a.chunks);
+
+  arena_free(&a);
+}
+
+TEST(arena, alloc_oversized) {
+  arena a = {0};
+  char *small = 0, *big = 0, *after = 0;
+
+  small = (char *)arena_alloc(&a, 16);
+  big = (char *)arena_alloc(&a, 1024 * 1024);
+  ASSERT_NE(nullptr, big);
+  memset(big, 0xff, 1024 * 1024);
+
+  // The oversized chunk does not displace the current one.
+  after = (char *)arena_alloc(&a, 16);
+  ASSERT_EQ(small + 16, after);
+  ASSERT_EQ(2, a.chunks);
+
+  arena_free(&a);
+}
+
+TEST(arena, copy) {
+  arena a = {0};
+  const char test[] = "foobar";
+  char *out = 0;
+
+  out = (char *)arena_copy(&a, test, sizeof(test));
+  ASSERT_STREQ(test, out);
+
+  arena_free(&a);
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/batch.h"
+}
+
+// Runs paths as a batch and returns what it prints.
+static std::string batch_output(char **paths, uint64_t npaths,
+                                batch_options options, batch_stats *stats) {
+  char *output = 0;
+  size_t size = 0;
+  FILE *out = open_memstream(&output, &size);
+  std::string result = "";
+
+  EXPECT_NE(nullptr, out);
+  EXPECT_EQ(E_BATCH_OK, batch_run(paths, npaths, options, out, stats));
+  fclose(out);
+  result = std::string(output, size);
+  free(output);
+  return result;
+}
+
+TEST(batch, run) {
+  char bad[] = "/tmp/slowjs-batch-XXXXXX.js";
+  std::string fib = std::string(EXAMPLES_DIR) + "/fib.js";
+  std::string plus = std::string(EXAMPLES_DIR) + "/plus.js";
+  std::string missing = std::string(EXAMPLES_DIR) + "/missing.js";
+  const char *failing = "function main() { return 1(); }";
+  char *paths[5] = {};
+  batch_options options = {};
+  batch_stats stats = {};
+  std::string expected = "";
+  uint32_t threads[] = {1, 2, 8};
+  uint64_t i = 0;
+  int fd = mkstemps(bad, 3);
+
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ((ssize_t)strlen(failing), write(fd, failing, strlen(failing)));
+  close(fd);
+
+  paths[0] = (char *)fib.c_str();
+  paths[1] = bad;
+  paths[2] = (char *)missing.c_str();
+  paths[3] = (char *)plus.c_str();
+  paths[4] = (char *)fib.c_str();
+  expected = fib + ": 6765.000000\n" + bad +
+             ": Error interpreting program.\n" + missing +
+             ": Error reading file.\n" + plus + ": 4.000000\n" + fib +
+             ": 6765.000000\n";
+
+  // Results come out in order and the failures do not stop the rest,
+  // whichever thread runs what.
+  for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+    options.threads = threads[i];
+    options.vm = i % 2;
+    ASSERT_EQ(expected, batch_output(paths, 5, options, &stats));
+    ASSERT_EQ(5, stats.files);
+    ASSERT_EQ(2, stats.failed);
+    ASSERT_GE(stats.wall, 0);
+  }
+
+  unlink(bad);
+}
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/cache.h"
+#include "slowjs/fold.h"
+#include "slowjs/parse.h"
+#include "slowjs/vm.h"
+}
+
+static const char *cache_test_source =
+    "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+    "function adder(a) { function inner(b) { return a + b; } return inner; }\n"
+    "function main() { return adder(1 / 2)(fib(15)); }";
+
+static void cache_test_compile(vector_char *source, run_options options,
+                               flat_ast *f, bytecode *bc) {
+  ast program = {};
+
+  ASSERT_EQ(E_PARSE_OK, parse(*source, &program));
+  fold(&program);
+  ASSERT_EQ(E_VM_OK, vm_compile(program, options, f, bc));
+  ast_free(&program);
+}
+
+// What running main of bc prints.
+static std::string cache_test_run(bytecode *bc, run_options options) {
+  char *output = 0;
+  size_t size = 0;
+  std::string printed = "";
+
+  options.out = open_memstream(&output, &size);
+  EXPECT_EQ(E_VM_OK, vm_run_main(bc, options));
+  fclose(options.out);
+  printed = std::string(output, size);
+  free(output);
+  return printed;
+}
+
+// The only file in dir.
+static std::string cache_test_image(const char *dir) {
+  std::string command = std::string("ls ") + dir + "/*.image";
+  char path[512] = {};
+  FILE *ls = popen(command.c_str(), "r");
+
+  EXPECT_NE(nullptr, fgets(path, sizeof(path), ls));
+  pclose(ls);
+  path[strcspn(path, "\n")] = 0;
+  return path;
+}
+
+TEST(cache, round_trip) {
+  char dir[] = "/tmp/slowjs-cache-XXXXXX";
+  std::string cache = "", path = "";
+  vector_char source = {};
+  run_options options = {};
+  flat_ast f = {};
+  bytecode bc = {};
+  cache_image image = {};
+
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  cache = std::string(dir) + "/cache";
+  ASSERT_EQ(E_VECTOR_OK,
+            vector_char_copy(&source, (char *)cache_test_source,
+                             strlen(cache_test_source)));
+  options.inlining.max_size = INLINE_DEFAULT_MAX_SIZE;
+  cache_test_compile(&source, options, &f, &bc);
+
+  ASSERT_EQ(E_CACHE_MISS, cache_load(cache.c_str(), &source, options, &image));
+  ASSERT_EQ(E_CACHE_OK, cache_store(cache.c_str(), &source, options, &bc));
+  ASSERT_EQ(E_CACHE_OK, cache_load(cache.c_str(), &source, options, &image));
+
+  ASSERT_EQ(bc.main, image.bc.main);
+  ASSERT_EQ(bc.code.index, image.bc.code.index);
+  ASSERT_EQ(0, memcmp(bc.code.elements, image.bc.code.elements,
+                      bc.code.index));
+  ASSERT_EQ(bc.constants.index, image.bc.constants.index);
+  ASSERT_EQ(0, memcmp(bc.constants.elements, image.bc.constants.elements,
+                      sizeof(double) * bc.constants.index));
+  ASSERT_EQ(bc.functions.index, image.bc.functions.index);
+  ASSERT_EQ(0, memcmp(bc.functions.elements, image.bc.functions.elements,
+                      sizeof(bc_function) * bc.functions.index));
+
+  // Runs from the mapping, which is read only, with and without the JIT.
+  ASSERT_EQ("610.500000\n", cache_test_run(&bc, options));
+  ASSERT_EQ("610.500000\n", cache_test_run(&image.bc, options));
+  options.jit.enabled = 1;
+  ASSERT_EQ("610.500000\n", cache_test_run(&image.bc, options));
+  cache_image_free(&image);
+
+  path = cache_test_image(cache.c_str());
+  unlink(path.c_str());
+  rmdir(cache.c_str());
+  rmdir(dir);
+  bytecode_free(&bc);
+  flat_ast_free(&f);
+  vector_char_free(&source);
+}
+
+TEST(cache, misses) {
+  char dir[] = "/tmp/slowjs-cache-XXXXXX";
+  std::string path = "";
+  vector_char source = {};
+  run_options options = {};
+  flat_ast f = {};
+  bytecode bc = {};
+  cache_image image = {};
+  FILE *file = 0;
+  uint32_t version = CACHE_VERSION + 1;
+
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  ASSERT_EQ(E_VECTOR_OK,
+            vector_char_copy(&source, (char *)cache_test_source,
+                             strlen(cache_test_source)));
+  cache_test_compile(&source, options, &f, &bc);
+  ASSERT_EQ(E_CACHE_OK, cache_store(dir, &source, options, &bc));
+  ASSERT_EQ(E_CACHE_OK, cache_load(dir, &source, options, &image));
+  cache_image_free(&image);
+  path = cache_test_image(dir);
+
+  // Compiled with other options.
+  options.inlining.max_size = 1;
+  ASSERT_EQ(E_CACHE_MISS, cache_load(dir, &source, options, &image));
+  options.inlining.max_size = 0;
+
+  // Any change to the source.
+  source.elements[0] = 'F';
+  ASSERT_EQ(E_CACHE_MISS, cache_load(dir, &source, options, &image));
+  source.elements[0] = 'f';
+  ASSERT_EQ(E_CACHE_OK, cache_load(dir, &source, options, &image));
+  cache_image_free(&image);
+
+  // Written by another version.
+  file = fopen(path.c_str(), "r+b");
+  ASSERT_NE(nullptr, file);
+  fseek(file, 8, SEEK_SET);
+  fwrite(&version, sizeof(version), 1, file);
+  fclose(file);
+  ASSERT_EQ(E_CACHE_MISS, cache_load(dir, &source, options, &image));
+
+  // Cut short.
+  ASSERT_EQ(E_CACHE_OK, cache_store(dir, &source, options, &bc));
+  ASSERT_EQ(0, truncate(path.c_str(), 100));
+  ASSERT_EQ(E_CACHE_MISS, cache_load(dir, &source, options, &image));
+  ASSERT_EQ(0, truncate(path.c_str(), 10));
+  ASSERT_EQ(E_CACHE_MISS, cache_load(dir, &source, options, &image));
+  ASSERT_EQ(nullptr, image.map);
+
+  unlink(path.c_str());
+  rmdir(dir);
+  bytecode_free(&bc);
+  flat_ast_free(&f);
+  vector_char_free(&source);
+}
@@ -0,0 +1,180 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/emit.h"
+#include "slowjs/file.h"
+#include "slowjs/fold.h"
+#include "slowjs/interpret.h"
+#include "slowjs/parse.h"
+}
+
+// Emits raw_source as C, builds it with the system compiler and returns
+// what it prints, or what the tree walker prints if interpret is set.
+static std::string emit_run(const char *raw_source, run_options options,
+                            bool interpret_it) {
+  vector_char source = {};
+  ast program = {};
+  char dir[] = "/tmp/slowjs-emit-XXXXXX";
+  std::string c = "", binary = "", output = "";
+  FILE *stream = 0;
+  char buffer[256] = {};
+  size_t read = 0;
+
+  EXPECT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  EXPECT_EQ(E_PARSE_OK, parse(source, &program));
+  fold(&program);
+
+  if (interpret_it) {
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(E_INTERPRET_OK, interpret(program, options));
+    output = testing::internal::GetCapturedStdout();
+    goto cleanup;
+  }
+
+  EXPECT_NE(nullptr, mkdtemp(dir));
+  c = std::string(dir) + "/program.c";
+  binary = std::string(dir) + "/program";
+
+  stream = fopen(c.c_str(), "w");
+  EXPECT_NE(nullptr, stream);
+  EXPECT_EQ(E_EMIT_OK, emit_c(program, options, stream));
+  fclose(stream);
+
+  EXPECT_EQ(0, system(("cc -O2 -o " + binary + " " + c).c_str()));
+  stream = popen(binary.c_str(), "r");
+  EXPECT_NE(nullptr, stream);
+  while ((read = fread(buffer, 1, sizeof(buffer), stream)) > 0) {
+    output.append(buffer, read);
+  }
+  EXPECT_EQ(0, pclose(stream));
+
+  unlink(binary.c_str());
+  unlink(c.c_str());
+  rmdir(dir);
+
+cleanup:
+  ast_free(&program);
+  vector_char_free(&source);
+  return output;
+}
+
+// The compiled program has to print exactly what the interpreter does,
+// with and without inlining.
+static void emit_compare(const char *source) {
+  run_options options = {};
+  uint32_t max_sizes[] = {0, INLINE_DEFAULT_MAX_SIZE};
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(max_sizes) / sizeof(max_sizes[0]); i++) {
+    options.inlining.max_size = max_sizes[i];
+    ASSERT_EQ(emit_run(source, options, true),
+              emit_run(source, options, false))
+        << source << "\nmax size " << max_sizes[i];
+  }
+}
+
+// Without a C compiler there is nothing to compare against.
+static bool emit_have_cc() {
+  return system("cc --version > /dev/null 2>&1") == 0;
+}
+
+TEST(emit, examples) {
+  DIR *dir = 0;
+  struct dirent *entry = 0;
+  std::string path = "";
+  vector_char source = {};
+  uint64_t compared = 0;
+
+  if (!emit_have_cc()) {
+    GTEST_SKIP();
+  }
+
+  dir = opendir(EXAMPLES_DIR);
+  ASSERT_NE(nullptr, dir);
+  while ((entry = readdir(dir)) != 0) {
+    path = entry->d_name;
+    if (path.size() < 3 || path.substr(path.size() - 3) != ".js") {
+      continue;
+    }
+
+    path = std::string(EXAMPLES_DIR) + "/" + path;
+    printf("Testing: %s\n", path.c_str());
+    ASSERT_EQ(E_FILE_OK, read_file((char *)path.c_str(), &source));
+    emit_compare(std::string(source.elements, source.index).c_str());
+    vector_char_free(&source);
+    source = {};
+    compared++;
+  }
+  closedir(dir);
+
+  ASSERT_GT(compared, 0);
+}
+
+TEST(emit, differential) {
+  const char *tests[] = {
+      "function main() { return 1 / 3 + 1 / 10; }",
+      "function main() { return 0 / 0; }",
+      "function main() { return 0 - 1 / 0; }",
+      "function main() { return 1 < 2; }",
+      "function nothing() { }\n"
+      "function main() { return nothing(); }",
+      "function f() { return 1; }\n"
+      "function main() { return f; }",
+      // Missing arguments are null and extra ones are dropped.
+      "function f(a, b) { return a + b; }\n"
+      "function main() { return f(1) + f(1, 2, 3) * 10 + f() * 100; }",
+      "function add(a) { function inner(b) { return a + b; } return inner; }\n"
+      "function twice(f, x) { return f(f(x)); }\n"
+      "function main() { return twice(add(3), 4); }",
+      // Reaches two functions out.
+      "function outer(a) {\n"
+      "  function mid(b) {\n"
+      "    function inner(c) { return a + b * c; }\n"
+      "    return inner;\n"
+      "  }\n"
+      "  return mid(2)(3) + mid(a)(1);\n"
+      "}\n"
+      "function main() { return outer(5); }",
+      "function even(n) { return n < 1 ? true : odd(n - 1); }\n"
+      "function odd(n) { return n < 1 ? false : even(n - 1); }\n"
+      "function main() { return even(100001); }",
+      "function count(n, acc) {\n"
+      "  return n < 1 ? acc : count(n - 1, acc + n / 2);\n"
+      "}\n"
+      "function main() { return count(1000000, 0); }",
+  };
+  uint64_t i = 0;
+
+  if (!emit_have_cc()) {
+    GTEST_SKIP();
+  }
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    emit_compare(tests[i]);
+  }
+}
+
+TEST(emit, errors) {
+  vector_char source = {};
+  ast program = {};
+  const char *raw_source = "function f() { return 1; }";
+  FILE *out = fopen("/dev/null", "w");
+
+  ASSERT_NE(nullptr, out);
+  ASSERT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  ASSERT_EQ(E_PARSE_OK, parse(source, &program));
+  ASSERT_EQ(E_EMIT_NO_MAIN, emit_c(program, {}, out));
+  fclose(out);
+
+  ast_free(&program);
+  vector_char_free(&source);
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/flat.h"
+#include "slowjs/intern.h"
+#include "slowjs/parse.h"
+}
+
+TEST(flat, node_size) { ASSERT_EQ(12, sizeof(flat_node)); }
+
+TEST(flat, intern) {
+  interner names = {};
+  uint32_t a = 0, b = 0, c = 0, i = 0;
+  char name[16] = {0};
+
+  ASSERT_EQ(E_INTERN_OK, intern(&names, "main", 4, &a));
+  ASSERT_EQ(E_INTERN_OK, intern(&names, "sum", 3, &b));
+  ASSERT_EQ(E_INTERN_OK, intern(&names, "main", 4, &c));
+  ASSERT_NE(a, b);
+  ASSERT_EQ(a, c);
+  ASSERT_STREQ("sum", interned_name(&names, b));
+
+  ASSERT_EQ(E_INTERN_NOT_FOUND, intern_lookup(&names, "mai", 3, &c));
+  ASSERT_EQ(E_INTERN_OK, intern_lookup(&names, "sum", 3, &c));
+  ASSERT_EQ(b, c);
+
+  // Force the table to grow.
+  for (i = 0; i < 1000; i++) {
+    snprintf(name, sizeof(name), "n%u", i);
+    ASSERT_EQ(E_INTERN_OK, intern(&names, name, strlen(name), &c));
+    ASSERT_EQ(i + 2, c);
+  }
+
+  ASSERT_EQ(E_INTERN_OK, intern_lookup(&names, "n500", 4, &c));
+  ASSERT_EQ(502, c);
+  ASSERT_EQ(E_INTERN_OK, intern_lookup(&names, "main", 4, &c));
+  ASSERT_EQ(a, c);
+
+  interner_free(&names);
+}
+
+TEST(flat, flatten) {
+  ast program = {};
+  flat_ast f = {};
+  vector_char source = {};
+  const char raw_source[] = "function sum(a, b) { return a + b * 2; }\n"
+                            "function main() { return sum(1, 3); }";
+  flat_function *fn = 0;
+  flat_node n = {}, left = {}, right = {};
+  uint32_t main = 0;
+
+  ASSERT_EQ(E_VECTOR_OK,
+            vector_char_copy(&source, (char *)raw_source, sizeof(raw_source)));
+  ASSERT_EQ(E_PARSE_OK, parse(source, &program));
+  ASSERT_EQ(E_FLAT_OK, flatten(&program, &f));
+
+  ASSERT_EQ(2, f.declarations.index);
+  ASSERT_EQ(2, f.functions.index);
+
+  fn = &f.functions.elements[f.declarations.elements[0]];
+  ASSERT_STREQ("sum", interned_name(&f.names, fn->name));
+  ASSERT_EQ(2, fn->nparameters);
+  ASSERT_STREQ("a",
+               interned_name(&f.names, f.extras.elements[fn->parameters]));
+  ASSERT_STREQ("b",
+               interned_name(&f.names, f.extras.elements[fn->parameters + 1]));
+  ASSERT_EQ(1, fn->nstatements);
+
+  // return a + (b * 2)
+  n = f.nodes.elements[f.extras.elements[fn->body]];
+  ASSERT_EQ(FLAT_RETURN, n.type);
+  n = f.nodes.elements[n.a];
+  ASSERT_EQ(FLAT_OP, n.type);
+  ASSERT_EQ(OP_PLUS, n.op);
+  left = f.nodes.elements[n.a];
+  right = f.nodes.elements[n.b];
+  ASSERT_EQ(FLAT_IDENTIFIER, left.type);
+  ASSERT_EQ(f.extras.elements[fn->parameters], left.a);
+  ASSERT_EQ(FLAT_OP, right.type);
+  ASSERT_EQ(OP_TIMES, right.op);
+  ASSERT_EQ(FLAT_NUMBER, f.nodes.elements[right.b].type);
+  ASSERT_EQ(2, flat_number(f.nodes.elements[right.b]));
+
+  // return sum(1, 3)
+  fn = &f.functions.elements[f.declarations.elements[1]];
+  ASSERT_EQ(E_INTERN_OK, intern_lookup(&f.names, "main", 4, &main));
+  ASSERT_EQ(main, fn->name);
+  n = f.nodes.elements[f.extras.elements[fn->body]];
+  n = f.nodes.elements[n.a];
+  ASSERT_EQ(FLAT_CALL, n.type);
+  ASSERT_EQ(2, n.count);
+  ASSERT_EQ(f.functions.elements[0].name, f.nodes.elements[n.a].a);
+  ASSERT_EQ(1, flat_number(f.nodes.elements[f.extras.elements[n.b]]));
+  ASSERT_EQ(3, flat_number(f.nodes.elements[f.extras.elements[n.b + 1]]));
+
+  flat_ast_free(&f);
+  ast_free(&program);
+  vector_char_free(&source);
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/fold.h"
+#include "slowjs/parse.h"
+}
+
+// Folds the body of `function main() { return <expression>; }` and
+// returns it printed.
+std::string fold_return(const char *expression, uint64_t *folded) {
+  std::string raw = std::string("function main() { return ") + expression +
+                    "; }",
+              printed = "";
+  vector_char source = {};
+  ast program = {};
+  char *out = 0;
+  size_t out_size = 0;
+  FILE *stream = 0;
+
+  EXPECT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw.c_str(),
+                                          raw.size() + 1));
+  EXPECT_EQ(E_PARSE_OK, parse(source, &program));
+
+  *folded = fold(&program);
+
+  stream = open_memstream(&out, &out_size);
+  ast_print(&program, stream);
+  fclose(stream);
+  printed = out;
+
+  free(out);
+  ast_free(&program);
+  vector_char_free(&source);
+  return printed;
+}
+
+TEST(fold, expressions) {
+  struct test {
+    const char *in;
+    const char *out;
+    uint64_t folded;
+  };
+  struct test tests[] = {
+      {"1 + 3", "4", 1},
+      {"2 * 3 + 1", "7", 2},
+      {"1 < 2", "true", 1},
+      {"2 > 3", "false", 1},
+      {"true + null", "1", 1},
+      {"1 / 0", "Infinity", 1},
+      {"0 / 0", "NaN", 1},
+      {"1 / 3", "0.33333333333333331", 1},
+      {"1 < 2 ? a : b", "a", 2},
+      {"null ? a : 1 + 1", "2", 2},
+      // Identities only apply when the operand is known to be a number,
+      // a might be a boolean.
+      {"(a + b) * 1", "a + b", 1},
+      {"1 * (a - b)", "a - b", 1},
+      {"(a * b) / 1", "a * b", 1},
+      {"(a / b) - 0", "a / b", 1},
+      {"a * 1", "a * 1", 0},
+      {"(a < b) * 1", "(a < b) * 1", 0},
+      // -0 + 0 is 0, not -0.
+      {"(a - b) + 0", "(a - b) + 0", 0},
+      {"f(1 + 2, a)", "f(3, a)", 1},
+  };
+  uint64_t i = 0, folded = 0;
+  std::string expected = "";
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    printf("Testing: `%s`\n", tests[i].in);
+    expected = std::string("function main() {\n  return ") + tests[i].out +
+               ";\n}\n";
+    ASSERT_EQ(expected, fold_return(tests[i].in, &folded));
+    ASSERT_EQ(tests[i].folded, folded);
+  }
+}
@@ -0,0 +1,152 @@
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/compile.h"
+#include "slowjs/flat.h"
+#include "slowjs/gc.h"
+#include "slowjs/parse.h"
+#include "slowjs/resolve.h"
+#include "slowjs/vm.h"
+}
+
+struct gc_test_roots {
+  value values[4];
+  uint64_t count;
+};
+
+static void gc_test_mark(gc *g, void *data) {
+  gc_test_roots *roots = (gc_test_roots *)data;
+  uint64_t i = 0;
+
+  for (i = 0; i < roots->count; i++) {
+    gc_mark_value(g, roots->values[i]);
+  }
+}
+
+TEST(gc, collect) {
+  gc_test_roots roots = {};
+  gc g = {};
+  env *outer = 0, *inner = 0, *garbage = 0;
+  closure *c = 0;
+  uint64_t live = 0;
+
+  gc_init(&g, gc_options{}, gc_test_mark, &roots);
+
+  // A closure keeps its env and that env's parents alive, through both
+  // the parent pointer and closures stored in slots.
+  outer = gc_env_new(&g, 0, 2);
+  inner = gc_env_new(&g, outer, 1);
+  garbage = gc_env_new(&g, outer, 64);
+  ASSERT_NE(nullptr, garbage);
+  c = gc_closure_new(&g, 0, inner);
+  outer->values[0] = FUNCTION_VALUE(gc_closure_new(&g, 1, 0));
+  outer->values[1] = number_value(1);
+  live = g.bytes - (sizeof(env) + sizeof(value) * 64);
+
+  roots.values[roots.count++] = FUNCTION_VALUE(c);
+  gc_collect(&g);
+  ASSERT_EQ(1, g.stats.collections);
+  ASSERT_EQ(live, g.bytes);
+  ASSERT_EQ(sizeof(env) + sizeof(value) * 64, g.stats.bytes_freed);
+  ASSERT_EQ(1, value_number(outer->values[1]));
+  ASSERT_EQ(inner, c->env);
+
+  roots.count = 0;
+  gc_collect(&g);
+  ASSERT_EQ(0, g.bytes);
+  ASSERT_EQ(nullptr, g.objects);
+
+  gc_free(&g);
+}
+
+TEST(gc, write_barrier) {
+  gc_test_roots roots = {};
+  gc g = {};
+  env *chain = 0, *last = 0, *fresh = 0;
+  closure *c = 0;
+  uint64_t i = 0;
+
+  gc_init(&g, gc_options{}, gc_test_mark, &roots);
+
+  // c is only reachable through the far end of a long chain, so marking
+  // does not get to it in the first step.
+  last = gc_env_new(&g, 0, 1);
+  c = gc_closure_new(&g, 0, 0);
+  last->values[0] = FUNCTION_VALUE(c);
+  chain = last;
+  for (i = 0; i < 1000; i++) {
+    chain = gc_env_new(&g, chain, 0);
+  }
+  roots.values[roots.count++] = FUNCTION_VALUE(gc_closure_new(&g, 0, chain));
+
+  gc_step(&g, 1);
+  ASSERT_EQ(GC_MARK, g.phase);
+  ASSERT_EQ(GC_WHITE, c->header.color);
+
+  // Move c from the unmarked part of the heap into an object allocated
+  // while marking, which is black and is not traced again.
+  fresh = gc_env_new(&g, 0, 1);
+  ASSERT_EQ(GC_BLACK, fresh->header.color);
+  roots.values[roots.count++] = FUNCTION_VALUE(gc_closure_new(&g, 0, fresh));
+  fresh->values[0] = FUNCTION_VALUE(c);
+  GC_WRITE_BARRIER(&g, fresh->values[0]);
+  last->values[0] = NULL_VALUE;
+
+  gc_step(&g, 0);
+  ASSERT_EQ(GC_IDLE, g.phase);
+  ASSERT_EQ(0, g.stats.bytes_freed);
+  ASSERT_EQ(GC_WHITE, c->header.color);
+
+  gc_free(&g);
+}
+
+TEST(gc, vm_bounded) {
+  // Every leaf call allocates an env and a closure that are garbage once
+  // it returns, while the closure made by adder has to survive.
+  const char *raw_source =
+      "function leaf(g) { function h() { return g(1); } return h(); }\n"
+      "function tree(d, g) {\n"
+      "  return d < 1 ? leaf(g) : tree(d - 1, g) + tree(d - 1, g);\n"
+      "}\n"
+      "function adder(a) { function f(b) { return a + b; } return f; }\n"
+      "function main() { return tree(16, adder(1)); }";
+  // Full collections, then steps too short to finish a cycle in one.
+  run_options options[2] = {};
+  vector_char source = {};
+  ast program = {};
+  flat_ast flat = {};
+  bytecode bc = {};
+  vm m = {};
+  value result = 0;
+  uint64_t i = 0;
+
+  ASSERT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  ASSERT_EQ(E_PARSE_OK, parse(source, &program));
+  ASSERT_EQ(E_FLAT_OK, flatten(&program, &flat));
+  ASSERT_EQ(E_RESOLVE_OK, resolve(&flat));
+  ASSERT_EQ(E_COMPILE_OK, compile(&flat, &bc));
+  options[1].gc.max_pause_us = 1;
+
+  for (i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+    ASSERT_EQ(E_VM_OK, vm_init(&m, options[i]));
+    ASSERT_EQ(E_VM_OK, vm_run(&m, &bc, bc.main, &result));
+    ASSERT_EQ(2 << 16, value_number(result));
+
+    ASSERT_LT(0, m.heap.stats.collections);
+    ASSERT_LE(m.heap.bytes, (uint64_t)GC_MIN_THRESHOLD * 2);
+    ASSERT_EQ(m.heap.stats.bytes_allocated,
+              m.heap.stats.bytes_freed + m.heap.bytes);
+    if (options[i].gc.max_pause_us) {
+      ASSERT_LT(m.heap.stats.collections, m.heap.stats.steps);
+    }
+    vm_free(&m);
+  }
+
+  bytecode_free(&bc);
+  flat_ast_free(&flat);
+  ast_free(&program);
+  vector_char_free(&source);
+}
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/compile.h"
+#include "slowjs/flat.h"
+#include "slowjs/inliner.h"
+#include "slowjs/parse.h"
+#include "slowjs/resolve.h"
+#include "slowjs/vm.h"
+}
+
+// Inlines raw_source with max_size, runs it and returns the report.
+// Running must succeed unless error is given to hold how it ended.
+static std::string inline_run(const char *raw_source, uint32_t max_size,
+                              value *result, vm_error *error = nullptr) {
+  vector_char source = {};
+  ast program = {};
+  flat_ast flat = {};
+  bytecode bc = {};
+  run_options options = {};
+  vm m = {};
+  inline_options inlining = {};
+  std::string report = "";
+  char *out = 0;
+  size_t out_size = 0;
+  FILE *stream = 0;
+
+  EXPECT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  EXPECT_EQ(E_PARSE_OK, parse(source, &program));
+  EXPECT_EQ(E_FLAT_OK, flatten(&program, &flat));
+  EXPECT_EQ(E_RESOLVE_OK, resolve(&flat));
+
+  inlining.max_size = max_size;
+  stream = open_memstream(&out, &out_size);
+  EXPECT_EQ(E_INLINE_OK, inline_calls(&flat, inlining, stream));
+  fclose(stream);
+  report = out;
+  free(out);
+
+  EXPECT_EQ(E_COMPILE_OK, compile(&flat, &bc));
+  EXPECT_EQ(E_VM_OK, vm_init(&m, options));
+  if (error) {
+    *error = vm_run(&m, &bc, bc.main, result);
+  } else {
+    EXPECT_EQ(E_VM_OK, vm_run(&m, &bc, bc.main, result));
+  }
+
+  vm_free(&m);
+  bytecode_free(&bc);
+  flat_ast_free(&flat);
+  ast_free(&program);
+  vector_char_free(&source);
+  return report;
+}
+
+TEST(inliner, calls) {
+  struct {
+    const char *source;
+    double number;
+    const char *report;
+  } tests[] = {
+      {"function sum(a, b) { return a + b; }\n"
+       "function main() { return sum(1, 3); }",
+       4,
+       "inline: sum inlined into main, 3 nodes\n"
+       "inline: 1 of 1 call sites inlined\n"},
+      // Inner calls are inlined first and then move into the outer body.
+      {"function sum(a, b) { return a + b; }\n"
+       "function main() { return sum(sum(1, 2), sum(3, 4)); }",
+       10,
+       "inline: sum inlined into main, 3 nodes\n"
+       "inline: sum inlined into main, 3 nodes\n"
+       "inline: sum inlined into main, 3 nodes\n"
+       "inline: 3 of 3 call sites inlined\n"},
+      // Calls in the inlined body are inlined as they are copied.
+      {"function double(a) { return a * 2; }\n"
+       "function quad(a) { return double(double(a)); }\n"
+       "function main() { return quad(3); }",
+       12,
+       "inline: double inlined into quad, 3 nodes\n"
+       "inline: double inlined into quad, 3 nodes\n"
+       "inline: quad inlined into main, 5 nodes\n"
+       "inline: 3 of 3 call sites inlined\n"},
+      {"function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+       "function main() { return fib(10); }",
+       55,
+       "inline: fib not inlined into fib, recursive\n"
+       "inline: fib not inlined into fib, recursive\n"
+       "inline: fib not inlined into main, recursive\n"
+       "inline: 0 of 3 call sites inlined\n"},
+      // 1 + 2 would be computed twice.
+      {"function square(x) { return x * x; }\n"
+       "function main() { return square(1 + 2) + square(4); }",
+       25,
+       "inline: square not inlined into main, argument evaluated a "
+       "different number of times\n"
+       "inline: square inlined into main, 3 nodes\n"
+       "inline: 1 of 2 call sites inlined\n"},
+      // one(3) would not be called at all.
+      {"function first(a, b) { return a; }\n"
+       "function one(n) { return n < 1 ? 1 : one(n - 1); }\n"
+       "function main() { return first(2, one(3)) + first(3); }",
+       5,
+       "inline: one not inlined into one, recursive\n"
+       "inline: one not inlined into main, recursive\n"
+       "inline: first not inlined into main, argument evaluated a "
+       "different number of times\n"
+       "inline: first not inlined into main, argument count differs\n"
+       "inline: 0 of 4 call sites inlined\n"},
+      {"function f(a) { function g() { return a; } return g(); }\n"
+       "function main() { return f(5); }",
+       5,
+       "inline: f not inlined into main, body is not a single return\n"
+       "inline: 0 of 1 call sites inlined\n"},
+      {"function big(a) { return a + a + a + a + a + a + a + a + a; }\n"
+       "function main() { return big(1); }",
+       9,
+       "inline: big not inlined into main, too big\n"
+       "inline: 0 of 1 call sites inlined\n"},
+  };
+  uint64_t i = 0;
+  value result = 0;
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    printf("Testing: `%s`\n", tests[i].source);
+    ASSERT_EQ(tests[i].report, inline_run(tests[i].source, 8, &result));
+    ASSERT_EQ(VALUE_NUMBER, value_typeof(result));
+    ASSERT_EQ(tests[i].number, value_number(result));
+
+    // Same answer without inlining.
+    ASSERT_EQ("", inline_run(tests[i].source, 0, &result));
+    ASSERT_EQ(tests[i].number, value_number(result));
+  }
+}
+
+// Arguments that make calls still run, in the order they were passed,
+// before the body makes calls of its own.
+TEST(inliner, evaluation_order) {
+  struct {
+    const char *source;
+    vm_error error;
+    const char *report;
+  } tests[] = {
+      // bad() would only be called if c were true.
+      {"function pick(c, x) { return c ? x : 0; }\n"
+       "function bad() { return null(); }\n"
+       "function main() { return pick(false, bad()); }",
+       E_VM_CALL_NONFUNCTION,
+       "inline: bad inlined into main, 2 nodes\n"
+       "inline: pick not inlined into main, argument evaluated a "
+       "different number of times\n"
+       "inline: 1 of 2 call sites inlined\n"},
+      {"function pick(c, x) { return c ? x : 0; }\n"
+       "function spin(n) { return 1 + spin(n); }\n"
+       "function main() { return pick(false, spin(0)); }",
+       E_VM_STACK_OVERFLOW,
+       "inline: spin not inlined into spin, recursive\n"
+       "inline: spin not inlined into main, recursive\n"
+       "inline: pick not inlined into main, argument evaluated a "
+       "different number of times\n"
+       "inline: 0 of 3 call sites inlined\n"},
+      // spin(0) would be called before bad().
+      {"function swap(a, b) { return b + a; }\n"
+       "function bad() { return null(); }\n"
+       "function spin(n) { return 1 + spin(n); }\n"
+       "function main() { return swap(bad(), spin(0)); }",
+       E_VM_CALL_NONFUNCTION,
+       "inline: spin not inlined into spin, recursive\n"
+       "inline: bad inlined into main, 2 nodes\n"
+       "inline: spin not inlined into main, recursive\n"
+       "inline: swap not inlined into main, arguments evaluated out of "
+       "order\n"
+       "inline: 1 of 4 call sites inlined\n"},
+      // The body's own call to spin would come before bad().
+      {"function first(a) { return spin(0) + a; }\n"
+       "function bad() { return null(); }\n"
+       "function spin(n) { return 1 + spin(n); }\n"
+       "function main() { return first(bad()); }",
+       E_VM_CALL_NONFUNCTION,
+       "inline: spin not inlined into first, recursive\n"
+       "inline: spin not inlined into spin, recursive\n"
+       "inline: bad inlined into main, 2 nodes\n"
+       "inline: first not inlined into main, arguments evaluated out of "
+       "order\n"
+       "inline: 1 of 4 call sites inlined\n"},
+      // In order, and the test of a conditional always runs.
+      {"function pick(c, x, y) { return c ? x - y : 0; }\n"
+       "function one(n) { return n < 1 ? 1 : one(n - 1); }\n"
+       "function main() { return pick(one(1) + one(2), 5, 3); }",
+       E_VM_OK,
+       "inline: one not inlined into one, recursive\n"
+       "inline: one not inlined into main, recursive\n"
+       "inline: one not inlined into main, recursive\n"
+       "inline: pick inlined into main, 6 nodes\n"
+       "inline: 1 of 4 call sites inlined\n"},
+  };
+  uint64_t i = 0;
+  value result = 0, uninlined = 0;
+  vm_error error = E_VM_OK, uninlined_error = E_VM_OK;
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    printf("Testing: `%s`\n", tests[i].source);
+    ASSERT_EQ(tests[i].report,
+              inline_run(tests[i].source, 8, &result, &error));
+    ASSERT_EQ(tests[i].error, error);
+
+    // Same as without inlining.
+    ASSERT_EQ("", inline_run(tests[i].source, 0, &uninlined,
+                             &uninlined_error));
+    ASSERT_EQ(uninlined_error, error);
+    if (error == E_VM_OK) {
+      ASSERT_EQ(value_number(uninlined), value_number(result));
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/interpret.h"
+#include "slowjs/parse.h"
+}
+
+static interpret_error interpret_source(const char *raw_source,
+                                        run_options options = {}) {
+  vector_char source = {};
+  ast program = {};
+  interpret_error err = E_INTERPRET_OK;
+
+  EXPECT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  EXPECT_EQ(E_PARSE_OK, parse(source, &program));
+  err = interpret(program, options);
+  ast_free(&program);
+  vector_char_free(&source);
+  return err;
+}
+
+TEST(interpret, tail_calls) {
+  // Far deeper than the C stack or the value stack could hold.
+  ASSERT_EQ(E_INTERPRET_OK,
+            interpret_source("function count(n) {\n"
+                             "  return n < 1 ? 0 : count(n - 1);\n"
+                             "}\n"
+                             "function main() { return count(10000000); }"));
+
+  // Between functions with and without envs.
+  ASSERT_EQ(E_INTERPRET_OK,
+            interpret_source("function even(n) {\n"
+                             "  function f() { return n; }\n"
+                             "  return n < 1 ? f() : odd(n - 1, 0);\n"
+                             "}\n"
+                             "function odd(n) { return even(n - 1); }\n"
+                             "function main() { return even(1000000); }"));
+
+  ASSERT_EQ(E_INTERPRET_CALL_NONFUNCTION,
+            interpret_source("function main() { return 1 ? 2() : 3; }"));
+}
+
+TEST(interpret, deep_recursion) {
+  const char *deep = "function depth(n) {\n"
+                     "  return n < 1 ? 0 : 1 + depth(n - 1);\n"
+                     "}\n"
+                     "function main() { return depth(1000000); }";
+  run_options options = {};
+
+  ASSERT_EQ(E_INTERPRET_OK, interpret_source(deep));
+
+  // Arguments that make calls are still being evaluated when the next
+  // call starts.
+  ASSERT_EQ(E_INTERPRET_OK,
+            interpret_source("function sum(a, b) { return a + b; }\n"
+                             "function depth(n) {\n"
+                             "  return n < 1 ? 0 : sum(1, depth(n - 1));\n"
+                             "}\n"
+                             "function main() { return depth(1000000); }"));
+
+  ASSERT_EQ(E_INTERPRET_STACK_OVERFLOW,
+            interpret_source("function main() { return 1 + main(); }"));
+
+  options.stack_limit = 1 << 20;
+  ASSERT_EQ(E_INTERPRET_STACK_OVERFLOW, interpret_source(deep, options));
+}
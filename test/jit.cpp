@@ -0,0 +1,202 @@
+#include <dirent.h>
+#include <string.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/compile.h"
+#include "slowjs/file.h"
+#include "slowjs/flat.h"
+#include "slowjs/inliner.h"
+#include "slowjs/parse.h"
+#include "slowjs/resolve.h"
+#include "slowjs/vm.h"
+}
+
+// Runs raw_source in the VM with options, inlining first if asked, and
+// returns main's value.
+static value jit_run(const char *raw_source, run_options options,
+                     jit_stats *stats) {
+  vector_char source = {};
+  ast program = {};
+  flat_ast flat = {};
+  bytecode bc = {};
+  vm m = {};
+  value result = 0;
+
+  EXPECT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  EXPECT_EQ(E_PARSE_OK, parse(source, &program));
+  EXPECT_EQ(E_FLAT_OK, flatten(&program, &flat));
+  EXPECT_EQ(E_RESOLVE_OK, resolve(&flat));
+  EXPECT_EQ(E_INLINE_OK, inline_calls(&flat, options.inlining, 0));
+  EXPECT_EQ(E_COMPILE_OK, compile(&flat, &bc));
+  EXPECT_EQ(E_VM_OK, vm_init(&m, options));
+  EXPECT_EQ(E_VM_OK, vm_run(&m, &bc, bc.main, &result));
+
+  if (stats) {
+    *stats = m.jit.stats;
+  }
+  vm_free(&m);
+  bytecode_free(&bc);
+  flat_ast_free(&flat);
+  ast_free(&program);
+  vector_char_free(&source);
+  return result;
+}
+
+// Compiled code has to give exactly what the VM does, whether functions
+// are compiled up front or partway through and with or without inlining.
+static void jit_compare(const char *source) {
+  run_options options = {};
+  value expected = 0;
+  uint32_t thresholds[] = {0, 1, 3};
+  uint32_t max_sizes[] = {0, INLINE_DEFAULT_MAX_SIZE};
+  uint64_t i = 0, j = 0;
+
+  for (j = 0; j < sizeof(max_sizes) / sizeof(max_sizes[0]); j++) {
+    options = {};
+    options.inlining.max_size = max_sizes[j];
+    expected = jit_run(source, options, 0);
+
+    options.jit.enabled = 1;
+    for (i = 0; i < sizeof(thresholds) / sizeof(thresholds[0]); i++) {
+      options.jit.threshold = thresholds[i];
+      ASSERT_EQ(expected, jit_run(source, options, 0))
+          << source << "\nthreshold " << thresholds[i] << ", max size "
+          << max_sizes[j];
+    }
+  }
+}
+
+TEST(jit, examples) {
+  DIR *dir = opendir(EXAMPLES_DIR);
+  struct dirent *entry = 0;
+  std::string path = "";
+  vector_char source = {};
+  uint64_t compared = 0;
+
+  ASSERT_NE(nullptr, dir);
+  while ((entry = readdir(dir)) != 0) {
+    path = entry->d_name;
+    if (path.size() < 3 || path.substr(path.size() - 3) != ".js") {
+      continue;
+    }
+
+    path = std::string(EXAMPLES_DIR) + "/" + path;
+    printf("Testing: %s\n", path.c_str());
+    ASSERT_EQ(E_FILE_OK, read_file((char *)path.c_str(), &source));
+    jit_compare(std::string(source.elements, source.index).c_str());
+    vector_char_free(&source);
+    source = {};
+    compared++;
+  }
+  closedir(dir);
+
+  ASSERT_GT(compared, 0);
+}
+
+TEST(jit, differential) {
+  const char *tests[] = {
+      "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+      "function main() { return fib(15); }",
+      // Zero and NaN are falsy, NaN compares false both ways.
+      "function t(a) { return a ? 1 : 2; }\n"
+      "function lt(a, b) { return a < b ? 1 : 2; }\n"
+      "function gt(a, b) { return a > b ? 1 : 2; }\n"
+      "function main() {\n"
+      "  return t(0) + t(0 / 0) * 10 + t(0 - 0) * 100 + t(3) * 1000 +\n"
+      "         lt(0 / 0, 1) * 10000 + gt(0 / 0, 1) * 100000 +\n"
+      "         lt(1, 2) * 1000000 + gt(2, 1) * 10000000;\n"
+      "}",
+      "function div(a, b) { return a / b; }\n"
+      "function main() { return div(1, 0) - div(0 - 1, 0) + div(7, 3); }",
+      // Runs out of native stack and runs in the VM instead.
+      "function depth(n) { return n < 1 ? 0 : 1 + depth(n - 1); }\n"
+      "function main() { return depth(60000); }",
+      "function count(n, acc) {\n"
+      "  return n < 1 ? acc : count(n - 1, acc + n / 2);\n"
+      "}\n"
+      "function main() { return count(1000000, 0); }",
+      "function even(n) { return n < 1 ? 1 : odd(n - 1); }\n"
+      "function odd(n) { return n < 1 ? 0 : even(n - 1); }\n"
+      "function main() { return even(1001) + odd(1001) * 10; }",
+      // Every register is in use across the innermost calls.
+      "function s(a, b) { return a - b / 3; }\n"
+      "function t(a) {\n"
+      "  return s(a, s(a * 2, s(a * 3, s(a * 4, s(a * 5, s(a * 6,\n"
+      "         s(a * 7, a)))))));\n"
+      "}\n"
+      "function main() { return t(7) + t(2); }",
+      // Too deep for the registers.
+      "function s(a, b) { return a - b / 3; }\n"
+      "function t(a) {\n"
+      "  return s(a, s(a * 2, s(a * 3, s(a * 4, s(a * 5, s(a * 6,\n"
+      "         s(a * 7, s(a * 8, a))))))));\n"
+      "}\n"
+      "function main() { return t(7) + t(2); }",
+      // The call's function would be the sixteenth position.
+      "function f(a) { return a; }\n"
+      "function g(a) {\n"
+      "  return a + (a + (a + (a + (a + (a + (a + (a + (a + (a + (a + (a +\n"
+      "         (a + (a + (a + f(a)))))))))))))));\n"
+      "}\n"
+      "function main() { return g(2); }",
+      // Not numbers, so they run in the VM.
+      "function f(a) { return a + 1; }\n"
+      "function lt(a, b) { return a < b; }\n"
+      "function nothing(a) { }\n"
+      "function main() {\n"
+      "  return f(1) + f(true) + f(null) + f(2, 3) + f() +\n"
+      "         (lt(1, 2) ? 10 : 20) + (nothing(1) ? 1 : 2);\n"
+      "}",
+      "function add(a) { function inner(b) { return a + b; } return inner; }\n"
+      "function twice(f, x) { return f(f(x)); }\n"
+      "function main() { return twice(add(3), 4); }",
+  };
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    jit_compare(tests[i]);
+  }
+}
+
+// Elsewhere everything runs in the VM.
+#ifdef __x86_64__
+TEST(jit, compiles) {
+  run_options options = {};
+  jit_stats stats = {};
+  value result = 0;
+
+  options.jit.enabled = 1;
+  options.jit.threshold = 10;
+  result = jit_run("function fib(n) {\n"
+                   "  return n < 2 ? n : fib(n - 1) + fib(n - 2);\n"
+                   "}\n"
+                   "function main() { return fib(20); }",
+                   options, &stats);
+  ASSERT_EQ(6765, value_number(result));
+  ASSERT_EQ(1, stats.compiled);
+  ASSERT_GT(stats.native_calls, 0);
+  ASSERT_EQ(0, stats.bails);
+
+  // g returns a boolean, so neither it nor f can be compiled.
+  options.jit.threshold = 0;
+  result = jit_run("function g(a) { return a < 1; }\n"
+                   "function f(a) { return g(a) ? a : a + 1; }\n"
+                   "function main() { return f(1) + f(0); }",
+                   options, &stats);
+  ASSERT_EQ(2, value_number(result));
+  ASSERT_EQ(0, stats.compiled);
+  ASSERT_EQ(2, stats.rejected);
+
+  result = jit_run("function depth(n) {\n"
+                   "  return n < 1 ? 0 : 1 + depth(n - 1);\n"
+                   "}\n"
+                   "function main() { return depth(60000); }",
+                   options, &stats);
+  ASSERT_EQ(60000, value_number(result));
+  ASSERT_EQ(1, stats.bails);
+}
+#endif
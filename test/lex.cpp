@@ -9,9 +9,9 @@ TEST(lex, addition) {
   vector_char source = {0};
   const char raw_source[] = "a + 1";
   const char *expected[] = {
-      "1",
-      "+",
       "a",
+      "+",
+      "1",
   };
   int i = 0;
   vector_error verr = E_VECTOR_OK;
@@ -26,7 +26,10 @@ TEST(lex, addition) {
   ASSERT_EQ(sizeof expected / sizeof expected[0], tokens.index);
 
   for (i = 0; i < tokens.index; i++) {
-    ASSERT_STREQ(expected[i], tokens.elements[i].string.elements);
+    ASSERT_EQ(strlen(expected[i]), tokens.elements[i].length);
+    ASSERT_EQ(0, strncmp(expected[i],
+                         source.elements + tokens.elements[i].offset,
+                         tokens.elements[i].length));
   }
 }
 
@@ -35,9 +38,9 @@ TEST(lex, ret) {
   vector_char source = {0};
   const char raw_source[] = "return 1;";
   const char *expected[] = {
-      ";",
-      "1",
       "return",
+      "1",
+      ";",
   };
   int i = 0;
   vector_error verr = E_VECTOR_OK;
@@ -52,14 +55,17 @@ TEST(lex, ret) {
   ASSERT_EQ(3, tokens.index);
 
   for (i = 0; i < tokens.index; i++) {
-    ASSERT_STREQ(expected[i], tokens.elements[i].string.elements);
+    ASSERT_EQ(strlen(expected[i]), tokens.elements[i].length);
+    ASSERT_EQ(0, strncmp(expected[i],
+                         source.elements + tokens.elements[i].offset,
+                         tokens.elements[i].length));
   }
 }
 
 TEST(lex, function) {
   const char raw_source[] = "function main() { return a+1; }";
   const char *expected[] = {
-      "}", ";", "1", "+", "a", "return", "{", ")", "(", "main", "function",
+      "function", "main", "(", ")", "{", "return", "a", "+", "1", ";", "}",
   };
   vector_token tokens = {0};
   vector_char source = {0};
@@ -75,6 +81,90 @@ TEST(lex, function) {
   ASSERT_EQ(sizeof expected / sizeof expected[0], tokens.index);
 
   for (i = 0; i < tokens.index; i++) {
-    ASSERT_STREQ(expected[i], tokens.elements[i].string.elements);
+    ASSERT_EQ(strlen(expected[i]), tokens.elements[i].length);
+    ASSERT_EQ(0, strncmp(expected[i],
+                         source.elements + tokens.elements[i].offset,
+                         tokens.elements[i].length));
+  }
+}
+
+TEST(lex, spans) {
+  const char raw_source[] = "function main() {\n  // comment\n  return ab;\n}";
+  struct expected_span {
+    uint64_t line;
+    uint64_t col;
+    uint64_t offset;
+    uint64_t length;
+  } expected[] = {
+      {1, 1, 0, 8},   {1, 10, 9, 4},  {1, 14, 13, 1},
+      {1, 15, 14, 1}, {1, 17, 16, 1}, {3, 3, 33, 6},
+      {3, 10, 40, 2}, {3, 12, 42, 1}, {4, 1, 44, 1},
+  };
+  vector_token tokens = {0};
+  vector_char source = {0};
+  int i = 0;
+  lex_error lerr = E_LEX_OK;
+  vector_error verr = E_VECTOR_OK;
+
+  verr = vector_char_copy(&source, (char *)raw_source, strlen(raw_source));
+  ASSERT_EQ(E_VECTOR_OK, verr);
+
+  lerr = lex(source, &tokens);
+  ASSERT_EQ(E_LEX_OK, lerr);
+  ASSERT_EQ(sizeof expected / sizeof expected[0], tokens.index);
+
+  for (i = 0; i < tokens.index; i++) {
+    ASSERT_EQ(expected[i].line, tokens.elements[i].line);
+    ASSERT_EQ(expected[i].col, tokens.elements[i].col);
+    ASSERT_EQ(expected[i].offset, tokens.elements[i].offset);
+    ASSERT_EQ(expected[i].length, tokens.elements[i].length);
+  }
+
+  vector_token_free(&tokens);
+  vector_char_free(&source);
+}
+
+TEST(lex, types) {
+  const char raw_source[] = "function f(nullx) { return null + 1; }";
+  const token_type expected[] = {
+      TOKEN_FUNCTION, TOKEN_IDENTIFIER, TOKEN_LPAREN, TOKEN_IDENTIFIER,
+      TOKEN_RPAREN,   TOKEN_LBRACE,     TOKEN_RETURN, TOKEN_NULL,
+      TOKEN_PLUS,     TOKEN_NUMBER,     TOKEN_SEMICOLON, TOKEN_RBRACE,
+  };
+  vector_token tokens = {0};
+  vector_char source = {0};
+  int i = 0;
+  lex_error lerr = E_LEX_OK;
+  vector_error verr = E_VECTOR_OK;
+
+  verr = vector_char_copy(&source, (char *)raw_source, strlen(raw_source));
+  ASSERT_EQ(E_VECTOR_OK, verr);
+
+  lerr = lex(source, &tokens);
+  ASSERT_EQ(E_LEX_OK, lerr);
+  ASSERT_EQ(sizeof expected / sizeof expected[0], tokens.index);
+
+  for (i = 0; i < tokens.index; i++) {
+    ASSERT_EQ(expected[i], tokens.elements[i].type);
+  }
+
+  vector_token_free(&tokens);
+  vector_char_free(&source);
+}
+
+TEST(lex, keywords) {
+  const char *keywords[] = {"function", "return", "null", "true",
+                            "false",    "var",    "let",  "const"};
+  const char *identifiers[] = {"nullx", "func", "returns", "t", "lets", "va"};
+  int i = 0;
+
+  for (i = 0; i < sizeof keywords / sizeof keywords[0]; i++) {
+    ASSERT_TRUE(
+        TOKEN_IS_KEYWORD(lex_keyword(keywords[i], strlen(keywords[i]))));
+  }
+
+  for (i = 0; i < sizeof identifiers / sizeof identifiers[0]; i++) {
+    ASSERT_EQ(TOKEN_IDENTIFIER,
+              lex_keyword(identifiers[i], strlen(identifiers[i])));
   }
 }
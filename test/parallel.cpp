@@ -0,0 +1,57 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/parallel.h"
+}
+
+TEST(parallel, calls) {
+  slowjs_script *s = 0;
+  parallel_stats stats = {};
+  run_options options = {};
+  uint32_t threads[] = {1, 3, 8};
+  uint64_t i = 0;
+
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function fib(n) {\n"
+                           "  return n < 2 ? n : fib(n - 1) + fib(n - 2);\n"
+                           "}\n"
+                           "function main() { return fib(10); }",
+                           options, &s));
+
+  // Not a multiple of PARALLEL_BATCH, so one claim is cut short.
+  for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+    ASSERT_EQ(E_PARALLEL_OK, parallel_calls(s, "main", threads[i], 1000,
+                                            &stats));
+    ASSERT_EQ(1000, stats.calls);
+    ASSERT_EQ(E_SLOWJS_OK, stats.error);
+  }
+  slowjs_free(s);
+
+  // Every worker compiles fib for itself.
+  options.jit.enabled = 1;
+  options.jit.threshold = 0;
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function fib(n) {\n"
+                           "  return n < 2 ? n : fib(n - 1) + fib(n - 2);\n"
+                           "}\n"
+                           "function main() { return fib(10); }",
+                           options, &s));
+  ASSERT_EQ(E_PARALLEL_OK, parallel_calls(s, "main", 4, 500, &stats));
+  ASSERT_EQ(500, stats.calls);
+  slowjs_free(s);
+}
+
+TEST(parallel, errors) {
+  slowjs_script *s = 0;
+  parallel_stats stats = {};
+
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function main() { return 1(); }", {}, &s));
+  ASSERT_EQ(E_PARALLEL_CALL, parallel_calls(s, "main", 4, 1000, &stats));
+  ASSERT_EQ(E_SLOWJS_CALL_NONFUNCTION, stats.error);
+  ASSERT_EQ(0, stats.calls);
+
+  ASSERT_EQ(E_PARALLEL_CALL, parallel_calls(s, "nothing", 2, 10, &stats));
+  ASSERT_EQ(E_SLOWJS_NOT_FOUND, stats.error);
+  slowjs_free(s);
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string>
 
 #include "gtest/gtest.h"
 
@@ -8,7 +9,8 @@ extern "C" {
 }
 
 TEST(parse, identifier_bad) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {}, test_identifier = {};
   const char raw_source[] = "1";
   vector_error verr = E_VECTOR_OK;
@@ -17,15 +19,19 @@ TEST(parse, identifier_bad) {
   verr = vector_char_copy(&source, (char *)raw_source, sizeof(raw_source));
   ASSERT_EQ(E_VECTOR_OK, verr);
 
-  lerr = lex(source, &tokens);
+  p.source = source;
+  p.arena = &a;
+  lerr = lex(source, &p.tokens);
   ASSERT_EQ(E_LEX_OK, lerr);
 
-  ASSERT_FALSE(parse_identifier(&tokens, &test_identifier));
-  vector_token_free(&tokens);
+  ASSERT_FALSE(parse_identifier(&p, &test_identifier));
+  arena_free(&a);
+  vector_token_free(&p.tokens);
 }
 
 TEST(parse, identifier_good) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {}, test_identifier = {};
   const char *raw_source[] = {
       "a", "ab", "abcd124", "_", "$", "$12",
@@ -42,18 +48,23 @@ TEST(parse, identifier_good) {
         vector_char_copy(&source, (char *)raw_source[i], strlen(raw_source[i]));
     ASSERT_EQ(E_VECTOR_OK, verr);
 
-    lerr = lex(source, &tokens);
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
     ASSERT_EQ(E_LEX_OK, lerr);
 
-    ASSERT_TRUE(parse_identifier(&tokens, &test_identifier));
+    ASSERT_TRUE(parse_identifier(&p, &test_identifier));
 
-    vector_token_free(&tokens);
+    arena_free(&a);
+    vector_token_free(&p.tokens);
     vector_char_free(&source);
   }
 }
 
 TEST(parse, number_good) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {};
   const char raw_source[] = "1";
   vector_error verr = E_VECTOR_OK;
@@ -63,17 +74,21 @@ TEST(parse, number_good) {
   verr = vector_char_copy(&source, (char *)raw_source, sizeof(raw_source));
   ASSERT_EQ(E_VECTOR_OK, verr);
 
-  lerr = lex(source, &tokens);
+  p.source = source;
+  p.arena = &a;
+  lerr = lex(source, &p.tokens);
   ASSERT_EQ(E_LEX_OK, lerr);
 
-  ASSERT_TRUE(parse_number(&tokens, &test_number));
+  ASSERT_TRUE(parse_number(&p, &test_number));
 
-  vector_token_free(&tokens);
+  arena_free(&a);
+  vector_token_free(&p.tokens);
   vector_char_free(&source);
 }
 
 TEST(parse, number_bad) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {};
   const char raw_source[] = "b";
   vector_error verr = E_VECTOR_OK;
@@ -83,17 +98,21 @@ TEST(parse, number_bad) {
   verr = vector_char_copy(&source, (char *)raw_source, sizeof(raw_source));
   ASSERT_EQ(E_VECTOR_OK, verr);
 
-  lerr = lex(source, &tokens);
+  p.source = source;
+  p.arena = &a;
+  lerr = lex(source, &p.tokens);
   ASSERT_EQ(E_LEX_OK, lerr);
 
-  ASSERT_FALSE(parse_number(&tokens, &test_number));
+  ASSERT_FALSE(parse_number(&p, &test_number));
 
-  vector_token_free(&tokens);
+  arena_free(&a);
+  vector_token_free(&p.tokens);
   vector_char_free(&source);
 }
 
 TEST(parse, function_good) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {};
   struct test {
     const char *src;
@@ -118,20 +137,24 @@ TEST(parse, function_good) {
         vector_char_copy(&source, (char *)tests[i].src, strlen(tests[i].src));
     ASSERT_EQ(E_VECTOR_OK, verr);
 
-    lerr = lex(source, &tokens);
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
     ASSERT_EQ(E_LEX_OK, lerr);
-    ASSERT_EQ(tests[i].expected_tokens, tokens.index);
+    ASSERT_EQ(tests[i].expected_tokens, p.tokens.index);
 
-    ASSERT_TRUE(parse_function_declaration(&tokens, &test_fd));
+    ASSERT_TRUE(parse_function_declaration(&p, &test_fd));
 
-    function_declaration_free(&test_fd);
-    vector_token_free(&tokens);
+    arena_free(&a);
+    vector_token_free(&p.tokens);
     vector_char_free(&source);
   }
 }
 
 TEST(parse, statement_good) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {};
   struct test {
     const char *src;
@@ -153,20 +176,24 @@ TEST(parse, statement_good) {
         vector_char_copy(&source, (char *)tests[i].src, strlen(tests[i].src));
     ASSERT_EQ(E_VECTOR_OK, verr);
 
-    lerr = lex(source, &tokens);
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
     ASSERT_EQ(E_LEX_OK, lerr);
-    ASSERT_EQ(tests[i].expected_tokens, tokens.index);
+    ASSERT_EQ(tests[i].expected_tokens, p.tokens.index);
 
-    ASSERT_TRUE(parse_statement(&tokens, &test_statement));
+    ASSERT_TRUE(parse_statement(&p, &test_statement));
 
-    statement_free(&test_statement);
-    vector_token_free(&tokens);
+    arena_free(&a);
+    vector_token_free(&p.tokens);
     vector_char_free(&source);
   }
 }
 
 TEST(parse, block_good) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {};
   struct test {
     const char *src;
@@ -189,20 +216,24 @@ TEST(parse, block_good) {
         vector_char_copy(&source, (char *)tests[i].src, strlen(tests[i].src));
     ASSERT_EQ(E_VECTOR_OK, verr);
 
-    lerr = lex(source, &tokens);
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
     ASSERT_EQ(E_LEX_OK, lerr);
-    ASSERT_EQ(tests[i].expected_tokens, tokens.index);
+    ASSERT_EQ(tests[i].expected_tokens, p.tokens.index);
 
-    ASSERT_TRUE(parse_block(&tokens, &test_statements));
+    ASSERT_TRUE(parse_block(&p, &test_statements));
 
-    vector_statement_free(&test_statements);
-    vector_token_free(&tokens);
+    arena_free(&a);
+    vector_token_free(&p.tokens);
     vector_char_free(&source);
   }
 }
 
 TEST(parse, function_call_good) {
-  vector_token tokens = {};
+  parser p = {};
+  arena a = {};
   vector_char source = {};
   struct test {
     const char *src;
@@ -224,14 +255,267 @@ TEST(parse, function_call_good) {
         vector_char_copy(&source, (char *)tests[i].src, strlen(tests[i].src));
     ASSERT_EQ(E_VECTOR_OK, verr);
 
-    lerr = lex(source, &tokens);
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
     ASSERT_EQ(E_LEX_OK, lerr);
-    ASSERT_EQ(tests[i].expected_tokens, tokens.index);
+    ASSERT_EQ(tests[i].expected_tokens, p.tokens.index);
 
-    ASSERT_TRUE(parse_function_call(&tokens, &test_function_call));
+    ASSERT_TRUE(parse_function_call(&p, &test_function_call));
 
-    function_call_free(&test_function_call);
-    vector_token_free(&tokens);
+    arena_free(&a);
+    vector_token_free(&p.tokens);
     vector_char_free(&source);
   }
 }
+
+TEST(parse, expression_literals) {
+  parser p = {};
+  arena a = {};
+  vector_char source = {};
+  struct test {
+    const char *src;
+    expression_type expected_type;
+    double expected_number;
+  } tests[] = {
+      {"null", EXPRESSION_NULL, 0},
+      {"nullx", EXPRESSION_IDENTIFIER, 0},
+      {"true", EXPRESSION_BOOL, 1},
+      {"false", EXPRESSION_BOOL, 0},
+      {"truex", EXPRESSION_IDENTIFIER, 0},
+      {"12", EXPRESSION_NUMBER, 12},
+  };
+  vector_error verr = E_VECTOR_OK;
+  expression test_expression = {};
+  lex_error lerr = E_LEX_OK;
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    printf("Testing: `%s`\n", tests[i].src);
+
+    verr =
+        vector_char_copy(&source, (char *)tests[i].src, strlen(tests[i].src));
+    ASSERT_EQ(E_VECTOR_OK, verr);
+
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
+    ASSERT_EQ(E_LEX_OK, lerr);
+
+    ASSERT_TRUE(parse_expression(&p, &test_expression));
+    ASSERT_EQ(tests[i].expected_type, test_expression.type);
+    ASSERT_EQ(p.tokens.index, p.index);
+    if (test_expression.type != EXPRESSION_IDENTIFIER) {
+      ASSERT_EQ(tests[i].expected_number, test_expression.expression.number);
+    }
+
+    arena_free(&a);
+    vector_token_free(&p.tokens);
+    vector_char_free(&source);
+  }
+}
+
+TEST(parse, failure_restores_cursor) {
+  parser p = {};
+  arena a = {};
+  vector_char source = {};
+  const char *tests[] = {
+      "function a(b c) {}",
+      "function a() { return 1 }",
+      "function a() { return }",
+  };
+  vector_error verr = E_VECTOR_OK;
+  function_declaration test_fd = {};
+  lex_error lerr = E_LEX_OK;
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    printf("Testing: `%s`\n", tests[i]);
+
+    verr = vector_char_copy(&source, (char *)tests[i], strlen(tests[i]));
+    ASSERT_EQ(E_VECTOR_OK, verr);
+
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
+    ASSERT_EQ(E_LEX_OK, lerr);
+
+    ASSERT_FALSE(parse_function_declaration(&p, &test_fd));
+    ASSERT_EQ(0, p.index);
+
+    arena_free(&a);
+    vector_token_free(&p.tokens);
+    vector_char_free(&source);
+  }
+}
+
+static void expression_to_string(expression *e, std::string *out) {
+  const char ops[] = {'+', '-', '*', '/', '<', '>'};
+  char buf[32] = {0};
+  uint64_t i = 0;
+
+  switch (e->type) {
+  case EXPRESSION_OP:
+    *out += "(";
+    *out += ops[e->expression.op.type];
+    *out += " ";
+    expression_to_string(e->expression.op.left_operand, out);
+    *out += " ";
+    expression_to_string(e->expression.op.right_operand, out);
+    *out += ")";
+    break;
+  case EXPRESSION_CONDITIONAL:
+    *out += "(? ";
+    expression_to_string(e->expression.conditional.test, out);
+    *out += " ";
+    expression_to_string(e->expression.conditional.consequent, out);
+    *out += " ";
+    expression_to_string(e->expression.conditional.alternate, out);
+    *out += ")";
+    break;
+  case EXPRESSION_CALL:
+    *out += "(call ";
+    expression_to_string(e->expression.function_call.function, out);
+    for (i = 0; i < e->expression.function_call.arguments->index; i++) {
+      *out += " ";
+      expression_to_string(&e->expression.function_call.arguments->elements[i],
+                           out);
+    }
+    *out += ")";
+    break;
+  case EXPRESSION_IDENTIFIER:
+    *out += e->expression.identifier.elements;
+    break;
+  case EXPRESSION_NUMBER:
+    snprintf(buf, sizeof(buf), "%g", e->expression.number);
+    *out += buf;
+    break;
+  case EXPRESSION_NULL:
+    *out += "null";
+    break;
+  case EXPRESSION_BOOL:
+    *out += e->expression.number ? "true" : "false";
+    break;
+  }
+}
+
+TEST(parse, expression_precedence) {
+  parser p = {};
+  arena a = {};
+  vector_char source = {};
+  struct test {
+    const char *src;
+    const char *expected;
+  } tests[] = {
+      {"1 + 2 * 3", "(+ 1 (* 2 3))"},
+      {"1 * 2 + 3", "(+ (* 1 2) 3)"},
+      {"(1 + 2) * 3", "(* (+ 1 2) 3)"},
+      {"a - b - c", "(- (- a b) c)"},
+      {"a / b * c", "(* (/ a b) c)"},
+      {"a + b * c - d / e", "(- (+ a (* b c)) (/ d e))"},
+      {"f(1, g(2) + 3) * 4", "(* (call f 1 (+ (call g 2) 3)) 4)"},
+      {"f(1)(2)", "(call (call f 1) 2)"},
+      {"(f)()", "(call f)"},
+      {"a + 1 < b * 2", "(< (+ a 1) (* b 2))"},
+      {"a < b ? 1 : 2 + 3", "(? (< a b) 1 (+ 2 3))"},
+      {"a ? b ? 1 : 2 : c ? 3 : 4", "(? a (? b 1 2) (? c 3 4))"},
+      {"f(a > 1 ? a : 1)", "(call f (? (> a 1) a 1))"},
+  };
+  vector_error verr = E_VECTOR_OK;
+  expression test_expression = {};
+  std::string out;
+  lex_error lerr = E_LEX_OK;
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    printf("Testing: `%s`\n", tests[i].src);
+
+    verr =
+        vector_char_copy(&source, (char *)tests[i].src, strlen(tests[i].src));
+    ASSERT_EQ(E_VECTOR_OK, verr);
+
+    p = {};
+    p.source = source;
+    p.arena = &a;
+    lerr = lex(source, &p.tokens);
+    ASSERT_EQ(E_LEX_OK, lerr);
+
+    test_expression = {};
+    ASSERT_TRUE(parse_expression(&p, &test_expression));
+    ASSERT_EQ(p.tokens.index, p.index);
+
+    out.clear();
+    expression_to_string(&test_expression, &out);
+    ASSERT_STREQ(tests[i].expected, out.c_str());
+
+    arena_free(&a);
+    vector_token_free(&p.tokens);
+    vector_char_free(&source);
+  }
+}
+
+TEST(parse, expression_deeply_nested) {
+  parser p = {};
+  arena a = {};
+  vector_char source = {};
+  std::string sum, parens;
+  vector_error verr = E_VECTOR_OK;
+  expression test_expression = {};
+  expression *e = 0;
+  lex_error lerr = E_LEX_OK;
+  uint64_t i = 0, depth = 0;
+
+  for (i = 0; i < 1000; i++) {
+    sum += i ? " + a" : "a";
+    parens += "(";
+  }
+  parens += "a";
+  for (i = 0; i < 1000; i++) {
+    parens += " + 1)";
+  }
+
+  // 1000-term sum, left associative so the tree is 999 ops deep on the
+  // left.
+  verr = vector_char_copy(&source, (char *)sum.c_str(), sum.size());
+  ASSERT_EQ(E_VECTOR_OK, verr);
+
+  p.source = source;
+  p.arena = &a;
+  lerr = lex(source, &p.tokens);
+  ASSERT_EQ(E_LEX_OK, lerr);
+
+  ASSERT_TRUE(parse_expression(&p, &test_expression));
+  ASSERT_EQ(p.tokens.index, p.index);
+  for (e = &test_expression; e->type == EXPRESSION_OP;
+       e = e->expression.op.left_operand) {
+    ASSERT_EQ(OP_PLUS, e->expression.op.type);
+    ASSERT_EQ(EXPRESSION_IDENTIFIER, e->expression.op.right_operand->type);
+    depth++;
+  }
+  ASSERT_EQ(999, depth);
+
+  arena_free(&a);
+  vector_token_free(&p.tokens);
+  vector_char_free(&source);
+
+  // 1000 nested groups.
+  verr = vector_char_copy(&source, (char *)parens.c_str(), parens.size());
+  ASSERT_EQ(E_VECTOR_OK, verr);
+
+  p = {};
+  p.source = source;
+  p.arena = &a;
+  lerr = lex(source, &p.tokens);
+  ASSERT_EQ(E_LEX_OK, lerr);
+
+  test_expression = {};
+  ASSERT_TRUE(parse_expression(&p, &test_expression));
+  ASSERT_EQ(p.tokens.index, p.index);
+
+  arena_free(&a);
+  vector_token_free(&p.tokens);
+  vector_char_free(&source);
+}
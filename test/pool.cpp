@@ -0,0 +1,41 @@
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/pool.h"
+}
+
+struct pool_test {
+  uint32_t *runs;
+};
+
+static void pool_test_task(void *data, uint64_t i) {
+  pool_test *t = (pool_test *)data;
+
+  // Early tasks are slow, so the threads that own them get help.
+  if (i < 4) {
+    usleep(2000);
+  }
+  __atomic_add_fetch(&t->runs[i], 1, __ATOMIC_RELAXED);
+}
+
+TEST(pool, runs_every_task_once) {
+  uint32_t threads[] = {0, 1, 2, 7, 64};
+  uint64_t tasks[] = {0, 1, 5, 1000};
+  uint32_t runs[1000] = {};
+  pool_test t = {runs};
+  uint64_t i = 0, j = 0, k = 0;
+
+  for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+    for (j = 0; j < sizeof(tasks) / sizeof(tasks[0]); j++) {
+      memset(runs, 0, sizeof(runs));
+      ASSERT_EQ(E_POOL_OK,
+                pool_run(threads[i], tasks[j], pool_test_task, &t));
+      for (k = 0; k < tasks[j]; k++) {
+        ASSERT_EQ(1, runs[k]) << "task " << k << " of " << tasks[j] << " on "
+                              << threads[i] << " threads";
+      }
+    }
+  }
+}
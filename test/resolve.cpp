@@ -0,0 +1,105 @@
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/flat.h"
+#include "slowjs/parse.h"
+#include "slowjs/resolve.h"
+}
+
+static void resolve_source(const char *raw_source, ast *program,
+                           flat_ast *f) {
+  vector_char source = {};
+
+  ASSERT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  ASSERT_EQ(E_PARSE_OK, parse(source, program));
+  ASSERT_EQ(E_FLAT_OK, flatten(program, f));
+  vector_char_free(&source);
+}
+
+// The expression returned by the last statement of function.
+static flat_node returned(flat_ast *f, uint32_t function) {
+  flat_function *fn = &f->functions.elements[function];
+  flat_node s = f->nodes.elements[f->extras.elements[fn->body +
+                                                     fn->nstatements - 1]];
+
+  return f->nodes.elements[s.a];
+}
+
+TEST(resolve, slots) {
+  ast program = {};
+  flat_ast f = {};
+  flat_node n = {};
+  const char source[] = "function main(a, b) {\n"
+                        "  function b() { return a; }\n"
+                        "  function c() { return c; }\n"
+                        "  return b;\n"
+                        "}\n"
+                        "function other() { return main; }";
+
+  resolve_source(source, &program, &f);
+  ASSERT_EQ(E_RESOLVE_OK, resolve(&f));
+
+  // Parameters first, a declaration reuses the slot of a parameter of
+  // the same name.
+  ASSERT_EQ(3, f.functions.elements[0].nslots);
+  ASSERT_TRUE(f.functions.elements[0].heap_slots);
+  ASSERT_FALSE(f.functions.elements[1].heap_slots);
+  ASSERT_EQ(0, f.functions.elements[1].parent);
+  ASSERT_EQ(UINT32_MAX, f.functions.elements[0].parent);
+
+  n = returned(&f, 0);
+  ASSERT_EQ(FLAT_LOCAL, n.type);
+  ASSERT_EQ(0, n.a);
+  ASSERT_EQ(1, n.b);
+
+  // b returns main's a
+  n = returned(&f, 1);
+  ASSERT_EQ(FLAT_LOCAL, n.type);
+  ASSERT_EQ(1, n.a);
+  ASSERT_EQ(0, n.b);
+
+  // c returns itself from main's slots
+  n = returned(&f, 2);
+  ASSERT_EQ(FLAT_LOCAL, n.type);
+  ASSERT_EQ(1, n.a);
+  ASSERT_EQ(2, n.b);
+
+  n = returned(&f, 3);
+  ASSERT_EQ(FLAT_GLOBAL, n.type);
+  ASSERT_EQ(0, f.globals.elements[n.a]);
+  ASSERT_EQ(0, resolve_main(&f));
+
+  flat_ast_free(&f);
+  ast_free(&program);
+}
+
+TEST(resolve, later_global_wins) {
+  ast program = {};
+  flat_ast f = {};
+  const char source[] = "function main() { return 1; }\n"
+                        "function main() { return 2; }";
+
+  resolve_source(source, &program, &f);
+  ASSERT_EQ(E_RESOLVE_OK, resolve(&f));
+  ASSERT_EQ(1, f.globals.index);
+  ASSERT_EQ(1, resolve_main(&f));
+
+  flat_ast_free(&f);
+  ast_free(&program);
+}
+
+TEST(resolve, undefined) {
+  ast program = {};
+  flat_ast f = {};
+  const char source[] = "function f() { return a; }\n"
+                        "function main() { return g() + f(); }";
+
+  resolve_source(source, &program, &f);
+  ASSERT_EQ(E_RESOLVE_UNDEFINED, resolve(&f));
+
+  flat_ast_free(&f);
+  ast_free(&program);
+}
@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/scheduler.h"
+}
+
+TEST(scheduler, round_robin) {
+  scheduler s = {};
+  slowjs_script *spin = 0, *fib = 0, *clones[8] = {};
+  scheduler_task forever = {}, tasks[8] = {};
+  value args[1] = {};
+  uint64_t i = 0, steps = 0;
+
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function spin(n) { return spin(n + 1); }", {},
+                           &spin));
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function fib(n) {\n"
+                           "  return n < 2 ? n : fib(n - 1) + fib(n - 2);\n"
+                           "}",
+                           {}, &fib));
+
+  scheduler_init(&s, 100, 0);
+  forever.script = spin;
+  scheduler_start(&s, &forever, "spin", args, 1);
+  ASSERT_FALSE(forever.done);
+  ASSERT_EQ(1, s.waiting);
+
+  // Each fib(10) takes 177 calls, so two slices.
+  args[0] = number_value(10);
+  for (i = 0; i < 8; i++) {
+    ASSERT_EQ(E_SLOWJS_OK, slowjs_clone(fib, &clones[i]));
+    tasks[i].script = clones[i];
+    scheduler_start(&s, &tasks[i], "fib", args, 1);
+  }
+
+  // spin gets one more slice, then each fib finishes in its second.
+  for (steps = 0; steps < 9; steps++) {
+    ASSERT_TRUE(scheduler_step(&s));
+  }
+  for (i = 0; i < 8; i++) {
+    ASSERT_TRUE(tasks[i].done);
+    ASSERT_EQ(E_SLOWJS_OK, tasks[i].error);
+    ASSERT_EQ(55, value_number(tasks[i].result));
+    ASSERT_EQ(2, tasks[i].slices);
+    ASSERT_EQ(177, tasks[i].fuel);
+    slowjs_free(clones[i]);
+  }
+  ASSERT_FALSE(forever.done);
+  ASSERT_EQ(1, s.waiting);
+  ASSERT_EQ(200, forever.fuel);
+  ASSERT_EQ(2, forever.slices);
+  ASSERT_EQ(200, slowjs_fuel_used(spin));
+
+  slowjs_free(spin);
+  slowjs_free(fib);
+}
+
+TEST(scheduler, limit) {
+  scheduler s = {};
+  slowjs_script *script = 0;
+  scheduler_task spin = {}, fail = {}, add = {};
+  value args[2] = {number_value(1), number_value(2)};
+
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function spin(n) { return spin(n + 1); }\n"
+                           "function fail() { return 1(); }\n"
+                           "function add(a, b) { return a + b; }",
+                           {}, &script));
+
+  scheduler_init(&s, 10, 1000);
+  spin.script = script;
+  scheduler_start(&s, &spin, "spin", args, 1);
+  scheduler_run(&s);
+  ASSERT_TRUE(spin.done);
+  ASSERT_EQ(E_SLOWJS_YIELD, spin.error);
+  ASSERT_EQ(1000, spin.fuel);
+  ASSERT_EQ(100, spin.slices);
+
+  // The script can take new calls once its task has stopped.
+  fail.script = script;
+  scheduler_start(&s, &fail, "fail", 0, 0);
+  ASSERT_TRUE(fail.done);
+  ASSERT_EQ(E_SLOWJS_CALL_NONFUNCTION, fail.error);
+
+  add.script = script;
+  scheduler_start(&s, &add, "add", args, 2);
+  ASSERT_TRUE(add.done);
+  ASSERT_EQ(3, value_number(add.result));
+  ASSERT_EQ(1, add.fuel);
+  ASSERT_FALSE(scheduler_step(&s));
+  slowjs_free(script);
+}
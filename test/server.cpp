@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/server.h"
+}
+
+// A server on its own thread, answering from a fresh directory.
+struct server_test {
+  char dir[32];
+  std::string socket;
+  server s;
+  std::thread thread;
+};
+
+static void server_test_start(server_test *t, server_options options) {
+  snprintf(t->dir, sizeof(t->dir), "/tmp/slowjs-serve-XXXXXX");
+  ASSERT_NE(nullptr, mkdtemp(t->dir));
+  t->socket = std::string(t->dir) + "/slowjs.sock";
+  ASSERT_EQ(E_SERVER_OK, server_init(&t->s, t->socket.c_str(), options));
+  t->thread = std::thread([t]() { server_run(&t->s); });
+}
+
+static server_stats server_test_stop(server_test *t) {
+  server_stats stats = {};
+
+  server_stop(&t->s);
+  t->thread.join();
+  stats = t->s.stats;
+  server_free(&t->s);
+  rmdir(t->dir);
+  return stats;
+}
+
+static std::string server_test_write(server_test *t, const char *name,
+                                     const char *source) {
+  std::string path = std::string(t->dir) + "/" + name;
+  FILE *f = fopen(path.c_str(), "w");
+
+  EXPECT_NE(nullptr, f);
+  fputs(source, f);
+  fclose(f);
+  return path;
+}
+
+static int server_test_connect(server_test *t) {
+  struct sockaddr_un address = {};
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, t->socket.c_str());
+  EXPECT_EQ(0, connect(fd, (struct sockaddr *)&address, sizeof(address)));
+  return fd;
+}
+
+// Reads up to and including the next newline.
+static std::string server_test_line(int fd) {
+  std::string line = "";
+  char c = 0;
+
+  while (read(fd, &c, 1) == 1) {
+    line += c;
+    if (c == '\n') {
+      break;
+    }
+  }
+  return line;
+}
+
+static std::string server_test_call(int fd, std::string request) {
+  request += "\n";
+  EXPECT_EQ((ssize_t)request.size(),
+            write(fd, request.c_str(), request.size()));
+  return server_test_line(fd);
+}
+
+TEST(server, requests) {
+  server_test t = {};
+  server_stats stats = {};
+  std::string fib = "", broken = "";
+  int fd = 0;
+
+  server_test_start(&t, {});
+  fib = server_test_write(&t, "fib.js",
+                          "function fib(n) {\n"
+                          "  return n < 2 ? n : fib(n - 1) + fib(n - 2);\n"
+                          "}\n"
+                          "function add(a, b) { return a + b; }\n"
+                          "function f() { return fib; }");
+  broken = server_test_write(&t, "broken.js", "function f( {");
+  fd = server_test_connect(&t);
+
+  ASSERT_EQ("55.000000\n", server_test_call(fd, fib + " fib 10"));
+  ASSERT_EQ("3.500000\n", server_test_call(fd, fib + " add 1 2.5"));
+  ASSERT_EQ("[Function]\n", server_test_call(fd, fib + "\tf\r"));
+  ASSERT_EQ("error function not found\n", server_test_call(fd, fib + " g"));
+  ASSERT_EQ("error bad request\n", server_test_call(fd, fib + " add 1 x"));
+  ASSERT_EQ("error bad request\n", server_test_call(fd, fib));
+  ASSERT_EQ("error reading file\n",
+            server_test_call(fd, std::string(t.dir) + "/none.js main"));
+  ASSERT_EQ("error parsing program\n", server_test_call(fd, broken + " f"));
+
+  // Requests sent together are answered in order.
+  ASSERT_EQ("1.000000\n",
+            server_test_call(fd, fib + " fib 1\n" + fib + " fib 2\n" + fib +
+                                     " fib 3"));
+  ASSERT_EQ("1.000000\n", server_test_line(fd));
+  ASSERT_EQ("2.000000\n", server_test_line(fd));
+  close(fd);
+
+  unlink(fib.c_str());
+  unlink(broken.c_str());
+  stats = server_test_stop(&t);
+  ASSERT_EQ(1, stats.connections);
+  ASSERT_EQ(11, stats.requests);
+  ASSERT_EQ(5, stats.failed);
+  ASSERT_EQ(1, stats.compiles);
+}
+
+TEST(server, reload) {
+  server_test t = {};
+  std::string path = "";
+  int fd = 0;
+
+  server_test_start(&t, {});
+  path = server_test_write(&t, "main.js", "function main() { return 1; }");
+  fd = server_test_connect(&t);
+  ASSERT_EQ("1.000000\n", server_test_call(fd, path + " main"));
+  ASSERT_EQ("1.000000\n", server_test_call(fd, path + " main"));
+
+  // Rewritten with a new size, so compiled again.
+  path = server_test_write(&t, "main.js", "function main() { return 22; }");
+  ASSERT_EQ("22.000000\n", server_test_call(fd, path + " main"));
+  close(fd);
+
+  unlink(path.c_str());
+  ASSERT_EQ(2, server_test_stop(&t).compiles);
+}
+
+TEST(server, slices) {
+  server_test t = {};
+  server_options options = {};
+  std::string path = "", request = "";
+  int slow = 0, fast = 0;
+  char c = 0;
+
+  options.slice = 100;
+  options.limit = 10000000;
+  server_test_start(&t, options);
+  path = server_test_write(&t, "spin.js",
+                           "function spin(n) { return spin(n + 1); }\n"
+                           "function fib(n) {\n"
+                           "  return n < 2 ? n : fib(n - 1) + fib(n - 2);\n"
+                           "}");
+  slow = server_test_connect(&t);
+  fast = server_test_connect(&t);
+
+  // fib is answered while spin is still going.
+  request = path + " spin 0\n";
+  ASSERT_EQ((ssize_t)request.size(),
+            write(slow, request.c_str(), request.size()));
+  ASSERT_EQ("55.000000\n", server_test_call(fast, path + " fib 10"));
+  ASSERT_EQ(-1, recv(slow, &c, 1, MSG_DONTWAIT));
+  ASSERT_EQ("error too many calls\n", server_test_line(slow));
+  close(slow);
+  close(fast);
+
+  unlink(path.c_str());
+  ASSERT_EQ(1, server_test_stop(&t).failed);
+}
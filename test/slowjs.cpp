@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/slowjs.h"
+}
+
+TEST(slowjs, call) {
+  slowjs_script *s = 0;
+  value args[3] = {};
+  value result = 0;
+  uint64_t i = 0;
+
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function fib(n) {\n"
+                           "  return n < 2 ? n : fib(n - 1) + fib(n - 2);\n"
+                           "}\n"
+                           "function add(a, b) { return a + b; }\n"
+                           "function adder(a) {\n"
+                           "  function inner(b) { return a + b; }\n"
+                           "  return inner;\n"
+                           "}",
+                           {}, &s));
+
+  // The same script answers call after call.
+  for (i = 0; i < 100; i++) {
+    args[0] = number_value(i % 20);
+    ASSERT_EQ(E_SLOWJS_OK, slowjs_call(s, "fib", args, 1, &result));
+    ASSERT_TRUE(IS_NUMBER(result));
+  }
+  ASSERT_EQ(4181, value_number(result));
+
+  args[0] = number_value(1);
+  args[1] = TRUE_VALUE;
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_call(s, "add", args, 2, &result));
+  ASSERT_EQ(2, value_number(result));
+
+  // Missing arguments are null, extra ones are dropped.
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_call(s, "add", args, 1, &result));
+  ASSERT_EQ(1, value_number(result));
+  args[2] = number_value(10);
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_call(s, "add", args, 3, &result));
+  ASSERT_EQ(2, value_number(result));
+
+  // A function returned from one call can be passed to the next.
+  args[0] = number_value(3);
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_call(s, "adder", args, 1, &result));
+  ASSERT_TRUE(IS_FUNCTION(result));
+  args[0] = result;
+  args[1] = number_value(4);
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_call(s, "add", args, 2, &result));
+  ASSERT_TRUE(value_number(result) != value_number(result));
+
+  ASSERT_EQ(E_SLOWJS_NOT_FOUND, slowjs_call(s, "main", 0, 0, &result));
+  ASSERT_EQ(E_SLOWJS_NOT_FOUND, slowjs_call(s, "inner", 0, 0, &result));
+
+  slowjs_free(s);
+}
+
+TEST(slowjs, errors) {
+  slowjs_script *s = 0;
+  value result = 0;
+  run_options options = {};
+
+  ASSERT_EQ(E_SLOWJS_PARSE, slowjs_compile("function f( {", {}, &s));
+  ASSERT_EQ(nullptr, s);
+  ASSERT_EQ(E_SLOWJS_COMPILE,
+            slowjs_compile("function f() { return g(); }", {}, &s));
+  ASSERT_EQ(nullptr, s);
+
+  options.jit.enabled = 1;
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function f() { return 1(); }\n"
+                           "function g() { return 1 + g(); }\n"
+                           "function h() { return 7; }",
+                           options, &s));
+  ASSERT_EQ(E_SLOWJS_CALL_NONFUNCTION, slowjs_call(s, "f", 0, 0, &result));
+  ASSERT_EQ(E_SLOWJS_STACK_OVERFLOW, slowjs_call(s, "g", 0, 0, &result));
+
+  // Failed calls leave the script usable.
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_call(s, "h", 0, 0, &result));
+  ASSERT_EQ(7, value_number(result));
+  slowjs_free(s);
+}
+
+TEST(slowjs, clone) {
+  slowjs_script *s = 0, *clone = 0;
+  value args[1] = {};
+  value result = 0;
+
+  ASSERT_EQ(E_SLOWJS_OK,
+            slowjs_compile("function twice(a) { return a * 2; }", {}, &s));
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_clone(s, &clone));
+  ASSERT_EQ(s->program, clone->program);
+
+  // The clone keeps the program after the original is gone.
+  slowjs_free(s);
+  args[0] = number_value(21);
+  ASSERT_EQ(E_SLOWJS_OK, slowjs_call(clone, "twice", args, 1, &result));
+  ASSERT_EQ(42, value_number(result));
+  slowjs_free(clone);
+}
@@ -0,0 +1,47 @@
+#include <math.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/value.h"
+}
+
+TEST(value, size) { ASSERT_EQ(8, sizeof(value)); }
+
+TEST(value, numbers) {
+  double numbers[] = {0, -0.0, 1, -1.5, 1e308, INFINITY, -INFINITY};
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+    ASSERT_TRUE(IS_NUMBER(number_value(numbers[i])));
+    ASSERT_EQ(numbers[i], value_number(number_value(numbers[i])));
+  }
+
+  // Both the NaN the hardware produces and the canonical one.
+  ASSERT_EQ(VALUE_NUMBER, value_typeof(number_value(0.0 / 0.0 * -1)));
+  ASSERT_EQ(VALUE_NUMBER, value_typeof(number_value(NAN)));
+  ASSERT_EQ(VALUE_NUMBER, value_typeof(number_value(-NAN)));
+  ASSERT_FALSE(value_truthy(number_value(NAN)));
+  ASSERT_FALSE(value_truthy(number_value(0)));
+  ASSERT_TRUE(value_truthy(number_value(-2)));
+}
+
+TEST(value, tagged) {
+  closure fn = {};
+  closure *c = &fn;
+
+  ASSERT_EQ(VALUE_NULL, value_typeof(NULL_VALUE));
+  ASSERT_EQ(VALUE_BOOL, value_typeof(TRUE_VALUE));
+  ASSERT_EQ(VALUE_BOOL, value_typeof(FALSE_VALUE));
+  ASSERT_EQ(VALUE_FUNCTION, value_typeof(FUNCTION_VALUE(c)));
+  ASSERT_EQ(c, AS_CLOSURE(FUNCTION_VALUE(c)));
+
+  ASSERT_FALSE(value_truthy(NULL_VALUE));
+  ASSERT_FALSE(value_truthy(FALSE_VALUE));
+  ASSERT_TRUE(value_truthy(TRUE_VALUE));
+  ASSERT_TRUE(value_truthy(FUNCTION_VALUE(c)));
+
+  ASSERT_EQ(0, value_to_number(NULL_VALUE));
+  ASSERT_EQ(1, value_to_number(TRUE_VALUE));
+  ASSERT_TRUE(isnan(value_to_number(FUNCTION_VALUE(c))));
+}
@@ -0,0 +1,238 @@
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "slowjs/compile.h"
+#include "slowjs/flat.h"
+#include "slowjs/parse.h"
+#include "slowjs/resolve.h"
+#include "slowjs/vm.h"
+}
+
+struct vm_test {
+  ast program;
+  flat_ast flat;
+  bytecode bc;
+  vm m;
+};
+
+static compile_error vm_test_compile(vm_test *t, const char *raw_source) {
+  vector_char source = {};
+  compile_error err = E_COMPILE_OK;
+
+  *t = {};
+  EXPECT_EQ(E_VECTOR_OK, vector_char_copy(&source, (char *)raw_source,
+                                          strlen(raw_source) + 1));
+  EXPECT_EQ(E_PARSE_OK, parse(source, &t->program));
+  EXPECT_EQ(E_FLAT_OK, flatten(&t->program, &t->flat));
+  EXPECT_EQ(E_RESOLVE_OK, resolve(&t->flat));
+  err = compile(&t->flat, &t->bc);
+  vector_char_free(&source);
+  return err;
+}
+
+static void vm_test_free(vm_test *t) {
+  vm_free(&t->m);
+  bytecode_free(&t->bc);
+  flat_ast_free(&t->flat);
+  ast_free(&t->program);
+}
+
+TEST(vm, run) {
+  struct {
+    const char *source;
+    value_type type;
+    double number;
+  } tests[] = {
+      {"function main() { return 1 + 3; }", VALUE_NUMBER, 4},
+      {"function main() { return 2 * 3 - 8 / 4; }", VALUE_NUMBER, 4},
+      {"function sum(a, b) { return a + b; }\n"
+       "function main() { return sum(1, 3); }",
+       VALUE_NUMBER, 4},
+      {"function main() { sum(1, 2); return sum(1, 2) * sum(3, 4); }\n"
+       "function sum(a, b) { return a + b; }",
+       VALUE_NUMBER, 21},
+      {"function main() { function f(a) { return a * 2; } return f(f(3)); }",
+       VALUE_NUMBER, 12},
+      {"function f(a, b) { return b; }\n"
+       "function main() { return f(1); }",
+       VALUE_NULL, 0},
+      {"function f(a) { return a; }\n"
+       "function main() { return f(7, 8, 9); }",
+       VALUE_NUMBER, 7},
+      {"function main() { return true; }", VALUE_BOOL, 1},
+      {"function main() {\n"
+       "  return f(2);\n"
+       "  function f(a) { return g(a) + a; }\n"
+       "  function g(b) { return b * 10; }\n"
+       "}",
+       VALUE_NUMBER, 22},
+      {"function add(a) { function inner(b) { return a + b; } return inner; }\n"
+       "function main() { return add(1)(2) * add(10)(20); }",
+       VALUE_NUMBER, 90},
+      {"function a(x) {\n"
+       "  function b(y) {\n"
+       "    function c(z) { return x * 100 + y * 10 + z; }\n"
+       "    return c(3);\n"
+       "  }\n"
+       "  return b(2);\n"
+       "}\n"
+       "function main() { return a(1); }",
+       VALUE_NUMBER, 123},
+      {"function main() { }", VALUE_NULL, 0},
+      {"function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+       "function main() { return fib(10); }",
+       VALUE_NUMBER, 55},
+      {"function main() { return (null ? 1 : 2) + (0 ? 1 : 2) * 10; }",
+       VALUE_NUMBER, 22},
+      {"function main() { return main ? 1 > 2 : 3; }", VALUE_BOOL, 0},
+      {"function f() { return 1; }\n"
+       "function main() { return f; }",
+       VALUE_FUNCTION, 0},
+  };
+  vm_test t = {};
+  value result = 0;
+  uint64_t i = 0;
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    ASSERT_EQ(E_COMPILE_OK, vm_test_compile(&t, tests[i].source))
+        << tests[i].source;
+    ASSERT_NE(UINT32_MAX, t.bc.main);
+    ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+    ASSERT_EQ(E_VM_OK, vm_run(&t.m, &t.bc, t.bc.main, &result))
+        << tests[i].source;
+    ASSERT_EQ(tests[i].type, value_typeof(result)) << tests[i].source;
+    if (IS_NUMBER(result)) {
+      ASSERT_EQ(tests[i].number, value_number(result)) << tests[i].source;
+    } else if (IS_BOOL(result)) {
+      ASSERT_EQ(tests[i].number, result == TRUE_VALUE) << tests[i].source;
+    }
+    vm_test_free(&t);
+  }
+}
+
+TEST(vm, quicken) {
+  vm_test t = {};
+  value result = 0;
+  uint8_t *code = 0;
+
+  ASSERT_EQ(E_COMPILE_OK,
+            vm_test_compile(&t, "function f(a) { return a + 1; }\n"
+                                "function main() {\n"
+                                "  return f(2) + f(3) + f(true) + f(4);\n"
+                                "}"));
+  code = (uint8_t *)malloc(t.bc.code.index);
+  memcpy(code, t.bc.code.elements, t.bc.code.index);
+
+  ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+  ASSERT_EQ(E_VM_OK, vm_run(&t.m, &t.bc, t.bc.main, &result));
+  ASSERT_EQ(14, value_number(result));
+
+  // a + 1 is quickened by f(2), hits for f(3), is deoptimized by f(true)
+  // and quickened again by f(4). Each addition in main runs once and
+  // quickens, since f(true) returns the number 2.
+  ASSERT_EQ(5, t.m.quicken.quickened);
+  ASSERT_EQ(1, t.m.quicken.misses);
+  ASSERT_EQ(1, t.m.quicken.hits);
+  ASSERT_EQ(6, t.m.quicken.generic);
+
+  // Quickening rewrites the VM's copy of the code, not the bytecode.
+  ASSERT_EQ(0, memcmp(code, t.bc.code.elements, t.bc.code.index));
+  free(code);
+  vm_test_free(&t);
+}
+
+TEST(vm, runtime_errors) {
+  vm_test t = {};
+  value result = 0;
+
+  ASSERT_EQ(E_COMPILE_OK,
+            vm_test_compile(&t, "function main() { return 1(); }"));
+  ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+  ASSERT_EQ(E_VM_CALL_NONFUNCTION, vm_run(&t.m, &t.bc, t.bc.main, &result));
+  vm_test_free(&t);
+
+  ASSERT_EQ(E_COMPILE_OK,
+            vm_test_compile(&t, "function main() { return main() + 1; }"));
+  ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+  ASSERT_EQ(E_VM_STACK_OVERFLOW, vm_run(&t.m, &t.bc, t.bc.main, &result));
+  vm_test_free(&t);
+}
+
+TEST(vm, tail_calls) {
+  vm_test t = {};
+  value result = 0;
+
+  // Far deeper than the frames or the stack could hold.
+  ASSERT_EQ(E_COMPILE_OK,
+            vm_test_compile(&t, "function count(n) {\n"
+                                "  return n < 1 ? 0 : count(n - 1);\n"
+                                "}\n"
+                                "function main() { return count(10000000); }"));
+  ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+  ASSERT_EQ(E_VM_OK, vm_run(&t.m, &t.bc, t.bc.main, &result));
+  ASSERT_EQ(0, value_number(result));
+  vm_test_free(&t);
+
+  // The env of each call is garbage once the next one starts, extra
+  // arguments are dropped and missing ones are null.
+  ASSERT_EQ(E_COMPILE_OK,
+            vm_test_compile(&t, "function count(n, acc, nothing) {\n"
+                                "  function f() { return acc + nothing; }\n"
+                                "  return n < 1 ? f() : count(n - 1, acc + 1);"
+                                "}\n"
+                                "function main() {\n"
+                                "  return count(1000000, 0, 1, 2);\n"
+                                "}"));
+  ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+  ASSERT_EQ(E_VM_OK, vm_run(&t.m, &t.bc, t.bc.main, &result));
+  ASSERT_EQ(1000000, value_number(result));
+  ASSERT_GT(t.m.heap.stats.collections, 0);
+  ASSERT_LE(t.m.heap.bytes, GC_MIN_THRESHOLD);
+  vm_test_free(&t);
+}
+
+TEST(vm, fuel) {
+  vm_test t = {};
+  value result = 0;
+  vm_error err = E_VM_OK;
+  uint64_t calls = 0, yields = 0;
+
+  // Closures made before a yield have to survive collections after it.
+  ASSERT_EQ(E_COMPILE_OK,
+            vm_test_compile(&t, "function fib(n) {\n"
+                                "  return n < 2 ? n : fib(n - 1) + fib(n - 2);"
+                                "}\n"
+                                "function count(n, acc) {\n"
+                                "  function f() { return acc + fib(5); }\n"
+                                "  return n < 1 ? f() : count(n - 1, f());\n"
+                                "}\n"
+                                "function main() { return count(20000, 0); }"));
+  ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+  ASSERT_EQ(E_VM_OK, vm_run(&t.m, &t.bc, t.bc.main, &result));
+  ASSERT_EQ(20001 * 5, value_number(result));
+  calls = t.m.fuel_used;
+  vm_free(&t.m);
+
+  t.m = {};
+  ASSERT_EQ(E_VM_OK, vm_init(&t.m, run_options{}));
+  t.m.fuel = 7;
+  err = vm_run(&t.m, &t.bc, t.bc.main, &result);
+  for (; err == E_VM_YIELD; yields++) {
+    ASSERT_EQ((yields + 1) * 7, t.m.fuel_used);
+    err = vm_resume(&t.m, &t.bc, &result);
+  }
+  ASSERT_EQ(E_VM_OK, err);
+  ASSERT_EQ(20001 * 5, value_number(result));
+  ASSERT_EQ(calls, t.m.fuel_used);
+  ASSERT_EQ((calls - 1) / 7, yields);
+  ASSERT_GT(t.m.heap.stats.collections, 0);
+
+  // A new call drops the one that yielded.
+  ASSERT_EQ(E_VM_YIELD, vm_call(&t.m, &t.bc, t.bc.main, 0, 0, &result));
+  t.m.fuel = 0;
+  ASSERT_EQ(E_VM_OK, vm_call(&t.m, &t.bc, t.bc.main, 0, 0, &result));
+  ASSERT_EQ(20001 * 5, value_number(result));
+  vm_test_free(&t);
+}